@@ -0,0 +1,818 @@
+/* File: buddy.c
+ * -------------------------
+ *
+ * This file represents an implementation of a binary buddy heap
+ * allocator, built as a fourth allocator next to implicit.c,
+ * explicit.c and tlsf.c on the same myinit segment. It is meant
+ * for power-of-two workloads such as I/O buffers, where every
+ * request fills its block exactly and blocks never fragment into
+ * odd sizes.
+ *
+ * Every block is a power of two of at least MIN_BLOCK_SIZE bytes
+ * and starts at a buddy offset that is a multiple of its own size.
+ * A block of order k therefore has exactly one buddy, at its
+ * offset XOR (1 << k), and the two merge back into
+ * the block of order k + 1 they were split from. mymalloc takes
+ * the smallest non-empty order that fits from a bitmap and splits
+ * it down, and myfree merges up while the buddy is free and of the
+ * same order, so both take O(log n) steps and never scan.
+ *
+ * Blocks carry no header, so a 4096 byte request takes a 4096 byte
+ * block. Instead, an order map at the end of the heap holds
+ * one byte per MIN_BLOCK_SIZE bytes, and the byte of a block's
+ * first unit records its order and whether it is free. Free-list
+ * links are 32-bit offsets from the start of the heap, as in the
+ * explicit allocator.
+ */
+#include "./allocator.h"
+#include "./debug_break.h"
+#include "./heap.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+typedef uint32_t link_t; // offset of a free block from heap_start, 0 for none
+
+// struct definition for casting of a free block
+typedef struct node
+{
+    link_t prev;
+    link_t next;
+} node;
+
+// constants used for arithmitic
+#define MIN_ORDER 5
+#define MIN_BLOCK_SIZE (1 << MIN_ORDER)
+#define MAX_ORDER 31
+#define NUM_ORDERS (MAX_ORDER + 1)
+#define MAX_HEAP_SIZE (((size_t)1 << 32) - ALIGNMENT) // links are 32 bits
+#define PAGE_SIZE 4096
+#define PAGE_ALIGN_MIN_HEAP (16 * PAGE_SIZE) // smaller segments are only 8-aligned
+
+// flags of an order map byte, the low bits hold the order
+#define ORDER_MASK 0x3f
+#define FREE_BIT 0x40
+#define TAKEN_BIT 0x80
+
+// relevant fields of one heap instance
+struct heap
+{
+    char *heap_start; // where links are measured from
+    uint8_t *order_map; // one byte per MIN_BLOCK_SIZE bytes of the segment
+    char *segment_start;
+    size_t segment_size;
+    size_t first_off; // buddy offset of segment_start, see heap_init
+    size_t end_off; // buddy offset of the segment end, a power of two
+    unsigned long order_bits; // bit set = order has a free block
+    node *free_lists[NUM_ORDERS];
+    size_t blocks_in_free;
+};
+
+// the instance behind myinit and the other my* functions
+static heap_t default_heap;
+
+/* Function: roundup (from bump.c)
+ * -----------------
+ * Parameters:
+ *     sz - a size_t value to be rounded to the next multiple of n
+ *     n   - the size_t that param 1 will be rounded to
+ *
+ * Returns: NA
+ *
+ * This function rounds up the given number to the given multiple, which
+ * must be a power of 2, and returns the result.  (you saw this code in lab1!).
+ */
+size_t roundup(size_t sz, size_t mult) {
+    return (sz + mult - 1) & ~(mult - 1);
+}
+
+/* Function: order_for
+ * -----------------
+ * Parameters:
+ *     sz - a size_t number of bytes being requested
+ *
+ * Returns: the size_t order of the smallest block that holds sz
+ *
+ * This function rounds a request up to a power of two of at least
+ * MIN_BLOCK_SIZE and returns its log2.
+ */
+size_t order_for(size_t sz) {
+    if (sz <= MIN_BLOCK_SIZE) return MIN_ORDER;
+    return 64 - __builtin_clzl(sz - 1);
+}
+
+/* Function: map_at
+ * -----------------
+ * Parameters:
+ *     h - a pointer to the heap instance
+ *     off - the size_t buddy offset of a block
+ *
+ * Returns: a uint8_t * to the block's order map byte
+ *
+ * This function finds the order map byte of the unit at off.
+ */
+uint8_t *map_at(heap_t *h, size_t off) {
+    return &h->order_map[(off - h->first_off) >> MIN_ORDER];
+}
+
+/* Function: block_at
+ * -----------------
+ * Parameters:
+ *     h - a pointer to the heap instance
+ *     off - the size_t buddy offset of a block
+ *
+ * Returns: a node * to the block
+ *
+ * This function turns a buddy offset into a pointer.
+ */
+node *block_at(heap_t *h, size_t off) {
+    return (node *)(h->segment_start + (off - h->first_off));
+}
+
+/* Function: block_off
+ * -----------------
+ * Parameters:
+ *     h - a pointer to the heap instance
+ *     n - a node * to a block
+ *
+ * Returns: the size_t buddy offset of the block
+ *
+ * This function is the inverse of block_at.
+ */
+size_t block_off(heap_t *h, node *n) {
+    return (char *)n - h->segment_start + h->first_off;
+}
+
+/* Function: link_node
+ * -----------------
+ * Parameters:
+ *     h - a pointer to the heap instance
+ *     off - a link_t read from a free block
+ *
+ * Returns: a node * to the block the link names, or NULL
+ *
+ * This function turns a free-list link back into a pointer. The
+ * segment starts at least ALIGNMENT past h->heap_start, so no
+ * block is ever at offset 0.
+ */
+node *link_node(heap_t *h, link_t off) {
+    if (off == 0) return NULL;
+    return (node *)(h->heap_start + off);
+}
+
+/* Function: node_link
+ * -----------------
+ * Parameters:
+ *     h - a pointer to the heap instance
+ *     n - a node * to a free block, or NULL
+ *
+ * Returns: the link_t that names the block in a free list
+ *
+ * This function is the inverse of link_node.
+ */
+link_t node_link(heap_t *h, node *n) {
+    if (n == NULL) return 0;
+    return (link_t)((char *)n - h->heap_start);
+}
+
+/* Function: buddy_of
+ * -----------------
+ * Parameters:
+ *     h - a pointer to the heap instance
+ *     off - the size_t buddy offset of a block
+ *     order - the size_t order of the block
+ *
+ * Returns: the size_t buddy offset of its buddy, or h->end_off if
+ *          the buddy would not lie in the segment
+ *
+ * This function flips the order's bit of the offset. The segment
+ * need not be a power of two, so the first blocks can have buddies
+ * that start before it, and those never merge.
+ */
+size_t buddy_of(heap_t *h, size_t off, size_t order) {
+    size_t buddy = off ^ ((size_t)1 << order);
+    if (buddy < h->first_off) return h->end_off;
+    return buddy;
+}
+
+/* Function: is_free_of_order
+ * -----------------
+ * Parameters:
+ *     h - a pointer to the heap instance
+ *     off - the size_t buddy offset of a unit, or h->end_off
+ *     order - the size_t order to look for
+ *
+ * Returns: boolean representation of if a free block of exactly
+ *          that order starts at off
+ *
+ * This function is the merge test. A buddy that was split has an
+ * order map byte of a smaller order, so it is never merged whole.
+ */
+bool is_free_of_order(heap_t *h, size_t off, size_t order) {
+    if (off >= h->end_off) return false;
+    return *map_at(h, off) == (FREE_BIT | order);
+}
+
+/* Function: insert_free
+ * -----------------
+ * Parameters:
+ *    h - a pointer to the heap instance
+ *    off - the size_t buddy offset of a block in no list
+ *    order - the size_t order of the block
+ *
+ * Returns: NA
+ *
+ * This function marks a block free in the order map and puts it
+ * first in its order's list.
+ */
+void insert_free(heap_t *h, size_t off, size_t order) {
+    node *new_node = block_at(h, off);
+    node *first = h->free_lists[order];
+
+    *map_at(h, off) = FREE_BIT | order;
+    new_node->prev = 0;
+    new_node->next = node_link(h, first);
+    if (first != NULL) first->prev = node_link(h, new_node);
+    h->free_lists[order] = new_node;
+    h->order_bits |= 1UL << order;
+    h->blocks_in_free += 1;
+}
+
+/* Function: remove_free
+ * -----------------
+ * Parameters:
+ *    h - a pointer to the heap instance
+ *    off - the size_t buddy offset of a block in a free list
+ *    order - the size_t order of the block
+ *
+ * Returns: NA
+ *
+ * This function unlinks a free block from its order's list and
+ * clears its order map byte. Callers write the byte again if the
+ * block is still a block afterwards.
+ */
+void remove_free(heap_t *h, size_t off, size_t order) {
+    node *old_node = block_at(h, off);
+    node *prev = link_node(h, old_node->prev);
+    node *next = link_node(h, old_node->next);
+
+    if (prev != NULL) {
+        prev->next = old_node->next;
+    } else {
+        h->free_lists[order] = next;
+    }
+    if (next != NULL) next->prev = old_node->prev;
+
+    if (h->free_lists[order] == NULL) h->order_bits &= ~(1UL << order);
+    *map_at(h, off) = 0;
+    h->blocks_in_free -= 1;
+}
+
+/* Function: split_down
+ * -----------------
+ * Parameters:
+ *    h - a pointer to the heap instance
+ *    off - the size_t buddy offset of a block in no list
+ *    order - the size_t order of the block
+ *    needed - the size_t order it is cut down to
+ *
+ * Returns: NA
+ *
+ * This function halves a block until it has the needed order,
+ * freeing every upper half on the way, and marks what is left
+ * allocated. The upper halves cannot merge, as their buddies are
+ * the lower halves being kept.
+ */
+void split_down(heap_t *h, size_t off, size_t order, size_t needed) {
+    while (order > needed) {
+        order -= 1;
+        insert_free(h, off + ((size_t)1 << order), order);
+    }
+    *map_at(h, off) = TAKEN_BIT | needed;
+}
+
+/* Function: heap_init
+ * -------------------------
+ * Parameters:
+ *     h - a pointer to the heap instance to set up
+ *     heap_start - a void * to the beginning of heap
+ *     heap_size - a size_t representation
+ *                 of the payload size
+ *
+ * Returns: boolean representation of if heap instantiation
+ *          was successful
+ *
+ * This function wipes a heap instance clean and starts fresh,
+ * setting its fields, error checking, and cutting the segment
+ * into the fewest buddy blocks that cover it. The order map goes
+ * last and the segment takes the rest, ending on a page boundary
+ * when the heap is large enough so that blocks of a page or more
+ * are page aligned. Buddy offsets count from where the segment
+ * would start if it were a whole power of two ending at the same
+ * place, which puts the small blocks left over by an odd size at
+ * the front of the segment and the large ones behind them.
+ * Anything past MAX_HEAP_SIZE is left unused.
+ */
+bool heap_init(heap_t *h, void *heap_start, size_t heap_size) {
+    if (heap_size <= 4 * MIN_BLOCK_SIZE || !heap_start) return false;
+    if (heap_size > MAX_HEAP_SIZE) heap_size = MAX_HEAP_SIZE;
+
+    size_t map_size = roundup(heap_size / MIN_BLOCK_SIZE, ALIGNMENT);
+    size_t end_align = heap_size >= PAGE_ALIGN_MIN_HEAP ? PAGE_SIZE : ALIGNMENT;
+    size_t end = ((size_t)heap_start + heap_size - map_size) & ~(end_align - 1);
+    size_t first = (size_t)heap_start + ALIGNMENT; // keeps link 0 free for NULL
+    if (end < first + MIN_BLOCK_SIZE) return false;
+
+    memset(h, 0, sizeof(heap_t));
+    h->heap_start = heap_start;
+    h->order_map = (uint8_t *)end;
+    h->segment_size = (end - first) & ~(size_t)(MIN_BLOCK_SIZE - 1);
+    h->segment_start = (char *)(end - h->segment_size);
+    h->end_off = (size_t)1 << order_for(h->segment_size);
+    h->first_off = h->end_off - h->segment_size;
+    memset(h->order_map, 0, h->segment_size >> MIN_ORDER);
+
+    // the largest block that is aligned at off and fits in the rest
+    for (size_t off = h->first_off; off < h->end_off;) {
+        size_t order = 63 - __builtin_clzl(h->end_off - off);
+        if (off != 0 && (size_t)__builtin_ctzl(off) < order) order = __builtin_ctzl(off);
+        if (order > MAX_ORDER) order = MAX_ORDER;
+        insert_free(h, off, order);
+        off += (size_t)1 << order;
+    }
+    return true;
+}
+
+/* Function: myinit
+ * -------------------------
+ * Parameters:
+ *     heap_start - a void * to the beginning of heap
+ *     heap_size - a size_t representation
+ *                 of the payload size
+ *
+ * Returns: boolean representation of if heap instantiation
+ *          was successful
+ *
+ * This function is called by the test harness calls with every
+ * fresh script. It wipes the default heap instance clean and
+ * starts fresh over the given segment.
+ */
+bool myinit(void *heap_start, size_t heap_size) {
+    return heap_init(&default_heap, heap_start, heap_size);
+}
+
+/* Function: heap_create
+ * -------------------------
+ * Parameters:
+ *     start - a void * to the memory the new heap will own
+ *     size - the size_t number of bytes at start
+ *
+ * Returns: a heap_t * to the new heap instance, or NULL if
+ *          the memory is too small to hold one
+ *
+ * This function makes an independent heap instance. Its
+ * bookkeeping sits at the front of the memory it is given
+ * and the rest becomes its segment.
+ */
+heap_t *heap_create(void *start, size_t size) {
+    size_t meta_size = roundup(sizeof(heap_t), ALIGNMENT);
+    if (!start || size <= meta_size + 2 * MIN_BLOCK_SIZE) return NULL;
+
+    heap_t *h = (heap_t *)start;
+    if (!heap_init(h, (char *)start + meta_size, size - meta_size)) return NULL;
+    return h;
+}
+
+/* Function: heap_destroy
+ * -------------------------
+ * Parameters:
+ *     h - a pointer to the heap instance to drop
+ *
+ * Returns: NA
+ *
+ * This function drops a whole heap instance in O(1) without
+ * walking its blocks. Every pointer it handed out dies with it
+ * and its memory can be reused as soon as this returns.
+ */
+void heap_destroy(heap_t *h) {
+    if (!h || h == &default_heap) return;
+    memset(h, 0, sizeof(heap_t));
+}
+
+/* Function: heap_malloc
+ * -------------------------
+ * Parameters:
+ *     h - a pointer to the heap instance
+ *     requested_size - a size_t representation
+ *               of the payload size to be allocated
+ *
+ * Returns: the void * representation of the payload address
+ *
+ * This function rounds the request up to an order, takes the
+ * first block of the smallest non-empty order at or above it
+ * with one find-first-set, and splits it down to size.
+ */
+void *heap_malloc(heap_t *h, size_t requested_size) {
+    if (requested_size <= 0 || requested_size > h->segment_size) return NULL;
+
+    size_t needed = order_for(requested_size);
+    if (needed > MAX_ORDER) return NULL;
+    unsigned long fits = h->order_bits & (~0UL << needed);
+    if (fits == 0) return NULL;
+
+    size_t order = __builtin_ctzl(fits);
+    size_t off = block_off(h, h->free_lists[order]);
+    remove_free(h, off, order);
+    split_down(h, off, order, needed);
+    return block_at(h, off);
+}
+
+/* Function: heap_free
+ * -------------------------
+ * Parameters:
+ *     h - a pointer to the heap instance
+ *     ptr - a void * to the payload
+ *           to be freed
+ *
+ * Returns: NA
+ *
+ * This function frees a block and merges it with its buddy for
+ * as long as the buddy is a free block of the same order, one
+ * order map lookup per level. Pointers outside the segment or
+ * not at the start of an allocated block are ignored.
+ */
+void heap_free(heap_t *h, void *ptr) {
+    if (!ptr || (char *)ptr < h->segment_start
+        || (char *)ptr >= h->segment_start + h->segment_size) return;
+    size_t off = block_off(h, ptr);
+    if ((off & (MIN_BLOCK_SIZE - 1)) || !(*map_at(h, off) & TAKEN_BIT)) return;
+
+    size_t order = *map_at(h, off) & ORDER_MASK;
+    *map_at(h, off) = 0;
+    while (order < MAX_ORDER) {
+        size_t buddy = buddy_of(h, off, order);
+        if (!is_free_of_order(h, buddy, order)) break;
+        remove_free(h, buddy, order);
+        if (buddy < off) off = buddy;
+        order += 1;
+    }
+    insert_free(h, off, order);
+}
+
+/* Function: heap_free_sized
+ * -------------------------
+ * Parameters:
+ *     h - a pointer to the heap instance
+ *     ptr - a void * to the payload
+ *           to be freed
+ *     size - the size_t last asked for with ptr
+ *
+ * Returns: NA
+ *
+ * This function frees a block like heap_free. The order map byte
+ * it reads to check the block also holds its order, so the size
+ * is not needed.
+ */
+void heap_free_sized(heap_t *h, void *ptr, size_t size) {
+    (void)size;
+    heap_free(h, ptr);
+}
+
+/* Function: heap_usable_size
+ * -------------------------
+ * Parameters:
+ *     h - a pointer to the heap instance
+ *     ptr - a void * to a payload
+ *
+ * Returns: the size_t number of bytes the payload can hold, or 0
+ *          for NULL or a pointer that is not an allocated block
+ *
+ * This function reads the block's order from the order map; the
+ * whole power of two is the caller's.
+ */
+size_t heap_usable_size(heap_t *h, void *ptr) {
+    if (!ptr || (char *)ptr < h->segment_start
+        || (char *)ptr >= h->segment_start + h->segment_size) return 0;
+    size_t off = block_off(h, ptr);
+    if ((off & (MIN_BLOCK_SIZE - 1)) || !(*map_at(h, off) & TAKEN_BIT)) return 0;
+    return (size_t)1 << (*map_at(h, off) & ORDER_MASK);
+}
+
+/* Function: heap_realloc
+ * -------------------------
+ * Parameters:
+ *     h - a pointer to the heap instance
+ *     old_ptr - a pointer to the space to reallocate
+ *     new_size - a size_t representation
+ *                 of the payload size
+ *
+ * Returns: a void * to the payload of the new memory
+ *
+ * This function shrinks a block in place by freeing its upper
+ * halves. It grows a block in place when the block is the lower
+ * half at every order it has to climb and each of those buddies
+ * is free and whole. Otherwise the block moves: a new one is
+ * allocated, the payload copied, and the old one freed. If no new
+ * block can be had the old one stays as it was.
+ */
+void *heap_realloc(heap_t *h, void *old_ptr, size_t new_size) {
+    if (!old_ptr) return heap_malloc(h, new_size);
+    if (new_size <= 0) {
+        heap_free(h, old_ptr);
+        return NULL; // a zero size frees the block
+    } else if (new_size > h->segment_size) {
+        return NULL; // can never fit, and the old block stays as it was
+    }
+
+    size_t off = block_off(h, old_ptr);
+    size_t order = *map_at(h, off) & ORDER_MASK;
+    size_t needed = order_for(new_size);
+    if (needed <= order) {
+        split_down(h, off, order, needed);
+        return old_ptr;
+    }
+
+    size_t climb = order;
+    while (climb < needed && !(off & ((size_t)1 << climb))
+           && is_free_of_order(h, buddy_of(h, off, climb), climb)) {
+        climb += 1;
+    }
+    if (climb == needed) {
+        for (; order < needed; order++) {
+            remove_free(h, off + ((size_t)1 << order), order);
+        }
+        *map_at(h, off) = TAKEN_BIT | needed;
+        return old_ptr;
+    }
+
+    void *new_request = heap_malloc(h, new_size);
+    if (new_request == NULL) return NULL;
+    memcpy(new_request, old_ptr, (size_t)1 << order);
+    heap_free(h, old_ptr);
+    return new_request;
+}
+
+/* Function: mymalloc
+ * -------------------------
+ * Parameters:
+ *     requested_size - a size_t representation
+ *               of the payload size to be allocated
+ *
+ * Returns: the void * representation of the payload address
+ *
+ * This function allocates from the default heap instance.
+ */
+void *mymalloc(size_t requested_size) {
+    return heap_malloc(&default_heap, requested_size);
+}
+
+/* Function: myfree
+ * -------------------------
+ * Parameters:
+ *     ptr - a void * to the payload
+ *           to be freed
+ *
+ * Returns: NA
+ *
+ * This function frees a block of the default heap instance.
+ */
+void myfree(void *ptr) {
+    heap_free(&default_heap, ptr);
+}
+
+/* Function: myfree_sized
+ * -------------------------
+ * Parameters:
+ *     ptr - a void * to the payload
+ *           to be freed
+ *     size - the size_t last asked for with ptr
+ *
+ * Returns: NA
+ *
+ * This function frees a block of known size of the default heap instance.
+ */
+void myfree_sized(void *ptr, size_t size) {
+    heap_free_sized(&default_heap, ptr, size);
+}
+
+/* Function: my_usable_size
+ * -------------------------
+ * Parameters:
+ *     ptr - a void * to a payload
+ *
+ * Returns: the size_t number of bytes the payload can hold
+ *
+ * This function reports the room in a block of the default heap instance.
+ */
+size_t my_usable_size(void *ptr) {
+    return heap_usable_size(&default_heap, ptr);
+}
+
+/* Function: myrealloc
+ * -------------------------
+ * Parameters:
+ *     old_ptr - a pointer to the space to reallocate
+ *     new_size - a size_t representation
+ *                 of the payload size
+ *
+ * Returns: a void * to the payload of the new memory
+ *
+ * This function reallocates a block of the default heap instance.
+ */
+void *myrealloc(void *old_ptr, size_t new_size) {
+    return heap_realloc(&default_heap, old_ptr, new_size);
+}
+
+/* Function: heap_validate
+ * -------------------------
+ * Parameters:
+ *     h - a pointer to the heap instance
+ *
+ * Returns: boolean representation of
+ *         if heap validation was successful
+ *
+ * This function walks every block through the order map, checking
+ * that each is aligned to its size, that the units inside it have
+ * no order map byte and that no free block has a free buddy of its
+ * own order, then walks every free list, checking that its blocks
+ * are free, of the list's order and linked both ways, and that the
+ * bitmap shows exactly the non-empty lists.
+ */
+bool heap_validate(heap_t *h) {
+    size_t free_blocks = 0;
+
+    if (h->segment_start == NULL) {
+        printf("Broken Initialization of Heap");
+        breakpoint();
+        return false;
+    }
+
+    for (size_t off = h->first_off; off < h->end_off;) {
+        uint8_t entry = *map_at(h, off);
+        size_t order = entry & ORDER_MASK;
+        size_t size = (size_t)1 << order;
+        if (!(entry & (FREE_BIT | TAKEN_BIT)) || order < MIN_ORDER || order > MAX_ORDER
+            || (off & (size - 1)) || off + size > h->end_off) {
+            printf("Your block at offset %zu has a bad order map byte", off);
+            breakpoint();
+            return false;
+        }
+        for (size_t unit = off + MIN_BLOCK_SIZE; unit < off + size; unit += MIN_BLOCK_SIZE) {
+            if (*map_at(h, unit) != 0) {
+                printf("Your block at offset %zu overlaps another", off);
+                breakpoint();
+                return false;
+            }
+        }
+        if (entry & FREE_BIT) {
+            free_blocks += 1;
+            if (is_free_of_order(h, buddy_of(h, off, order), order)) {
+                printf("Your free block at offset %zu was not merged with its buddy", off);
+                breakpoint();
+                return false;
+            }
+        }
+        off += size;
+    }
+
+    size_t listed = 0;
+    for (size_t order = 0; order < NUM_ORDERS; order++) {
+        node *looping_adr = h->free_lists[order];
+        if ((looping_adr != NULL) != ((h->order_bits >> order) & 0x1)) {
+            printf("Your order bitmap does not match order %zu", order);
+            breakpoint();
+            return false;
+        }
+        while (looping_adr != NULL) {
+            listed += 1;
+            if ((char *)looping_adr < h->segment_start
+                || (char *)looping_adr >= h->segment_start + h->segment_size) {
+                printf("Your free list links outside of the heap");
+                breakpoint();
+                return false;
+            }
+            if (*map_at(h, block_off(h, looping_adr)) != (FREE_BIT | order)) {
+                printf("Something in your free list is not free or of the wrong order");
+                breakpoint();
+                return false;
+            }
+            node *next = link_node(h, looping_adr->next);
+            if (next != NULL && link_node(h, next->prev) != looping_adr) {
+                printf("Your free list prev and next links do not match");
+                breakpoint();
+                return false;
+            }
+            looping_adr = next;
+        }
+    }
+    if (listed != free_blocks || listed != h->blocks_in_free) {
+        printf("Your free lists do not hold every free block");
+        breakpoint();
+        return false;
+    }
+    return true;
+}
+
+/* Function: validate_heap
+ * -------------------------
+ * Parameters: NA
+ *
+ * Returns: boolean representation of
+ *         if heap validation was successful
+ *
+ * This function validates the default heap instance.
+ */
+bool validate_heap() {
+    return heap_validate(&default_heap);
+}
+
+/* Function: heap_dump
+ * -------------------------
+ * Parameters:
+ *     h - a pointer to the heap instance
+ *
+ * Returns: NA
+ *
+ * This function will create a meaningful visualization of the
+ * heap used for debugging. It prints the free status, order, size
+ * and pointer of every block, then every non-empty order with its
+ * blocks' links.
+ */
+void heap_dump(heap_t *h) {
+    printf("Heap Visualization:\n");
+    printf("----------------------------------------------\n");
+    for (size_t off = h->first_off; off < h->end_off;) {
+        uint8_t entry = *map_at(h, off);
+        size_t order = entry & ORDER_MASK;
+        printf("%s", (entry & FREE_BIT) ? "  FREE   " : "ALLOCATED");
+        printf(",  Order: %zu,  Block Size: %zu,  Pointer: %p \n", order, (size_t)1 << order,
+               (void *)block_at(h, off));
+        if (!(entry & (FREE_BIT | TAKEN_BIT)) || order < MIN_ORDER) break; // broken map
+        off += (size_t)1 << order;
+    }
+
+    printf("----------------------------------------------\n");
+    printf("\n");
+    printf("Free List Visualization: %zu (Amount in Free List) \n", h->blocks_in_free);
+    printf("Order Bitmap: %#lx \n", h->order_bits);
+    printf("----------------------------------------------\n");
+    for (size_t order = 0; order < NUM_ORDERS; order++) {
+        node *looping_adr = h->free_lists[order];
+        if (looping_adr == NULL) continue;
+        printf("Order %zu:\n", order);
+        while (looping_adr != NULL) {
+            printf("FREE,  Block Size: %zu,  Pointer: %p,  Link: %u,  Prev Link: %u,  Next Link: %u \n",
+                   (size_t)1 << order, (void *)looping_adr, node_link(h, looping_adr),
+                   looping_adr->prev, looping_adr->next);
+            looping_adr = link_node(h, looping_adr->next);
+        }
+    }
+}
+
+/* Function: heap_snapshot
+ * -------------------------
+ * Parameters:
+ *     h - a pointer to the heap instance
+ *     path - the file name to write the snapshot to
+ *
+ * Returns: boolean representation of if the snapshot was written
+ *
+ * This function writes every block of the segment in the format
+ * heap.h describes, 4 bytes a block, reading sizes and states from
+ * the order map.
+ */
+bool heap_snapshot(heap_t *h, const char *path) {
+    FILE *fp = fopen(path, "wb");
+    if (fp == NULL) return false;
+
+    heap_snap_hdr_t snap_hdr;
+    memcpy(snap_hdr.magic, HEAP_SNAP_MAGIC, sizeof(snap_hdr.magic));
+    snap_hdr.segment_size = h->end_off - h->first_off;
+    snap_hdr.blocks = 0;
+    snap_hdr.huge_blocks = 0;
+    for (size_t off = h->first_off; off < h->end_off; off += (size_t)1 << (*map_at(h, off) & ORDER_MASK)) {
+        snap_hdr.blocks += 1;
+    }
+
+    bool ok = fwrite(&snap_hdr, sizeof(snap_hdr), 1, fp) == 1;
+    for (size_t off = h->first_off; ok && off < h->end_off;) {
+        uint8_t entry = *map_at(h, off);
+        uint32_t word = ((uint32_t)1 << (entry & ORDER_MASK))
+                        | ((entry & FREE_BIT) ? HEAP_SNAP_FREE : HEAP_SNAP_USED);
+        ok = fwrite(&word, sizeof(word), 1, fp) == 1;
+        off += (size_t)1 << (entry & ORDER_MASK);
+    }
+    return (fclose(fp) == 0) && ok;
+}
+
+/* Function: dump_heap
+ * -------------------------
+ * Parameters: NA
+ *
+ * Returns: NA
+ *
+ * This function dumps the default heap instance.
+ */
+void dump_heap() {
+    heap_dump(&default_heap);
+}
@@ -4,42 +4,336 @@
  * -------------------------
  *
  * This file represents an implementation of an
- * explicit  heap allocator with header and minimum
- * payload sizes of 16. It utilzes a plethora of helper
+ * explicit  heap allocator with a header size of 4 and a
+ * minimum payload size of 12. It utilzes a plethora of helper
  * functions to simlify the code alongside my implementations 
  * of myinit, mymalloc, myfree, myrealloc, validate_heap, 
  * and dump_heap with coalescing and in-place realloc.
  *
+ * Free blocks are kept in segregated free lists: one exact
+ * bin per 8-byte payload size below SMALL_BIN_LIMIT and, above
+ * it, SUB_BINS bins per power of two, each an eighth of the
+ * range. A bitmap of non-empty bins lets mymalloc jump straight
+ * to the first bin whose blocks are all large enough for a
+ * request, so a malloc takes a bounded number of steps however
+ * many blocks are free.
+ *
+ * Under the best-fit policy (heap_set_policy, or the -DBEST_FIT
+ * build for new heaps) free blocks from SMALL_BIN_LIMIT up leave
+ * the power-of-two bins for a treap ordered by size and address,
+ * so the smallest block that fits is found in O(log n).
+ *
+ * Headers are 4 bytes: the block size, a multiple of 8, with the
+ * allocated, prev-free and slab flags in its low bits. Payloads
+ * stay 8-aligned since every header sits 4 bytes short of an
+ * 8-byte boundary. Free-list links are 32-bit offsets from the
+ * start of the heap instead of pointers, which caps a heap at
+ * MAX_HEAP_SIZE and lets a free block fit in 16 bytes.
+ *
+ * Free blocks also carry a footer (a copy of their payload size
+ * in their last 4 bytes), and every header keeps a prev-free bit,
+ * so myfree can find and merge a free left neighbour in O(1)
+ * without allocated blocks paying for a footer.
+ *
+ * Building with -DTHREAD_SAFE makes the allocator usable from
+ * many threads on one myinit segment: the free lists sit behind
+ * one lock, and each thread keeps a cache of small blocks in
+ * front of it that is refilled and flushed in batches. A free
+ * that finds the lock taken does not wait for it: the payload is
+ * pushed onto the heap's lock-free remote-free list, which the
+ * next thread to take the lock drains in one batch.
+ *
+ * Requests of at most SLAB_MAX_OBJ bytes are served from slabs:
+ * page-sized blocks carved out of the segment and cut into equal
+ * objects with no header each, tracked by a per-slab free bitmap.
+ * A bitmap of slab pages per heap lets myfree recognise them.
+ *
+ * A growable heap (heap_create_growable, or myinit with a NULL
+ * start) reserves address space up front and commits it a chunk at
+ * a time as mymalloc runs out, handing a large free tail back to
+ * the OS so the resident size follows what is live.
+ *
+ * Requests of at least a heap's mmap threshold skip the segment
+ * and get a mapping of their own, which mremap grows without a
+ * copy and myfree unmaps at once. Growable heaps use this by default.
+ *
+ * Every heap keeps running counts for heap_stats, updated as
+ * blocks come and go so reading them never walks the heap. In the
+ * THREAD_SAFE build the default heap's counts live in the thread
+ * caches, so the fast paths touch no shared counter.
+ *
+ * heap_profile_start turns on a sampling profiler that records
+ * the backtrace of about one allocation per sample period of bytes
+ * and tracks it until it is freed, for heap_profile_dump to write
+ * out as a pprof heap profile.
+ *
+ * A heap made with heap_create_region is a region instead:
+ * allocation bumps a pointer, frees are no-ops, and heap_reset
+ * rolls the whole region back to a saved mark in O(1).
+ *
+ * Building with -DHARDENED turns on cheap checks meant to stay on
+ * in production. Free-list, thread cache and remote-free links are
+ * stored xor'd with per-heap secrets, so a use-after-free write
+ * cannot aim them anywhere. Every block payload ends in a canary
+ * word. A free or realloc checks the block's header and canary and
+ * aborts on a double free, an overrun into the next header or a
+ * pointer the heap never handed out.
+ *
+ * In the deferred coalescing mode (heap_set_coalesce, or the
+ * -DDEFERRED_COALESCE build for new heaps) a freed block of up to
+ * QUICK_MAX_PL bytes goes onto an exact-size quick list without
+ * merging and is handed straight back to the next request of its
+ * size. The quick lists are merged into the free lists in one
+ * address-ordered sweep when a request finds nothing else that
+ * fits or when they hold more than QUICK_LIMIT bytes.
+ *
+ * heap_malloc_batch and heap_free_batch take the lock once for a
+ * whole set of same-sized blocks: a batch is carved back to back
+ * out of one free block where it can, and a batch of frees goes
+ * through the same sorted sweep as the quick lists.
+ *
  * Citation: Linked List notes from CS106B for handling 
  * the free list node operations and Helper Hours.
  */
+#define _GNU_SOURCE // for mremap
 #include "./allocator.h"
 #include "./debug_break.h"
+#include "./heap.h"
+#include <errno.h>
+#include <execinfo.h>
+#include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#ifdef THREAD_SAFE
+#include <pthread.h>
+#endif
+#ifdef HARDENED
+#include <sys/random.h>
+#include <time.h>
+#endif
 
-typedef size_t hdr;
+typedef uint32_t hdr;
+typedef uint32_t link_t; // offset of a free block from heap_start, 0 for none
 
 // struct definition for casting of a block
 typedef struct node
 {
     hdr b_hdr;
-    hdr *prev;
-    hdr *next;
+    link_t prev;
+    link_t next;
 } node;
 
-// setting up globals
-static hdr *segment_start;
-static size_t segment_size;
-static hdr *segment_end;
-static node *start_of_free;
-static size_t blocks_in_free;
-
 // constants used for arithmitic
-#define HDR_SIZE 8 
-#define MIN_BLOCK_SIZE 24
-#define MIN_PL 16
+#define HDR_SIZE 4
+#define MIN_BLOCK_SIZE 16
+#define MIN_PL 12
+#define PREV_FREE_BIT 0x2
+#define SLAB_BIT 0x4
 #define MAX_REQUEST_SIZE (1 << 30)
+#define MAX_HEAP_SIZE (((size_t)1 << 32) - GROW_CHUNK) // links and headers are 32 bits
+
+// constants used for the segregated free lists
+#define NUM_BINS 256
+#define SMALL_BIN_LIMIT 256
+#define NUM_SMALL_BINS ((SMALL_BIN_LIMIT - MIN_PL + ALIGNMENT - 1) / ALIGNMENT)
+#define SUB_BIN_LOG2 3
+#define SUB_BINS (1 << SUB_BIN_LOG2) // bins each power of two above SMALL_BIN_LIMIT is split into
+#define BIN_MAP_BITS 64
+#define BIN_MAP_WORDS (NUM_BINS / BIN_MAP_BITS)
+#define BIN_SCAN_LIMIT 8
+
+// constants used for the small-object slabs
+#define SLAB_SIZE 4096
+#define SLAB_PL (SLAB_SIZE - HDR_SIZE) // leaves the next header in the page's last word
+#define SLAB_CLASSES 6
+#define SLAB_MAX_OBJ 64
+#define SLAB_MAP_WORDS 8
+
+// constants used for growable heaps
+#define GROW_CHUNK (64 * 1024)
+#define GROW_TRIM (2 * GROW_CHUNK) // free tail size that is handed back
+
+// constants used for huge allocations with a mapping of their own
+#define MMAP_THRESHOLD (256 * 1024) // default for growable heaps
+#define PAGE_SIZE 4096
+
+// constants used for the per-thread caches of the THREAD_SAFE build
+#define TCACHE_BLOCK_CLASSES 16
+#define TCACHE_CLASSES (SLAB_CLASSES + TCACHE_BLOCK_CLASSES)
+#define TCACHE_MAX_PL (MIN_PL + (TCACHE_BLOCK_CLASSES - 1) * ALIGNMENT)
+#define TCACHE_BATCH 16
+#define TCACHE_LIMIT 64
+
+// constants used for the sampling heap profiler
+#define PROF_TABLE_BITS 16
+#define PROF_TABLE_SIZE (1 << PROF_TABLE_BITS) // samples tracked at most, less a quarter
+#define PROF_MAX_DEPTH 32
+#define PROF_SKIP_FRAMES 2 // backtrace and profile_malloc
+
+// constants used for deferred coalescing
+#define QUICK_CLASSES 64
+#define QUICK_MAX_PL (MIN_PL + (QUICK_CLASSES - 1) * ALIGNMENT)
+#define QUICK_LIMIT (64 * 1024) // quick list bytes that trigger a consolidation
+#define FREE_BATCH_SORT 256 // blocks heap_free_batch sorts at a time
+
+// lines heap_dump prints per section before it points at heap_snapshot
+#define DUMP_MAX_LINES 256
+
+// constants used by the -DHARDENED build
+#ifdef HARDENED
+#define CANARY_SIZE 4 // guard word that ends every block payload
+#else
+#define CANARY_SIZE 0
+#endif
+
+// header at the start of every slab page, followed by its objects
+typedef struct slab
+{
+    unsigned long free_map[SLAB_MAP_WORDS]; // bit set = object free
+    struct slab *prev;
+    struct slab *next;
+    size_t obj_size;
+    size_t nobjs;
+    size_t nfree;
+    size_t cls;
+} slab;
+
+#define SLAB_HDR_SIZE (sizeof(slab))
+
+#ifdef HARDENED
+// every object has room for a pending-free mark after its first word
+static const size_t slab_sizes[SLAB_CLASSES] = {16, 24, 32, 40, 48, 64};
+#else
+static const size_t slab_sizes[SLAB_CLASSES] = {8, 16, 24, 32, 48, 64};
+#endif
+
+// placement policy new heaps start with
+#ifdef BEST_FIT
+#define DEFAULT_POLICY HEAP_BEST_FIT
+#else
+#define DEFAULT_POLICY HEAP_FIRST_FIT
+#endif
+
+// coalescing mode new heaps start with
+#ifdef DEFERRED_COALESCE
+#define DEFAULT_COALESCE HEAP_COALESCE_DEFERRED
+#else
+#define DEFAULT_COALESCE HEAP_COALESCE_IMMEDIATE
+#endif
+
+// header at the start of every huge mapping, right before the payload
+typedef struct huge
+{
+    struct huge *prev;
+    struct huge *next;
+    struct heap *owner; // tells a huge payload from a stray pointer
+    size_t map_size;
+    hdr pad; // keeps the payload 8-aligned
+    hdr b_hdr; // allocated block size, where back_to_hdr looks
+} huge;
+
+#define HUGE_HDR_SIZE (sizeof(huge))
+
+// per-call counters of a heap, and of a thread cache in the THREAD_SAFE build
+typedef struct op_counts
+{
+    size_t allocs[HEAP_STATS_CLASSES]; // by payload size class
+    size_t frees[HEAP_STATS_CLASSES];
+    size_t alloc_bytes; // payload bytes handed out
+    size_t free_bytes; // payload bytes given back
+    size_t reallocs_in_place;
+    size_t reallocs_moved;
+} op_counts;
+
+// everything one heap instance needs, so several can live side by side
+struct heap
+{
+    hdr *segment_start;
+    size_t segment_size;
+    hdr *segment_end;
+    node *free_bins[NUM_BINS];
+    uint64_t bin_map[BIN_MAP_WORDS]; // bit set = the bin has a free block
+    heap_policy_t policy;
+    node *free_tree; // best fit: large free blocks, prev/next link left/right
+    size_t blocks_in_free;
+    heap_coalesce_t coalesce;
+    node *quick_lists[QUICK_CLASSES]; // deferred: freed blocks by exact size, next link only
+    size_t quick_blocks;
+    size_t quick_bytes; // payload bytes on the quick lists
+    unsigned long heap_gen;
+    bool is_region; // bump allocation with no-op frees
+    char *bump;
+    slab *slab_partial[SLAB_CLASSES]; // slabs with free objects
+    unsigned long *slab_map; // one bit per page, set for slab pages
+    char *page_base;
+    void *heap_start; // the memory heap_init was given, map included
+    size_t heap_size;
+    char *reserve_start; // address space of a growable heap, NULL otherwise
+    char *reserve_end;
+    bool tail_free; // the block ending at segment_end is free
+    size_t mmap_threshold; // 0 keeps every request in the segment
+    huge *huge_list; // live huge mappings
+    size_t huge_bytes; // mapped by the live huge mappings
+    size_t bytes_in_free; // payload bytes of the free blocks
+    size_t peak_in_use; // most bytes ever taken, headers and huge mappings included
+    op_counts counts;
+    hdr *check_cursor; // block heap_validate_step resumes at, NULL to start over
+#ifdef HARDENED
+    link_t link_key; // xor'd into every free-list link
+    hdr canary_key; // mixed with a block's address into its canary
+    uintptr_t chain_key; // xor'd into thread cache and remote-free links
+    uint64_t pending_key; // marks a slab object freed but not yet back in its slab
+#endif
+#ifdef THREAD_SAFE
+    pthread_mutex_t lock; // guards the segment and free lists
+    void *remote_frees; // payloads freed while the lock was taken
+#endif
+};
+
+// the instance behind myinit and the other my* functions
+#ifdef THREAD_SAFE
+static heap_t default_heap = { .lock = PTHREAD_MUTEX_INITIALIZER };
+#else
+static heap_t default_heap;
+#endif
+
+#ifdef THREAD_SAFE
+#define LOCK_HEAP(h) pthread_mutex_lock(&(h)->lock)
+#define UNLOCK_HEAP(h) pthread_mutex_unlock(&(h)->lock)
+#define DRAIN_REMOTE(h) remote_drain(h)
+#else
+#define LOCK_HEAP(h)
+#define UNLOCK_HEAP(h)
+#define DRAIN_REMOTE(h)
+#endif
+
+#ifdef HARDENED
+#define LINK_KEY(h) ((h)->link_key)
+#define CHAIN_KEY(h) ((h)->chain_key)
+#define HARDEN_FAIL(what, ptr) heap_corrupt(what, ptr)
+#define ARM_CANARY(h, block) arm_canary(h, block)
+#define HARDEN_ALLOC(h, ptr, fresh) harden_alloc(h, ptr, fresh)
+#define HARDEN_FREE(h, ptr, mark) harden_free(h, ptr, mark)
+#else
+#define LINK_KEY(h) 0
+#define CHAIN_KEY(h) ((void)(h), (uintptr_t)0)
+#define HARDEN_FAIL(what, ptr) do { } while (0)
+#define ARM_CANARY(h, block) do { } while (0)
+#define HARDEN_ALLOC(h, ptr, fresh) do { } while (0)
+#define HARDEN_FREE(h, ptr, mark) do { } while (0)
+#endif
+
+void *central_malloc(heap_t *h, size_t requested_size);
+void central_free(heap_t *h, void *ptr);
+void huge_release_all(heap_t *h);
+void note_peak(heap_t *h);
+#ifdef HARDENED
+void heap_corrupt(const char *what, void *ptr);
+void harden_alloc(heap_t *h, void *ptr, bool fresh);
+void harden_free(heap_t *h, void *ptr, bool mark);
+#endif
 
 /* Function: roundup (from bump.c)
  * -----------------
@@ -56,6 +350,22 @@ size_t roundup(size_t sz, size_t mult) {
     return (sz + mult - 1) & ~(mult - 1);
 }
 
+/* Function: align_pl
+ * -----------------
+ * Parameters:
+ *     sz - a size_t payload size being requested
+ * 
+ * Returns: the size_t payload size a block needs for it
+ *
+ * This function rounds a payload up so that header and payload
+ * together are a multiple of ALIGNMENT, which keeps the payload of
+ * the next block aligned too. Every block payload is 4 more than a
+ * multiple of 8.
+ */
+size_t align_pl(size_t sz) {
+    return roundup(sz + HDR_SIZE, ALIGNMENT) - HDR_SIZE;
+}
+
 /* Function: is_avail
  * -----------------
  * Parameters:
@@ -79,11 +389,13 @@ bool is_avail(node *hdr_ptr) {
  * Returns: a size_t representation of the payload size
  *
  * This function returns the payload associated with the parameter
- * pointer and removes the LSB to give an accurate number.
+ * pointer, masking off the flag bits of the block size in the
+ * header and taking away the header itself.
  */
 size_t grab_pl(node *hdr_node) {
     if (!hdr_node) return 0;
-    return ((hdr_node->b_hdr) & ~0x7);
+    size_t block_size = (hdr_node->b_hdr) & ~0x7;
+    return block_size ? block_size - HDR_SIZE : 0;
 }
 
 /* Function: skip_to_next_header
@@ -138,12 +450,80 @@ node *back_to_hdr(node *hdr_ptr) {
  * 
  * Returns: NA
  *
- * This function sets a header's payload and confirms
- * a properly set LSB.
+ * This function sets a header's payload, stored as the block
+ * size, and confirms a properly set LSB, keeping the header's
+ * prev-free bit.
  */
 void set_pl(node *node_hdr, size_t size) {
     if (!node_hdr) return;
-    node_hdr->b_hdr = (size & ~0x1);
+    node_hdr->b_hdr = ((size + HDR_SIZE) & ~0x7) | (node_hdr->b_hdr & PREV_FREE_BIT);
+}
+
+/* Function: make_hdr
+ * -----------------
+ * Parameters:
+ *     node_hdr - a pointer to where a new header is written
+ *     size - size_t representation of the payload to be set
+ * 
+ * Returns: NA
+ *
+ * This function writes a brand new free header for a block
+ * split off the end of an allocated block, so its prev-free
+ * bit starts cleared.
+ */
+void make_hdr(node *node_hdr, size_t size) {
+    if (!node_hdr) return;
+    node_hdr->b_hdr = ((size + HDR_SIZE) & ~0x7);
+}
+
+/* Function: write_footer
+ * -----------------
+ * Parameters:
+ *     node_hdr - a pointer to a free node
+ * 
+ * Returns: NA
+ *
+ * This function copies a free block's payload size into
+ * its last 4 bytes so the block to its right can find it.
+ */
+void write_footer(node *node_hdr) {
+    if (!node_hdr) return;
+    *(hdr *)((char *)node_hdr + grab_pl(node_hdr)) = grab_pl(node_hdr);
+}
+
+/* Function: mark_right_neighbor
+ * -----------------
+ * Parameters:
+ *     h - a pointer to the heap instance
+ *     node_hdr - a pointer to a node whose status just changed
+ *     now_free - whether node_hdr is now free
+ * 
+ * Returns: NA
+ *
+ * This function updates the prev-free bit in the header to the
+ * right of node_hdr, if there is one before h->segment_end. For the
+ * last block it updates h->tail_free instead, which a growable heap
+ * reads as the prev-free bit of the chunk it adds next.
+ */
+void mark_right_neighbor(heap_t *h, node *node_hdr, bool now_free) {
+    node *right_hdr = skip_to_next_header((hdr *)node_hdr);
+    if ((hdr *)right_hdr == h->segment_end) h->tail_free = now_free;
+    if (right_hdr == NULL || (hdr *)right_hdr >= h->segment_end) return;
+
+#ifdef THREAD_SAFE
+    // the neighbour may be allocated to a thread reading its header unlocked
+    if (now_free) {
+        __atomic_fetch_or(&right_hdr->b_hdr, PREV_FREE_BIT, __ATOMIC_RELAXED);
+    } else {
+        __atomic_fetch_and(&right_hdr->b_hdr, ~(hdr)PREV_FREE_BIT, __ATOMIC_RELAXED);
+    }
+    return;
+#endif
+    if (now_free) {
+        right_hdr->b_hdr |= PREV_FREE_BIT;
+    } else {
+        right_hdr->b_hdr &= ~PREV_FREE_BIT;
+    }
 }
 
 /* Function: to_pl
@@ -160,6 +540,116 @@ void *to_pl(node *looping_adr) {
     return (char *)looping_adr + HDR_SIZE;
 }
 
+#ifdef HARDENED
+/* Function: heap_corrupt
+ * -----------------
+ * Parameters:
+ *     what - a description of the corruption found
+ *     ptr - the void * it was found at
+ * 
+ * Returns: does not return
+ *
+ * This function reports corruption found by the HARDENED build
+ * and aborts, since carrying on would hand the corruption on.
+ */
+void heap_corrupt(const char *what, void *ptr) {
+    fprintf(stderr, "heap corruption: %s (%p)\n", what, ptr);
+    abort();
+}
+
+/* Function: harden_secret
+ * -----------------
+ * Parameters: NA
+ * 
+ * Returns: a random nonzero uint64_t
+ *
+ * This function draws the secrets of a HARDENED heap from the
+ * kernel, falling back to the clock and a stack address if
+ * getrandom is not available.
+ */
+uint64_t harden_secret(void) {
+    uint64_t secret = 0;
+    if (getrandom(&secret, sizeof(secret), GRND_NONBLOCK) != (ssize_t)sizeof(secret)) {
+        struct timespec t;
+        clock_gettime(CLOCK_MONOTONIC, &t);
+        secret = ((uint64_t)t.tv_nsec << 32) ^ (uint64_t)t.tv_sec ^ (uint64_t)(uintptr_t)&secret;
+        secret *= 0x9e3779b97f4a7c15ULL; // spread the bits over the whole word
+    }
+    return secret | 1;
+}
+
+/* Function: canary_of
+ * -----------------
+ * Parameters:
+ *     h - a pointer to the heap instance
+ *     block - a node * to an allocated block
+ * 
+ * Returns: the hdr canary the block's last payload word holds
+ *
+ * This function mixes the heap's canary key with the block's
+ * address, so a canary copied from another block does not pass.
+ */
+hdr canary_of(heap_t *h, node *block) {
+    return h->canary_key ^ (hdr)((uintptr_t)block >> 3);
+}
+
+/* Function: arm_canary
+ * -----------------
+ * Parameters:
+ *     h - a pointer to the heap instance
+ *     block - a node * to a block just handed out
+ * 
+ * Returns: NA
+ *
+ * This function writes the block's canary into the last word of
+ * its payload, which the caller's size left room for.
+ */
+void arm_canary(heap_t *h, node *block) {
+    size_t pl = (__atomic_load_n(&block->b_hdr, __ATOMIC_RELAXED) & ~0x7) - HDR_SIZE;
+    *(hdr *)((char *)block + pl) = canary_of(h, block);
+}
+#endif
+
+/* Function: link_node
+ * -----------------
+ * Parameters:
+ *     h - a pointer to the heap instance
+ *     off - a link_t read from a free block or tree node
+ * 
+ * Returns: a node * to the block the link names, or NULL
+ *
+ * This function turns a free-list link back into a pointer. Links
+ * are offsets from h->heap_start, where the slab page map sits, so
+ * no block is ever at offset 0. The HARDENED build stores them
+ * xor'd with the heap's link key and checks that a decoded link
+ * lands on a header inside the heap.
+ */
+node *link_node(heap_t *h, link_t off) {
+    off ^= LINK_KEY(h);
+    if (off == 0) return NULL;
+#ifdef HARDENED
+    if (off >= h->heap_size || ((size_t)h->heap_start + off + HDR_SIZE) % ALIGNMENT != 0) {
+        heap_corrupt("free-list link points outside the heap", (char *)h->heap_start + off);
+    }
+#endif
+    return (node *)((char *)h->heap_start + off);
+}
+
+/* Function: node_link
+ * -----------------
+ * Parameters:
+ *     h - a pointer to the heap instance
+ *     n - a node * to a free block, or NULL
+ * 
+ * Returns: the link_t that names the block in a free list
+ *
+ * This function is the inverse of link_node.
+ */
+link_t node_link(heap_t *h, node *n) {
+    if (n == NULL) return LINK_KEY(h);
+    return (link_t)((char *)n - (char *)h->heap_start) ^ LINK_KEY(h);
+}
+
 /* Function: make_taken
  * -----------------
  * Parameters:
@@ -175,44 +665,315 @@ void make_taken(node *node_hdr) {
     node_hdr->b_hdr |= 0x1;
 }
 
+/* Function: bin_index
+ * -----------------
+ * Parameters:
+ *    pl - the size_t payload size of a free block
+ * 
+ * Returns: the size_t index of the bin that holds the payload size
+ *
+ * This function maps a payload size to its free list. Payloads
+ * below SMALL_BIN_LIMIT get an exact bin per multiple of 8. Larger
+ * payloads go by their top bit and the SUB_BIN_LOG2 bits under it,
+ * so each power of two is split into SUB_BINS bins.
+ */
+size_t bin_index(size_t pl) {
+    if (pl < SMALL_BIN_LIMIT) return (pl - MIN_PL) / ALIGNMENT;
+
+    size_t top = 63 - __builtin_clzl(pl);
+    size_t sub = (pl >> (top - SUB_BIN_LOG2)) & (SUB_BINS - 1);
+    size_t index = NUM_SMALL_BINS + (top - __builtin_ctzl(SMALL_BIN_LIMIT)) * SUB_BINS + sub;
+    return (index < NUM_BINS) ? index : NUM_BINS - 1;
+}
+
+/* Function: fit_bin_index
+ * -----------------
+ * Parameters:
+ *    needed_sz - the size_t rounded payload size being requested
+ * 
+ * Returns: the size_t index of the first bin every block of which
+ *          can hold the request
+ *
+ * This function rounds a request up to the start of the next bin
+ * before mapping it, unless it already starts one, so any block
+ * filed at or above the result fits. Small bins are exact already.
+ */
+size_t fit_bin_index(size_t needed_sz) {
+    if (needed_sz < SMALL_BIN_LIMIT) return bin_index(needed_sz);
+
+    size_t top = 63 - __builtin_clzl(needed_sz);
+    return bin_index(needed_sz + ((size_t)1 << (top - SUB_BIN_LOG2)) - 1);
+}
+
+/* Function: bin_marked
+ * -----------------
+ * Parameters:
+ *    h - a pointer to the heap instance
+ *    bin - the size_t index of a bin
+ * 
+ * Returns: boolean representation of if the bitmap has the bin
+ *          down as non-empty
+ *
+ * This function reads one bit of the bin bitmap.
+ */
+bool bin_marked(heap_t *h, size_t bin) {
+    return (h->bin_map[bin / BIN_MAP_BITS] >> (bin % BIN_MAP_BITS)) & 0x1;
+}
+
+/* Function: first_bin_from
+ * -----------------
+ * Parameters:
+ *    h - a pointer to the heap instance
+ *    bin - the size_t index of the first bin to look at
+ * 
+ * Returns: the size_t index of the first non-empty bin from bin
+ *          on, or NUM_BINS if there is none
+ *
+ * This function finds a bin with at most BIN_MAP_WORDS loads of
+ * the bitmap.
+ */
+size_t first_bin_from(heap_t *h, size_t bin) {
+    for (size_t word = bin / BIN_MAP_BITS; word < BIN_MAP_WORDS; word++) {
+        uint64_t bits = h->bin_map[word];
+        if (word == bin / BIN_MAP_BITS) bits &= ~(uint64_t)0 << (bin % BIN_MAP_BITS);
+        if (bits) return word * BIN_MAP_BITS + __builtin_ctzll(bits);
+    }
+    return NUM_BINS;
+}
+
+/* Function: in_tree
+ * -----------------
+ * Parameters:
+ *    h - a pointer to the heap instance
+ *    pl - the size_t payload size of a free block
+ * 
+ * Returns: boolean representation of if the block belongs in the
+ *          best-fit tree instead of a bin
+ *
+ * This function sends large free blocks to the tree under best fit.
+ */
+bool in_tree(heap_t *h, size_t pl) {
+    return h->policy == HEAP_BEST_FIT && pl >= SMALL_BIN_LIMIT;
+}
+
+/* Function: tree_less
+ * -----------------
+ * Parameters:
+ *    a - a node * to a free block in or entering the tree
+ *    b - a node * to another one
+ * 
+ * Returns: boolean representation of if a sorts before b
+ *
+ * This function orders the tree by payload size, then by address,
+ * so every free block has a key of its own.
+ */
+bool tree_less(node *a, node *b) {
+    if (grab_pl(a) != grab_pl(b)) return grab_pl(a) < grab_pl(b);
+    return a < b;
+}
+
+/* Function: tree_prio
+ * -----------------
+ * Parameters:
+ *    n - a node * to a free block in the tree
+ * 
+ * Returns: the size_t treap priority of the block
+ *
+ * This function hashes the block's address into its priority, so
+ * the tree stays balanced in expectation without storing one.
+ */
+size_t tree_prio(node *n) {
+    return ((size_t)n >> 3) * 0x9E3779B97F4A7C15UL;
+}
+
+/* Function: tree_insert
+ * -----------------
+ * Parameters:
+ *    h - a pointer to the heap instance
+ *    root - a node * to the root of a (sub)tree
+ *    n - a node * to the free block to insert
+ * 
+ * Returns: a node * to the new root of the (sub)tree
+ *
+ * This function inserts a block as a leaf and rotates it up while
+ * its priority beats its parent's. The block's prev and next links
+ * are its left and right children.
+ */
+node *tree_insert(heap_t *h, node *root, node *n) {
+    if (root == NULL) {
+        n->prev = node_link(h, NULL);
+        n->next = node_link(h, NULL);
+        return n;
+    }
+    if (tree_less(n, root)) {
+        node *left = tree_insert(h, link_node(h, root->prev), n);
+        root->prev = node_link(h, left);
+        if (tree_prio(left) > tree_prio(root)) { // rotate right
+            root->prev = left->next;
+            left->next = node_link(h, root);
+            return left;
+        }
+    } else {
+        node *right = tree_insert(h, link_node(h, root->next), n);
+        root->next = node_link(h, right);
+        if (tree_prio(right) > tree_prio(root)) { // rotate left
+            root->next = right->prev;
+            right->prev = node_link(h, root);
+            return right;
+        }
+    }
+    return root;
+}
+
+/* Function: tree_merge
+ * -----------------
+ * Parameters:
+ *    h - a pointer to the heap instance
+ *    a - a node * to a tree whose keys all sort before b's
+ *    b - a node * to another tree
+ * 
+ * Returns: a node * to the root of the joined tree
+ *
+ * This function joins the two subtrees of a removed block.
+ */
+node *tree_merge(heap_t *h, node *a, node *b) {
+    if (a == NULL) return b;
+    if (b == NULL) return a;
+    if (tree_prio(a) > tree_prio(b)) {
+        a->next = node_link(h, tree_merge(h, link_node(h, a->next), b));
+        return a;
+    }
+    b->prev = node_link(h, tree_merge(h, a, link_node(h, b->prev)));
+    return b;
+}
+
+/* Function: tree_delete
+ * -----------------
+ * Parameters:
+ *    h - a pointer to the heap instance
+ *    root - a node * to the root of a (sub)tree
+ *    n - a node * to a free block in it
+ * 
+ * Returns: a node * to the new root of the (sub)tree
+ *
+ * This function follows the block's key down to it and puts the
+ * merge of its children in its place.
+ */
+node *tree_delete(heap_t *h, node *root, node *n) {
+    if (root == NULL) return NULL;
+    if (root == n) return tree_merge(h, link_node(h, n->prev), link_node(h, n->next));
+    if (tree_less(n, root)) {
+        root->prev = node_link(h, tree_delete(h, link_node(h, root->prev), n));
+    } else {
+        root->next = node_link(h, tree_delete(h, link_node(h, root->next), n));
+    }
+    return root;
+}
+
+/* Function: tree_best_fit
+ * -----------------
+ * Parameters:
+ *    h - a pointer to the heap instance
+ *    needed_sz - the size_t rounded payload size being requested
+ * 
+ * Returns: a node * to the smallest free block that can hold the
+ *          request, or NULL if none can
+ *
+ * This function walks one path down the tree.
+ */
+node *tree_best_fit(heap_t *h, size_t needed_sz) {
+    node *best = NULL;
+    node *root = h->free_tree;
+    while (root != NULL) {
+        if (grab_pl(root) >= needed_sz) {
+            best = root;
+            root = link_node(h, root->prev);
+        } else {
+            root = link_node(h, root->next);
+        }
+    }
+    return best;
+}
+
+/* Function: cursor_absorbed
+ * -----------------
+ * Parameters:
+ *    h - a pointer to the heap instance
+ *    gone - a node * to a block whose header is being merged away
+ *    into - a node * to the block taking it in
+ * 
+ * Returns: NA
+ *
+ * This function keeps heap_validate_step's cursor on a real header
+ * when the block under it is merged into its left neighbour.
+ */
+void cursor_absorbed(heap_t *h, node *gone, node *into) {
+    if ((hdr *)gone == h->check_cursor) h->check_cursor = (hdr *)into;
+}
+
 /* Function: delete_node
  * -----------------
  * Parameters:
+ *    h - a pointer to the heap instance
  *    node_to_be_deleted - a pointer to a node to be deleted
  *                         from the free list
  * 
  * Returns: NA
  *
- * This function deletes a parameter pointer from the free list by
+ * This function deletes a parameter pointer from its bin's free list by
  * analying where the node to be deleted is in the free list (first,
- * last, middle, or sole node). 
+ * last, middle, or sole node), or from the best-fit tree. The node's
+ * payload must not have changed since it was added, as the payload
+ * picks the bin. A validation cursor on the node moves on to the
+ * next block, whose header outlives whatever the caller does next.
  *
  * Citation: Linked List notes from CS106B handout.
  */
-void delete_node(node *node_to_be_deleted) {
-    if (!start_of_free  || !node_to_be_deleted) return;
+void delete_node(heap_t *h, node *node_to_be_deleted) {
+    if (!node_to_be_deleted) return;
+    if ((hdr *)node_to_be_deleted == h->check_cursor) { // its header may be about to go
+        h->check_cursor = skip_to_next_header((hdr *)node_to_be_deleted);
+    }
+    if (in_tree(h, grab_pl(node_to_be_deleted))) {
+        h->free_tree = tree_delete(h, h->free_tree, node_to_be_deleted);
+        h->blocks_in_free -= 1;
+        h->bytes_in_free -= grab_pl(node_to_be_deleted);
+        return;
+    }
+    size_t bin = bin_index(grab_pl(node_to_be_deleted));
+    if (!h->free_bins[bin]) return;
 
-    blocks_in_free -= 1;
-    hdr *prev_ptr = node_to_be_deleted->prev;
-    hdr *next_ptr = node_to_be_deleted->next;
+    h->blocks_in_free -= 1;
+    h->bytes_in_free -= grab_pl(node_to_be_deleted);
+    node *prev_ptr = link_node(h, node_to_be_deleted->prev);
+    node *next_ptr = link_node(h, node_to_be_deleted->next);
+#ifdef HARDENED
+    // both neighbours must point back before they are relinked
+    link_t self = node_link(h, node_to_be_deleted);
+    if ((prev_ptr ? prev_ptr->next != self : h->free_bins[bin] != node_to_be_deleted)
+        || (next_ptr && next_ptr->prev != self)) {
+        heap_corrupt("free-list neighbours do not point back", to_pl(node_to_be_deleted));
+    }
+#endif
     
     // deleting first node
     if (!prev_ptr && next_ptr) { // only a next pointer
-        start_of_free = (node *)next_ptr;
-        ((node *)next_ptr)->prev = NULL;
+        h->free_bins[bin] = next_ptr;
+        next_ptr->prev = node_link(h, NULL);
         
     // deleting only node in free list
     } else if (!next_ptr && !prev_ptr) {
-        start_of_free = NULL;
+        h->free_bins[bin] = NULL;
+        h->bin_map[bin / BIN_MAP_BITS] &= ~((uint64_t)1 << (bin % BIN_MAP_BITS));
 
     // deleting last node
     } else if (!next_ptr && prev_ptr) { // only a prev ptr
-        ((node *)prev_ptr)->next = NULL;
+        prev_ptr->next = node_link(h, NULL);
 
     // any middle node
     } else {
-        ((node *)prev_ptr)->next = next_ptr;
-        ((node *)next_ptr)->prev = prev_ptr;
+        prev_ptr->next = node_to_be_deleted->next;
+        next_ptr->prev = node_to_be_deleted->prev;
     }
     node_to_be_deleted = NULL;
 }
@@ -220,64 +981,133 @@ void delete_node(node *node_to_be_deleted) {
 /* Function: add_node
  * -----------------
  * Parameters:
+ *    h - a pointer to the heap instance
  *    node_node - a pointer to a node to be added
  *                         to the free list
  * 
  * Returns: NA
  *
- * This function adds a parameter pointer node to the free list by
- * putting it first in the free list or making it the only node
- * in the free list.
+ * This function adds a parameter pointer node to the free list of
+ * its bin by putting it first in the bin or making it the only node
+ * in the bin, and marks the bin as non-empty. Large blocks go to
+ * the best-fit tree instead under that policy.
  *
  * Citation: Linked List notes from CS106B.
  */
-void add_node(node *new_node) {
-
-    if (new_node == NULL || new_node == start_of_free) return; //invalid node parameter
-    blocks_in_free += 1;
+void add_node(heap_t *h, node *new_node) {
+    if (new_node == NULL) return;
+    if (in_tree(h, grab_pl(new_node))) {
+        h->free_tree = tree_insert(h, h->free_tree, new_node);
+        h->blocks_in_free += 1;
+        h->bytes_in_free += grab_pl(new_node);
+        return;
+    }
+    size_t bin = bin_index(grab_pl(new_node));
+    if (new_node == h->free_bins[bin]) return; //invalid node parameter
+    h->blocks_in_free += 1;
+    h->bytes_in_free += grab_pl(new_node);
 
-    if (start_of_free == NULL) { //if nothing is in free list
-        new_node->prev = NULL;
-        new_node->next = NULL;
+    if (h->free_bins[bin] == NULL) { //if nothing is in the bin
+        new_node->prev = node_link(h, NULL);
+        new_node->next = node_link(h, NULL);
+        h->bin_map[bin / BIN_MAP_BITS] |= (uint64_t)1 << (bin % BIN_MAP_BITS);
         
     } else { // make it in front of everything else
-        new_node->next = (hdr *)start_of_free;
-        (start_of_free)->prev = (hdr *)new_node;
-        new_node->prev = NULL; 
+        new_node->next = node_link(h, h->free_bins[bin]);
+        (h->free_bins[bin])->prev = node_link(h, new_node);
+        new_node->prev = node_link(h, NULL);
     }
-    start_of_free = new_node;
+    h->free_bins[bin] = new_node;
 }
 
-/* Function: coalesce
+/* Function: find_fit
  * -----------------
  * Parameters:
- *    node_hdr - a pointer to a node 
+ *    h - a pointer to the heap instance
+ *    needed_sz - the size_t rounded payload size being requested
  * 
- * Returns: NA
+ * Returns: a node * to a free block that can hold the request,
+ *          or NULL if no free block is large enough
  *
- * This function checks if a right header in the free list
- * can be coalesced together with the left node header. They will
- * only combine if both adjacent nodes are free to decrease fragmentation. 
+ * This function looks in the request's own bin first. Exact small
+ * bins fit with their first node; a larger bin is scanned for at
+ * most BIN_SCAN_LIMIT nodes, for a tighter fit, before the bitmap
+ * is used to jump to the first non-empty bin from fit_bin_index on,
+ * whose first node always fits. The rest of the request's own bin
+ * is never walked, so a malloc can miss a block there that fits,
+ * one no more than an eighth of a power of two larger than the
+ * request, in exchange for a bounded search. Under best fit the
+ * first non-empty exact bin from the request's up is the best fit,
+ * and otherwise the tree is searched.
+ */
+node *find_fit(heap_t *h, size_t needed_sz) {
+    size_t bin = bin_index(needed_sz);
+    if (h->policy == HEAP_BEST_FIT) {
+        if (bin < NUM_SMALL_BINS) {
+            uint64_t small_bins = h->bin_map[0] & (~(uint64_t)0 << bin) & (((uint64_t)1 << NUM_SMALL_BINS) - 1);
+            if (small_bins) return h->free_bins[__builtin_ctzll(small_bins)];
+        }
+        return tree_best_fit(h, needed_sz);
+    }
+    node *looping_adr = h->free_bins[bin];
+
+    for (size_t i = 0; looping_adr != NULL && i < BIN_SCAN_LIMIT; i++) {
+        if (grab_pl(looping_adr) >= needed_sz) return looping_adr;
+        looping_adr = link_node(h, looping_adr->next);
+    }
+
+    size_t fit_bin = first_bin_from(h, fit_bin_index(needed_sz));
+    return (fit_bin < NUM_BINS) ? h->free_bins[fit_bin] : NULL;
+}
+
+/* Function: coalesce
+ * -----------------
+ * Parameters:
+ *    h - a pointer to the heap instance
+ *    node_hdr - a pointer to a free node 
+ * 
+ * Returns: a node * to the header of the coalesced block
  *
+ * This function merges a free block with its right neighbour, found
+ * through skip_to_next_header, and its left neighbour, found through
+ * the prev-free bit and the left footer, whenever they are free to
+ * decrease fragmentation. The merged block gets a footer and its right
+ * neighbour's prev-free bit is set. The node must not be in a free list
+ * yet, since merging changes its bin; callers add the returned header
+ * with add_node afterwards.
  */
-void coalesce(node *node_hdr) {
+node *coalesce(heap_t *h, node *node_hdr) {
   
-    if (node_hdr == NULL || (hdr*)node_hdr < segment_start
-        || (hdr*)node_hdr > segment_end) return;
+    if (node_hdr == NULL || (hdr*)node_hdr < h->segment_start
+        || (hdr*)node_hdr >= h->segment_end) return node_hdr;
     node *right_hdr = skip_to_next_header((hdr *)node_hdr);
 
-    // checks new header is valid
-    if( right_hdr == NULL || (hdr*)right_hdr < segment_start
-        || (hdr*)right_hdr > segment_end || !is_avail(right_hdr)) return;
+    // merges right if the new header is valid and free
+    if (right_hdr != NULL && (hdr*)right_hdr < h->segment_end && is_avail(right_hdr)) {
+        delete_node(h, right_hdr);
+        node_hdr->b_hdr += (grab_pl(right_hdr) + HDR_SIZE);
+    }
+
+    // merges left, whose payload size sits in the footer just before us
+    if (node_hdr->b_hdr & PREV_FREE_BIT) {
+        size_t left_size = *((hdr *)node_hdr - 1);
+        node *left_hdr = (node *)((char *)node_hdr - left_size - HDR_SIZE);
+        delete_node(h, left_hdr);
+        left_hdr->b_hdr += (grab_pl(node_hdr) + HDR_SIZE);
+        cursor_absorbed(h, node_hdr, left_hdr);
+        node_hdr = left_hdr;
+    }
 
-    node_hdr->b_hdr += (grab_pl(right_hdr) + HDR_SIZE);
     make_free(node_hdr);
-    delete_node(right_hdr);
+    write_footer(node_hdr);
+    mark_right_neighbor(h, node_hdr, true);
+    return node_hdr;
 } 
 
 /* Function: split_block
  * -----------------
  * Parameters:
+ *     h - a pointer to the heap instance
  *     start - a pointer to the starting node
  *     new_hdr - a pointer to the right node
  *     new_s - the size_t new payload of the first header
@@ -288,18 +1118,18 @@ void coalesce(node *node_hdr) {
  * This function sets the first and right header's header, 
  * updates the free list, coalesces, and returns the address to the payload.
  */
-void *split_block(node *start, node *new_hdr, size_t rem, size_t new_s) {
-    set_pl(new_hdr, rem);
+void *split_block(heap_t *h, node *start, node *new_hdr, size_t rem, size_t new_s) {
+    make_hdr(new_hdr, rem);
     set_pl(start, new_s);
     make_taken(start);
-    add_node(new_hdr);
-    coalesce(new_hdr);
+    add_node(h, coalesce(h, new_hdr));
     return to_pl(start);
 }
 
 /* Function: old_realloc
  * -----------------
 * Parameters:
+ *     h - a pointer to the heap instance
  *     start - a pointer to the starting node
  *     old_ptr - a pointer to the original node
  *     new_size - the size_t represenation of the new payload 
@@ -310,18 +1140,19 @@ void *split_block(node *start, node *new_hdr, size_t rem, size_t new_s) {
  * request. This is a last resort of realloc in explicit. This 
  * returns the address to the new payload.
  */
-void *old_realloc(node *start, node *old_ptr, size_t new_size) {
-    void *new_request = mymalloc(new_size);
-    memmove(new_request, old_ptr, new_size);
+void *old_realloc(heap_t *h, node *start, node *old_ptr, size_t new_size) {
+    void *new_request = central_malloc(h, new_size);
+    if (new_request == NULL) return NULL;
+    memmove(new_request, old_ptr, grab_pl(start));
     make_free(start);
-    add_node(start);
-    coalesce(start); 
+    add_node(h, coalesce(h, start));
     return new_request;
 }
 
 /* Function: split_rem
  * -----------------
  * Parameters:
+ *     h - a pointer to the heap instance
  *     start - a pointer to the starting node
  *     new_hdr - a pointer to the right node
  *     new_s - the size_t new payload of the first header
@@ -332,245 +1163,3327 @@ void *old_realloc(node *start, node *old_ptr, size_t new_size) {
  * This function sets the first and right header's header, 
  * updates the free list, and returns the address to the payload.
  */
-void *split_rem(node *start, node *new_hdr, size_t new_s, size_t rem) {
+void *split_rem(heap_t *h, node *start, node *new_hdr, size_t new_s, size_t rem) {
     set_pl(start, new_s);
     make_taken(start);
-    set_pl(new_hdr, rem);
-    make_free(new_hdr);
-    add_node(new_hdr);
+    make_hdr(new_hdr, rem);
+    write_footer(new_hdr);
+    mark_right_neighbor(h, new_hdr, true);
+    add_node(h, new_hdr);
     return to_pl(start);
 }
 
-/* Function: return_malloc
- * -----------------
+/* Function: heap_capacity
+ * -------------------------
  * Parameters:
- *     looping_adr - 
+ *     h - a pointer to the heap instance
  * 
- * Returns: a void * representation of the payload
+ * Returns: the size_t number of bytes the segment can grow to
  *
- * This function does unified bookkeeping for mymalloc by
- * removing the node that was just malloced and returning
- * the new payload.
+ * This function gives the segment size, or for a growable heap
+ * everything up to the end of its reserved address space.
  */
-void *return_malloc(node *looping_adr) {
-    delete_node(looping_adr);
-    return to_pl(looping_adr);
+size_t heap_capacity(heap_t *h) {
+    if (h->reserve_end == NULL) return h->segment_size;
+    return h->reserve_end - (char *)h->segment_start;
 }
 
-/* Function: myinit
+/* Function: heap_grow
  * -------------------------
  * Parameters:
- *     heap_start - a void * to the beginning of heap
- *     heap_size - a size_t representation
+ *     h - a pointer to the heap instance
+ *     needed_sz - the size_t payload size that did not fit
+ * 
+ * Returns: boolean representation of if the segment grew
+ *
+ * This function commits the next whole chunks of a growable heap's
+ * reserved address space and adds them past segment_end as one free
+ * block, merged with a free last block. A growable segment ends one
+ * header short of the committed memory, so payloads stay aligned.
+ * The caller holds the heap lock.
+ */
+bool heap_grow(heap_t *h, size_t needed_sz) {
+    if (h->reserve_end == NULL) return false;
+
+    char *committed_end = (char *)h->segment_end + HDR_SIZE;
+    size_t grow = roundup(needed_sz + HDR_SIZE + MIN_BLOCK_SIZE, GROW_CHUNK);
+    size_t room = h->reserve_end - committed_end;
+    if (grow > room) grow = room;
+    if (grow < MIN_BLOCK_SIZE) return false;
+    if (mprotect(committed_end, grow, PROT_READ | PROT_WRITE) != 0) return false;
+
+    node *new_block = (node *)h->segment_end;
+    make_hdr(new_block, grow - HDR_SIZE);
+    if (h->tail_free) new_block->b_hdr |= PREV_FREE_BIT;
+    write_footer(new_block);
+
+    // tcache_free and is_slab_ptr read segment_end without the lock
+    __atomic_store_n(&h->segment_end, (hdr *)((char *)h->segment_end + grow), __ATOMIC_RELAXED);
+    h->segment_size += grow;
+    h->heap_size += grow;
+    h->tail_free = true;
+    add_node(h, coalesce(h, new_block));
+    return true;
+}
+
+/* Function: heap_trim
+ * -------------------------
+ * Parameters:
+ *     h - a pointer to the heap instance
+ * 
+ * Returns: NA
+ *
+ * This function hands the end of a growable heap back to the OS once
+ * its last block is free and at least GROW_TRIM bytes, keeping one
+ * chunk of it so a heap that hovers at a boundary does not thrash.
+ * The pages are dropped with madvise and made inaccessible again.
+ * The caller holds the heap lock.
+ */
+void heap_trim(heap_t *h) {
+    if (h->reserve_end == NULL || !h->tail_free) return;
+
+    node *last = (node *)((char *)h->segment_end - HDR_SIZE - *((hdr *)h->segment_end - 1));
+    size_t pl = grab_pl(last);
+    if (pl < GROW_TRIM) return;
+
+    size_t release = (pl - GROW_CHUNK) & ~(size_t)(SLAB_SIZE - 1);
+    delete_node(h, last);
+    set_pl(last, pl - release);
+    write_footer(last);
+    add_node(h, last);
+
+    char *new_end = (char *)h->segment_end - release;
+    madvise(new_end + HDR_SIZE, release, MADV_DONTNEED);
+    mprotect(new_end + HDR_SIZE, release, PROT_NONE);
+    __atomic_store_n(&h->segment_end, (hdr *)new_end, __ATOMIC_RELAXED);
+    h->segment_size -= release;
+    h->heap_size -= release;
+    if (h->check_cursor >= h->segment_end) h->check_cursor = NULL; // a later grow could cover it
+}
+
+/* Function: grow_reserve
+ * -------------------------
+ * Parameters:
+ *     max_size - the size_t number of bytes of address space to reserve
+ *     committed - set to the size_t number of bytes made usable up front
+ * 
+ * Returns: a char * to the reserved address space, or NULL
+ *
+ * This function reserves address space for a growable heap without
+ * backing it, then commits enough of it for the heap bookkeeping, a
+ * slab page map covering all of it, and a first chunk. Callers cap
+ * max_size at MAX_HEAP_SIZE first.
+ */
+char *grow_reserve(size_t max_size, size_t *committed) {
+    max_size = roundup(max_size, GROW_CHUNK);
+    *committed = roundup(sizeof(heap_t) + max_size / SLAB_SIZE / 8 + GROW_CHUNK, GROW_CHUNK);
+    if (max_size < *committed) return NULL;
+
+    char *base = mmap(NULL, max_size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (base == MAP_FAILED) return NULL;
+    if (mprotect(base, *committed, PROT_READ | PROT_WRITE) != 0) {
+        munmap(base, max_size);
+        return NULL;
+    }
+    return base;
+}
+
+/* Function: quick_class
+ * -------------------------
+ * Parameters:
+ *     pl - the size_t payload size of a block, at most QUICK_MAX_PL
+ * 
+ * Returns: the size_t index of the quick list for that size
+ *
+ * This function picks a block's quick list, one per 8-byte payload size.
+ */
+size_t quick_class(size_t pl) {
+    return (pl - MIN_PL) / ALIGNMENT;
+}
+
+/* Function: quick_push
+ * -------------------------
+ * Parameters:
+ *     h - a pointer to the heap instance
+ *     block - a node * to an allocated block being freed
+ * 
+ * Returns: NA
+ *
+ * This function parks a freed block on its quick list without
+ * merging it. The block keeps its allocated bit, so its neighbours
+ * never merge into it and the validator walks over it as taken.
+ * A free of the block already at the head of its list is caught as
+ * a double free. The caller holds the heap lock.
+ */
+void quick_push(heap_t *h, node *block) {
+    size_t pl = grab_pl(block);
+    size_t cls = quick_class(pl);
+    if (h->quick_lists[cls] == block) {
+        HARDEN_FAIL("double free", to_pl(block));
+        return;
+    }
+    block->next = node_link(h, h->quick_lists[cls]);
+    h->quick_lists[cls] = block;
+    h->quick_blocks += 1;
+    h->quick_bytes += pl;
+}
+
+/* Function: quick_pop
+ * -------------------------
+ * Parameters:
+ *     h - a pointer to the heap instance
+ *     needed_sz - the size_t rounded payload size being requested
+ * 
+ * Returns: a node * to an allocated block of exactly needed_sz,
+ *          or NULL if its quick list is empty
+ *
+ * This function hands back the block freed last at the request's
+ * exact size. The caller holds the heap lock.
+ */
+node *quick_pop(heap_t *h, size_t needed_sz) {
+    if (needed_sz > QUICK_MAX_PL || h->quick_blocks == 0) return NULL;
+    size_t cls = quick_class(needed_sz);
+    node *block = h->quick_lists[cls];
+    if (block == NULL) return NULL;
+    h->quick_lists[cls] = link_node(h, block->next);
+    h->quick_blocks -= 1;
+    h->quick_bytes -= needed_sz;
+    return block;
+}
+
+/* Function: sort_by_address
+ * -------------------------
+ * Parameters:
+ *     h - a pointer to the heap instance
+ *     list - a node * to the first of count blocks chained by next
+ *     count - the size_t number of blocks on the list
+ * 
+ * Returns: a node * to the first block of the list in address order
+ *
+ * This function merge sorts a chain of allocated blocks by address,
+ * so merge_runs meets them from left to right.
+ */
+node *sort_by_address(heap_t *h, node *list, size_t count) {
+    if (count <= 1) return list;
+    node *mid = list;
+    for (size_t i = 1; i < count / 2; i++) mid = link_node(h, mid->next);
+    node *right = link_node(h, mid->next);
+    mid->next = node_link(h, NULL);
+    node *left = sort_by_address(h, list, count / 2);
+    right = sort_by_address(h, right, count - count / 2);
+
+    node *head = NULL;
+    node *tail = NULL;
+    while (left != NULL || right != NULL) {
+        node *pick;
+        if (right == NULL || (left != NULL && left < right)) {
+            pick = left;
+            left = link_node(h, left->next);
+        } else {
+            pick = right;
+            right = link_node(h, right->next);
+        }
+        if (tail == NULL) {
+            head = pick;
+        } else {
+            tail->next = node_link(h, pick);
+        }
+        tail = pick;
+    }
+    tail->next = node_link(h, NULL);
+    return head;
+}
+
+/* Function: sort_slice
+ * -------------------------
+ * Parameters:
+ *     slice - an array of len blocks
+ *     spare - room for len more
+ *     len - the size_t number of blocks in slice
+ * 
+ * Returns: NA
+ *
+ * This function sorts an array of blocks by address with a radix
+ * sort on their offsets from the lowest of them, one byte a pass,
+ * and only as many passes as the largest offset needs. Blocks
+ * carved together sit close, so a batch usually takes one or two
+ * passes, and unlike a comparison sort none of it branches on the
+ * order the blocks came in.
+ */
+void sort_slice(node **slice, node **spare, size_t len) {
+    char *low = (char *)slice[0];
+    char *high = low;
+    for (size_t i = 1; i < len; i++) {
+        if ((char *)slice[i] < low) low = (char *)slice[i];
+        if ((char *)slice[i] > high) high = (char *)slice[i];
+    }
+    size_t span = (size_t)(high - low) / ALIGNMENT;
+    for (size_t shift = 0; (span >> shift) != 0; shift += 8) {
+        size_t starts[257] = {0};
+        for (size_t i = 0; i < len; i++) {
+            starts[((((char *)slice[i] - low) / ALIGNMENT >> shift) & 0xff) + 1] += 1;
+        }
+        for (size_t digit = 0; digit < 256; digit++) starts[digit + 1] += starts[digit];
+        for (size_t i = 0; i < len; i++) {
+            spare[starts[(((char *)slice[i] - low) / ALIGNMENT >> shift) & 0xff]++] = slice[i];
+        }
+        memcpy(slice, spare, len * sizeof(node *));
+    }
+}
+
+/* Function: merge_runs
+ * -------------------------
+ * Parameters:
+ *     h - a pointer to the heap instance
+ *     all - a node * to the first of a chain of allocated blocks,
+ *           sorted by address
+ * 
+ * Returns: NA
+ *
+ * This function frees a sorted chain of blocks in one sweep from
+ * left to right: each block starts a run that takes in a free left
+ * neighbour and every free or chained block to its right, and the
+ * run becomes one free block with one header and footer. A block
+ * that is on the chain twice is a double free and is skipped the
+ * second time. The caller holds the heap lock.
+ */
+void merge_runs(heap_t *h, node *all) {
+    while (all != NULL) {
+        node *start = all;
+        hdr *end = skip_to_next_header((hdr *)start);
+        all = link_node(h, all->next);
+
+        // a free left neighbour, found through its footer, joins the run
+        if (start->b_hdr & PREV_FREE_BIT) {
+            size_t left_size = *((hdr *)start - 1);
+            node *left_hdr = (node *)((char *)start - left_size - HDR_SIZE);
+            delete_node(h, left_hdr);
+            cursor_absorbed(h, start, left_hdr);
+            start = left_hdr;
+        }
+
+        // and so does every free or chained block after it
+        while (end < h->segment_end) {
+            if ((node *)end == all) {
+                cursor_absorbed(h, all, start);
+                all = link_node(h, all->next);
+            } else if (is_avail((node *)end)) {
+                delete_node(h, (node *)end);
+            } else {
+                break;
+            }
+            end = skip_to_next_header(end);
+        }
+
+        make_hdr(start, (char *)end - (char *)start - HDR_SIZE);
+        write_footer(start);
+        mark_right_neighbor(h, start, true);
+        add_node(h, start);
+        while (all != NULL && (hdr *)all < end) {
+            HARDEN_FAIL("double free", to_pl(all));
+            all = link_node(h, all->next);
+        }
+    }
+}
+
+/* Function: quick_consolidate
+ * -------------------------
+ * Parameters:
+ *     h - a pointer to the heap instance
+ * 
+ * Returns: NA
+ *
+ * This function empties the quick lists into the free lists by
+ * sorting every quick block by address and merging them with their
+ * free neighbours in one sweep. The caller holds the heap lock.
+ */
+void quick_consolidate(heap_t *h) {
+    if (h->quick_blocks == 0) return;
+
+    // chain every quick list into one
+    node *all = NULL;
+    for (size_t cls = 0; cls < QUICK_CLASSES; cls++) {
+        node *block = h->quick_lists[cls];
+        while (block != NULL) {
+            node *next = link_node(h, block->next);
+            block->next = node_link(h, all);
+            all = block;
+            block = next;
+        }
+        h->quick_lists[cls] = NULL;
+    }
+    all = sort_by_address(h, all, h->quick_blocks);
+    h->quick_blocks = 0;
+    h->quick_bytes = 0;
+    merge_runs(h, all);
+    heap_trim(h);
+}
+
+/* Function: aligned_carve
+ * -------------------------
+ * Parameters:
+ *     h - a pointer to the heap instance
+ *     align - the size_t power of two the payload must be aligned to
+ *     needed_sz - the size_t rounded payload size
+ * 
+ * Returns: a node * to the new allocated block, or NULL
+ *
+ * This function takes a free block with room for the payload at the
+ * requested alignment and gives the leading gap back as its own free
+ * block instead of padding. The gap is pushed one more step of align
+ * when it would be too small to hold a free block. Any tail that can
+ * hold a block is split off and freed as well. Pending quick blocks
+ * are consolidated before the heap grows. The caller holds the
+ * heap lock.
+ */
+node *aligned_carve(heap_t *h, size_t align, size_t needed_sz) {
+    node *block = find_fit(h, needed_sz + align + MIN_BLOCK_SIZE);
+    if (block == NULL && h->quick_blocks != 0) {
+        quick_consolidate(h);
+        block = find_fit(h, needed_sz + align + MIN_BLOCK_SIZE);
+    }
+    if (block == NULL && heap_grow(h, needed_sz + align + MIN_BLOCK_SIZE)) {
+        block = find_fit(h, needed_sz + align + MIN_BLOCK_SIZE);
+    }
+    if (block == NULL) return NULL;
+
+    size_t pl = grab_pl(block);
+    delete_node(h, block);
+
+    char *payload = to_pl(block);
+    char *aligned = (char *)roundup((size_t)payload, align);
+    while (aligned != payload && (size_t)(aligned - payload) < MIN_BLOCK_SIZE) {
+        aligned += align;
+    }
+
+    // the leading gap becomes a free block of its own
+    node *taken = block;
+    if (aligned != payload) {
+        set_pl(block, aligned - payload - HDR_SIZE);
+        write_footer(block);
+        add_node(h, block);
+
+        taken = back_to_hdr((node *)aligned);
+        make_hdr(taken, 0);
+        taken->b_hdr |= PREV_FREE_BIT;
+        pl = (char *)to_pl(block) + pl - aligned;
+    }
+
+    // the tail becomes a free block if it can hold one
+    if (pl >= needed_sz + MIN_BLOCK_SIZE) {
+        set_pl(taken, needed_sz);
+        make_taken(taken);
+        node *new_hdr = skip_to_next_header((hdr *)taken);
+        make_hdr(new_hdr, pl - needed_sz - HDR_SIZE);
+        write_footer(new_hdr);
+        add_node(h, new_hdr);
+        return taken;
+    }
+    set_pl(taken, pl);
+    make_taken(taken);
+    mark_right_neighbor(h, taken, false);
+    return taken;
+}
+
+/* Function: slab_page_bit
+ * -------------------------
+ * Parameters:
+ *     h - a pointer to the heap instance
+ *     page - a pointer into a page of the segment
+ *     word - set to the slab map word that holds the page's bit
+ * 
+ * Returns: the unsigned long mask of the page's bit in *word
+ *
+ * This function finds where a page lives in the slab page map.
+ */
+unsigned long slab_page_bit(heap_t *h, void *page, unsigned long **word) {
+    size_t index = ((char *)page - h->page_base) / SLAB_SIZE;
+    *word = &h->slab_map[index / 64];
+    return 1UL << (index % 64);
+}
+
+/* Function: is_slab_ptr
+ * -------------------------
+ * Parameters:
+ *     h - a pointer to the heap instance
+ *     ptr - a void * to a payload or slab object
+ * 
+ * Returns: boolean representation of if ptr lies in a slab page
+ *
+ * This function looks the pointer's page up in the slab page map.
+ * The map word and segment end are read atomically since in the
+ * THREAD_SAFE build they are checked before taking the lock.
+ */
+bool is_slab_ptr(heap_t *h, void *ptr) {
+    if ((char *)ptr < h->page_base
+        || (hdr *)ptr >= __atomic_load_n(&h->segment_end, __ATOMIC_RELAXED)) return false;
+    unsigned long *word;
+    unsigned long bit = slab_page_bit(h, ptr, &word);
+    return (__atomic_load_n(word, __ATOMIC_RELAXED) & bit) != 0;
+}
+
+/* Function: slab_of
+ * -------------------------
+ * Parameters:
+ *     ptr - a void * to a slab object
+ * 
+ * Returns: a slab * to the slab holding the object
+ *
+ * This function masks a slab object's address down to its page.
+ */
+slab *slab_of(void *ptr) {
+    return (slab *)((size_t)ptr & ~(size_t)(SLAB_SIZE - 1));
+}
+
+/* Function: slab_class
+ * -------------------------
+ * Parameters:
+ *     requested_size - a size_t of at most SLAB_MAX_OBJ
+ * 
+ * Returns: the size_t index of the smallest slab class that fits
+ *
+ * This function picks a slab object size for a request.
+ */
+size_t slab_class(size_t requested_size) {
+    size_t cls = 0;
+    while (slab_sizes[cls] < requested_size) cls++;
+    return cls;
+}
+
+/* Function: slab_link
+ * -------------------------
+ * Parameters:
+ *     h - a pointer to the heap instance
+ *     sl - a slab * that just got a free object
+ * 
+ * Returns: NA
+ *
+ * This function puts a slab at the front of its class's partial list.
+ */
+void slab_link(heap_t *h, slab *sl) {
+    sl->prev = NULL;
+    sl->next = h->slab_partial[sl->cls];
+    if (sl->next != NULL) sl->next->prev = sl;
+    h->slab_partial[sl->cls] = sl;
+}
+
+/* Function: slab_unlink
+ * -------------------------
+ * Parameters:
+ *     h - a pointer to the heap instance
+ *     sl - a slab * on its class's partial list
+ * 
+ * Returns: NA
+ *
+ * This function takes a slab off its class's partial list.
+ */
+void slab_unlink(heap_t *h, slab *sl) {
+    if (sl->prev != NULL) {
+        sl->prev->next = sl->next;
+    } else {
+        h->slab_partial[sl->cls] = sl->next;
+    }
+    if (sl->next != NULL) sl->next->prev = sl->prev;
+    sl->prev = NULL;
+    sl->next = NULL;
+}
+
+/* Function: slab_new
+ * -------------------------
+ * Parameters:
+ *     h - a pointer to the heap instance
+ *     cls - the size_t slab class to make a slab for
+ * 
+ * Returns: a slab * to the new slab, or NULL if no page fits
+ *
+ * This function carves a page-aligned page out of the free lists,
+ * one word short so the next block's payload is page aligned too,
+ * marks its block header with SLAB_BIT and its page in the slab
+ * page map, and sets every object free. The caller holds the heap lock.
+ */
+slab *slab_new(heap_t *h, size_t cls) {
+    node *block = aligned_carve(h, SLAB_SIZE, SLAB_PL);
+    if (block == NULL) return NULL;
+    block->b_hdr |= SLAB_BIT;
+
+    slab *sl = to_pl(block);
+    memset(sl->free_map, 0, sizeof(sl->free_map));
+    sl->obj_size = slab_sizes[cls];
+    sl->nobjs = (SLAB_PL - SLAB_HDR_SIZE) / sl->obj_size;
+    sl->nfree = sl->nobjs;
+    sl->cls = cls;
+    for (size_t i = 0; i < sl->nobjs; i++) {
+        sl->free_map[i / 64] |= 1UL << (i % 64);
+    }
+
+    unsigned long *word;
+    unsigned long bit = slab_page_bit(h, sl, &word);
+    __atomic_fetch_or(word, bit, __ATOMIC_RELAXED);
+    slab_link(h, sl);
+    return sl;
+}
+
+/* Function: slab_malloc
+ * -------------------------
+ * Parameters:
+ *     h - a pointer to the heap instance
+ *     requested_size - a size_t of at most SLAB_MAX_OBJ
+ * 
+ * Returns: a void * to a slab object, or NULL if no slab page fits
+ *
+ * This function takes the first free object of a partial slab of
+ * the request's class, making a new slab if the class has none.
+ * The caller holds the heap lock.
+ */
+void *slab_malloc(heap_t *h, size_t requested_size) {
+    size_t cls = slab_class(requested_size);
+    slab *sl = h->slab_partial[cls];
+    if (sl == NULL) sl = slab_new(h, cls);
+    if (sl == NULL) return NULL;
+
+    size_t word = 0;
+    while (sl->free_map[word] == 0) word++;
+    size_t index = word * 64 + __builtin_ctzl(sl->free_map[word]);
+    sl->free_map[word] &= sl->free_map[word] - 1;
+
+    sl->nfree -= 1;
+    if (sl->nfree == 0) slab_unlink(h, sl);
+    void *object = (char *)sl + SLAB_HDR_SIZE + index * sl->obj_size;
+#ifdef HARDENED
+    ((uint64_t *)object)[1] = 0; // the pending-free mark of its last free
+#endif
+    return object;
+}
+
+/* Function: slab_free
+ * -------------------------
+ * Parameters:
+ *     h - a pointer to the heap instance
+ *     ptr - a void * to a slab object
+ * 
+ * Returns: NA
+ *
+ * This function sets an object's bit in its slab's free bitmap,
+ * ignoring pointers that are not at an object or already free. An
+ * empty slab goes back to the free lists unless it is the only
+ * partial slab of its class in a fixed-size heap. The caller holds
+ * the heap lock.
+ */
+void slab_free(heap_t *h, void *ptr) {
+    slab *sl = slab_of(ptr);
+    size_t offset = (char *)ptr - ((char *)sl + SLAB_HDR_SIZE);
+    size_t index = offset / sl->obj_size;
+    if ((char *)ptr < (char *)sl + SLAB_HDR_SIZE || offset % sl->obj_size != 0
+        || index >= sl->nobjs) {
+        HARDEN_FAIL("free of a pointer inside a slab object", ptr);
+        return;
+    }
+    if ((sl->free_map[index / 64] >> (index % 64)) & 0x1) {
+        HARDEN_FAIL("double free", ptr);
+        return;
+    }
+
+    sl->free_map[index / 64] |= 1UL << (index % 64);
+    if (sl->nfree == 0) slab_link(h, sl);
+    sl->nfree += 1;
+
+    // a growable heap keeps no empty slab, which could pin its tail
+    if (sl->nfree == sl->nobjs && (h->slab_partial[sl->cls] != sl || h->reserve_end != NULL)) {
+        slab_unlink(h, sl);
+        unsigned long *word;
+        unsigned long bit = slab_page_bit(h, sl, &word);
+        __atomic_fetch_and(word, ~bit, __ATOMIC_RELAXED);
+        back_to_hdr((node *)sl)->b_hdr &= ~SLAB_BIT;
+        central_free(h, sl);
+    }
+}
+
+/* Function: heap_init
+ * -------------------------
+ * Parameters:
+ *     h - a pointer to the heap instance to set up
+ *     heap_start - a void * to the beginning of heap
+ *     heap_size - a size_t representation
+ *                 of the payload size
+ * 
+ * Returns: boolean representation of if heap instantiation
+ *          was successful
+ *
+ * This function wipes a heap instance clean and starts fresh, 
+ * setting its fields, error checking, makes the first header, and
+ * sets up the free list in this explicit allocator. Anything past
+ * MAX_HEAP_SIZE is left unused. Huge mappings from before are
+ * unmapped, pending remote frees are dropped and the counts for
+ * heap_stats start over. Bumping heap_gen
+ * tells every thread cache that its blocks belong to the old heap.
+ * The caller holds the heap lock.
+ */
+bool heap_init(heap_t *h, void *heap_start, size_t heap_size) {
+    if (heap_size <= MIN_BLOCK_SIZE || !heap_start) return false;
+    if (heap_size > MAX_HEAP_SIZE) heap_size = MAX_HEAP_SIZE;
+
+    // the slab page map sits in front of the first block
+    // and covers every page a growable heap could ever commit
+    char *page_base = (char *)roundup((size_t)heap_start, SLAB_SIZE);
+    char *map_end = h->reserve_end ? h->reserve_end : (char *)heap_start + heap_size;
+    size_t pages = (page_base < map_end) ? (map_end - page_base + SLAB_SIZE - 1) / SLAB_SIZE : 0;
+    size_t map_size = roundup((pages + 63) / 64 * sizeof(unsigned long), ALIGNMENT);
+    if (map_size == 0) map_size = ALIGNMENT;
+    if (heap_size <= map_size + HDR_SIZE + MIN_BLOCK_SIZE) return false;
+
+    h->heap_start = heap_start;
+    h->heap_size = heap_size;
+    h->slab_map = (unsigned long *)heap_start;
+    h->page_base = page_base;
+    memset(h->slab_map, 0, map_size);
+    memset(h->slab_partial, 0, sizeof(h->slab_partial));
+
+    // the first header sits 4 bytes past the map so its payload is aligned
+    h->segment_start = (hdr *)((char *)heap_start + map_size + HDR_SIZE);
+    h->segment_size = (heap_size - map_size - HDR_SIZE) & ~(size_t)(ALIGNMENT - 1);
+    h->segment_end = (hdr *)((char *)h->segment_start + h->segment_size); 
+
+    if (h->segment_start == NULL || h->segment_end == NULL ||
+        (char *)h->segment_end - (char *)h->segment_start != (long)h->segment_size) {
+    return false;
+    }
+#ifdef HARDENED
+    // fresh secrets, as every old link and canary dies with the old heap
+    uint64_t secret = harden_secret();
+    h->link_key = (link_t)secret;
+    h->canary_key = (hdr)(secret >> 32);
+    h->chain_key = (uintptr_t)harden_secret();
+    h->pending_key = harden_secret();
+#endif
+
+    // set up inital node
+    make_hdr((node *)h->segment_start, h->segment_size - HDR_SIZE);
+    write_footer((node *)h->segment_start);
+    memset(h->free_bins, 0, sizeof(h->free_bins));
+    memset(h->bin_map, 0, sizeof(h->bin_map));
+    h->free_tree = NULL;
+    h->blocks_in_free = 0;
+    h->bytes_in_free = 0;
+    memset(h->quick_lists, 0, sizeof(h->quick_lists));
+    h->quick_blocks = 0;
+    h->quick_bytes = 0;
+    h->tail_free = true;
+    add_node(h, (node *)h->segment_start);
+    huge_release_all(h);
+    h->peak_in_use = 0;
+    memset(&h->counts, 0, sizeof(op_counts));
+    h->check_cursor = NULL;
+#ifdef THREAD_SAFE
+    __atomic_store_n(&h->remote_frees, NULL, __ATOMIC_RELAXED); // they belong to the old heap
+#endif
+    h->heap_gen += 1;
+    return true;
+}
+
+/* Function: myinit
+ * -------------------------
+ * Parameters:
+ *     heap_start - a void * to the beginning of heap
+ *     heap_size - a size_t representation
+ *                 of the payload size
+ * 
+ * Returns: boolean representation of if heap instantiation
+ *          was successful
+ *
+ * This function is called by the test harness calls with every 
+ * fresh script. It wipes the default heap instance clean and
+ * starts fresh over the given segment. A NULL heap_start makes
+ * the default heap growable instead, with heap_size bytes of
+ * address space to grow into and huge requests mapped on their own.
+ */
+bool myinit(void *heap_start, size_t heap_size) {
+    /* This must be called by a client before making any allocation
+     * requests.  The function returns true if initialization was 
+     * successful, or false otherwise. The myinit function can be 
+     * called to reset the heap to an empty state. When running 
+     * against a set of of test scripts, our test harness calls 
+     * myinit before starting each new script.
+     */
+    heap_t *h = &default_heap;
+    LOCK_HEAP(h);
+    if (h->reserve_start != NULL) { // drop the last growable segment
+        munmap(h->reserve_start, h->reserve_end - h->reserve_start);
+        h->reserve_start = NULL;
+        h->reserve_end = NULL;
+    }
+    if (heap_start == NULL) {
+        size_t committed;
+        if (heap_size > MAX_HEAP_SIZE) heap_size = MAX_HEAP_SIZE;
+        char *base = grow_reserve(heap_size, &committed);
+        if (base != NULL) {
+            h->reserve_start = base;
+            h->reserve_end = base + roundup(heap_size, GROW_CHUNK);
+            heap_start = base;
+            heap_size = committed;
+        }
+    }
+    h->mmap_threshold = (h->reserve_start != NULL) ? MMAP_THRESHOLD : 0;
+    h->policy = DEFAULT_POLICY;
+    h->coalesce = DEFAULT_COALESCE;
+    bool initialized = heap_init(h, heap_start, heap_size);
+    UNLOCK_HEAP(h);
+    return initialized;
+}
+
+/* Function: heap_create
+ * -------------------------
+ * Parameters:
+ *     start - a void * to the memory the new heap will own
+ *     size - the size_t number of bytes at start
+ * 
+ * Returns: a heap_t * to the new heap instance, or NULL if
+ *          the memory is too small to hold one
+ *
+ * This function makes an independent heap instance. Its
+ * bookkeeping sits at the front of the memory it is given
+ * and the rest becomes its segment.
+ */
+heap_t *heap_create(void *start, size_t size) {
+    size_t meta_size = roundup(sizeof(heap_t), ALIGNMENT);
+    if (!start || size <= meta_size + MIN_BLOCK_SIZE) return NULL;
+
+    heap_t *h = (heap_t *)start;
+    memset(h, 0, sizeof(heap_t));
+#ifdef THREAD_SAFE
+    pthread_mutex_init(&h->lock, NULL);
+#endif
+    h->policy = DEFAULT_POLICY;
+    h->coalesce = DEFAULT_COALESCE;
+    if (!heap_init(h, (char *)start + meta_size, size - meta_size)) return NULL;
+    return h;
+}
+
+/* Function: heap_create_growable
+ * -------------------------
+ * Parameters:
+ *     max_size - the size_t most bytes the heap may ever grow to
+ * 
+ * Returns: a heap_t * to the new heap instance, or NULL if the
+ *          address space could not be reserved
+ *
+ * This function makes a heap instance that maps its own memory.
+ * It starts with one chunk committed and grows into the rest of
+ * max_size on demand, so nothing has to be provisioned up front.
+ * Requests of MMAP_THRESHOLD bytes or more get their own mapping.
+ */
+heap_t *heap_create_growable(size_t max_size) {
+    size_t committed;
+    if (max_size > MAX_HEAP_SIZE) max_size = MAX_HEAP_SIZE;
+    char *base = grow_reserve(max_size, &committed);
+    if (base == NULL) return NULL;
+
+    size_t meta_size = roundup(sizeof(heap_t), ALIGNMENT);
+    heap_t *h = (heap_t *)base;
+    memset(h, 0, sizeof(heap_t));
+#ifdef THREAD_SAFE
+    pthread_mutex_init(&h->lock, NULL);
+#endif
+    h->reserve_start = base;
+    h->reserve_end = base + roundup(max_size, GROW_CHUNK);
+    h->mmap_threshold = MMAP_THRESHOLD;
+    h->policy = DEFAULT_POLICY;
+    h->coalesce = DEFAULT_COALESCE;
+    if (!heap_init(h, base + meta_size, committed - meta_size)) {
+        munmap(base, h->reserve_end - base);
+        return NULL;
+    }
+    return h;
+}
+
+/* Function: heap_destroy
+ * -------------------------
+ * Parameters:
+ *     h - a pointer to the heap instance to drop
+ * 
+ * Returns: NA
+ *
+ * This function drops a whole heap instance in O(1) without
+ * walking its blocks. Every pointer it handed out dies with it
+ * and its memory can be reused as soon as this returns. Huge
+ * mappings are unmapped, and a growable heap unmaps everything it
+ * reserved, its own bookkeeping included.
+ */
+void heap_destroy(heap_t *h) {
+    if (!h || h == &default_heap) return;
+    huge_release_all(h);
+#ifdef THREAD_SAFE
+    pthread_mutex_destroy(&h->lock);
+#endif
+    char *reserve_start = h->reserve_start;
+    size_t reserve_size = h->reserve_end - h->reserve_start;
+    memset(h, 0, sizeof(heap_t));
+    if (reserve_start != NULL) munmap(reserve_start, reserve_size);
+}
+
+/* Function: heap_default
+ * -------------------------
+ * Parameters: NA
+ * 
+ * Returns: a heap_t * to the instance behind the my* functions
+ *
+ * This function lets the default heap be tuned like any other.
+ */
+heap_t *heap_default(void) {
+    return &default_heap;
+}
+
+/* Function: heap_set_mmap_threshold
+ * -------------------------
+ * Parameters:
+ *     h - a pointer to the heap instance
+ *     threshold - the size_t request size from which on requests
+ *                 get their own mapping, or 0 to map none
+ * 
+ * Returns: NA
+ *
+ * This function sets where huge requests leave the segment. Fixed
+ * heaps start at 0 so every block stays inside the memory they were
+ * given, and growable heaps start at MMAP_THRESHOLD. Blocks already
+ * handed out keep where they live.
+ */
+void heap_set_mmap_threshold(heap_t *h, size_t threshold) {
+    LOCK_HEAP(h);
+    h->mmap_threshold = threshold;
+    UNLOCK_HEAP(h);
+}
+
+/* Function: heap_set_policy
+ * -------------------------
+ * Parameters:
+ *     h - a pointer to the heap instance
+ *     policy - the heap_policy_t placement policy to switch to
+ * 
+ * Returns: NA
+ *
+ * This function switches how free blocks are picked. The free
+ * structures are rebuilt from a walk of the segment, since the two
+ * policies keep large free blocks in different places. Regions have
+ * no free blocks and ignore it.
+ */
+void heap_set_policy(heap_t *h, heap_policy_t policy) {
+    LOCK_HEAP(h);
+    if (!h->is_region && h->policy != policy) {
+        h->policy = policy;
+        memset(h->free_bins, 0, sizeof(h->free_bins));
+        memset(h->bin_map, 0, sizeof(h->bin_map));
+        h->free_tree = NULL;
+        h->blocks_in_free = 0;
+        h->bytes_in_free = 0;
+        for (hdr *block = h->segment_start; block < h->segment_end; block = skip_to_next_header(block)) {
+            if (is_avail((node *)block)) add_node(h, (node *)block);
+        }
+    }
+    UNLOCK_HEAP(h);
+}
+
+/* Function: heap_set_coalesce
+ * -------------------------
+ * Parameters:
+ *     h - a pointer to the heap instance
+ *     mode - the heap_coalesce_t coalescing mode to switch to
+ * 
+ * Returns: NA
+ *
+ * This function switches when freed blocks are merged. Going back
+ * to immediate coalescing consolidates the quick lists first, so no
+ * block is left waiting on them. Regions never coalesce and ignore it.
+ */
+void heap_set_coalesce(heap_t *h, heap_coalesce_t mode) {
+    LOCK_HEAP(h);
+    if (!h->is_region) {
+        if (mode == HEAP_COALESCE_IMMEDIATE) quick_consolidate(h);
+        h->coalesce = mode;
+    }
+    UNLOCK_HEAP(h);
+}
+
+/* Function: heap_create_region
+ * -------------------------
+ * Parameters:
+ *     start - a void * to the memory the new region will own
+ *     size - the size_t number of bytes at start
+ * 
+ * Returns: a heap_t * to the new region, or NULL if
+ *          the memory is too small to hold one
+ *
+ * This function makes a heap instance in region mode, where
+ * every allocation is a pointer bump and frees are no-ops. The
+ * memory can come from anywhere, including a block of the
+ * default heap, for request-scoped work.
+ */
+heap_t *heap_create_region(void *start, size_t size) {
+    heap_t *h = heap_create(start, size);
+    if (h == NULL) return NULL;
+
+    h->is_region = true;
+    h->bump = (char *)h->segment_start;
+    return h;
+}
+
+/* Function: heap_mark
+ * -------------------------
+ * Parameters:
+ *     h - a pointer to the heap instance
+ * 
+ * Returns: a heap_mark_t watermark to pass to heap_reset later
+ *
+ * This function saves how far a region has been bumped. Every
+ * other heap only has the empty mark, 0.
+ */
+heap_mark_t heap_mark(heap_t *h) {
+    LOCK_HEAP(h);
+    heap_mark_t mark = h->is_region ? (heap_mark_t)(h->bump - (char *)h->segment_start) : 0;
+    UNLOCK_HEAP(h);
+    return mark;
+}
+
+/* Function: heap_reset
+ * -------------------------
+ * Parameters:
+ *     h - a pointer to the heap instance
+ *     mark - a heap_mark_t from heap_mark
+ * 
+ * Returns: NA
+ *
+ * This function frees everything allocated since the mark was
+ * taken in O(1). A region just moves its bump pointer back, and
+ * any other heap is wiped back to one free block, whatever the mark.
+ */
+void heap_reset(heap_t *h, heap_mark_t mark) {
+    LOCK_HEAP(h);
+    if (!h->is_region) {
+        heap_init(h, h->heap_start, h->heap_size);
+        heap_trim(h);
+    } else if (mark <= (heap_mark_t)(h->bump - (char *)h->segment_start)) {
+        h->bump = (char *)h->segment_start + mark;
+        h->check_cursor = NULL; // new blocks will be cut over the old ones
+    }
+    UNLOCK_HEAP(h);
+}
+                       
+/* Function: central_malloc
+ * -------------------------
+ * Parameters: 
+ *     h - a pointer to the heap instance
+ *     requested_size - a size_t representation
+ *               of the payload size to be allocated
+ * 
+ * Returns: the void * representation of the payload address
+ *
+ * This function will search the segregated free lists for a block
+ * to fit the allocation request. It will split the 
+ * remainder of the space into a new header if it can satisfy
+ * the minimum payload requirement of 12. Small requests go to the
+ * slabs first, and in the deferred mode to their quick list next.
+ * When nothing but the tail block fits the quick lists are
+ * consolidated, and after that a growable heap grows. The caller
+ * holds the heap lock.
+ */
+void *central_malloc(heap_t *h, size_t requested_size) {
+
+    if (requested_size <= 0 || requested_size > heap_capacity(h) - HDR_SIZE || requested_size > MAX_REQUEST_SIZE) return NULL;
+    if (requested_size <= SLAB_MAX_OBJ) {
+        void *object = slab_malloc(h, requested_size);
+        if (object != NULL) return object; // else fall back to a block
+    }
+    if (first_bin_from(h, 0) == NUM_BINS && h->free_tree == NULL && h->quick_blocks == 0
+        && h->reserve_end == NULL) return NULL; // no heap left 
+
+    size_t needed_sz = align_pl(requested_size + CANARY_SIZE);
+    if (needed_sz <= 0)  return NULL;
+    if (needed_sz < MIN_PL ) {
+        needed_sz = MIN_PL; // make sure minimum payload is 12
+    }
+
+    // a quick block of the exact size is still marked allocated
+    node *looping_adr = quick_pop(h, needed_sz);
+    if (looping_adr != NULL) {
+        ARM_CANARY(h, looping_adr);
+        return to_pl(looping_adr);
+    }
+
+    // quick blocks are merged before a request carves into the tail
+    looping_adr = find_fit(h, needed_sz);
+    if (h->quick_blocks != 0 && (looping_adr == NULL
+        || (hdr *)skip_to_next_header((hdr *)looping_adr) == h->segment_end)) {
+        quick_consolidate(h);
+        looping_adr = find_fit(h, needed_sz);
+    }
+    if (looping_adr == NULL && heap_grow(h, needed_sz)) {
+        looping_adr = find_fit(h, needed_sz);
+    }
+    if (looping_adr == NULL) return NULL;
+
+    size_t pl = grab_pl(looping_adr);
+    delete_node(h, looping_adr); // must leave its bin before its size changes
+
+    //payload will split
+    if (pl >= needed_sz + HDR_SIZE + MIN_PL) {
+        size_t rem = pl - needed_sz - HDR_SIZE;
+        set_pl(looping_adr, needed_sz);
+        make_taken(looping_adr);
+
+        node *new_hdr = (node *)((char *)looping_adr + HDR_SIZE + needed_sz);
+        make_hdr(new_hdr, rem);
+        write_footer(new_hdr);
+        add_node(h, new_hdr);
+        ARM_CANARY(h, looping_adr);
+        return to_pl(looping_adr);
+    }
+
+    //payload will not split
+    make_taken(looping_adr);
+    mark_right_neighbor(h, looping_adr, false);
+    ARM_CANARY(h, looping_adr);
+    return to_pl(looping_adr);
+}
+
+/* Function: central_aligned_malloc
+ * -------------------------
+ * Parameters:
+ *     h - a pointer to the heap instance
+ *     align - the size_t power of two, above ALIGNMENT, the payload
+ *             must be aligned to
+ *     requested_size - the size_t payload size to be allocated
+ * 
+ * Returns: the void * representation of the payload address
+ *
+ * This function carves an aligned block with aligned_carve, so
+ * the gap in front of it goes back to the free lists. The block
+ * never comes from a slab or a quick list, whose blocks are only
+ * 8-aligned. The caller holds the heap lock.
+ */
+void *central_aligned_malloc(heap_t *h, size_t align, size_t requested_size) {
+    if (requested_size > heap_capacity(h) - HDR_SIZE) return NULL;
+    size_t needed_sz = align_pl(requested_size + CANARY_SIZE);
+    if (needed_sz < MIN_PL) needed_sz = MIN_PL;
+
+    node *block = aligned_carve(h, align, needed_sz);
+    if (block == NULL) return NULL;
+    ARM_CANARY(h, block);
+    return to_pl(block);
+}
+
+/* Function: central_free
+ * -------------------------
+ * Parameters:
+ *     h - a pointer to the heap instance
+ *     ptr - a void * to the payload
+ *           to be freed
+ * 
+ * Returns: NA
+ *
+ * This function will make a header's payload
+ * "free" by turning off the LSB of the size_t
+ * hdr type and adds it to the free list.
+ * It also updates the global representing how
+ *  much heap has been used. In the deferred mode a small block
+ * goes onto its quick list instead, and the quick lists are
+ * consolidated once they hold more than QUICK_LIMIT bytes. The
+ * caller holds the heap lock.
+ */
+void central_free(heap_t *h, void *ptr) {
+    if (is_slab_ptr(h, ptr)) {
+        slab_free(h, ptr);
+        return;
+    }
+    node *temp_ptr = back_to_hdr(ptr);
+    
+    if ((hdr *)ptr > h->segment_end || (hdr *)ptr < h->segment_start
+        || !ptr || is_avail(temp_ptr) ) {
+        HARDEN_FAIL("double free", ptr);
+        return;
+
+    } else if (h->coalesce == HEAP_COALESCE_DEFERRED && grab_pl(temp_ptr) <= QUICK_MAX_PL) {
+        quick_push(h, temp_ptr);
+        if (h->quick_bytes > QUICK_LIMIT) quick_consolidate(h);
+
+    } else {
+        make_free(temp_ptr);
+        add_node(h, coalesce(h, temp_ptr));
+        heap_trim(h);
+    }
+}
+
+/* Function: central_malloc_batch
+ * -------------------------
+ * Parameters:
+ *     h - a pointer to the heap instance
+ *     requested_size - the size_t payload size of every block
+ *     count - the size_t number of blocks wanted
+ *     out - room for count payload pointers
+ * 
+ * Returns: the size_t number of blocks put in out, fewer than
+ *          count only when the heap ran out
+ *
+ * This function serves many requests of one size in one pass.
+ * Slab sizes come from the slabs, and in the deferred mode blocks
+ * of the exact size come off their quick list first. The rest are
+ * carved back to back out of as few free blocks as it can: it asks
+ * for one free block that holds them all, else takes any that holds
+ * one, and cuts it into as many blocks as fit. What is left becomes
+ * a free block, or goes to the last block if it is too small to be
+ * one. The caller holds the heap lock.
+ */
+size_t central_malloc_batch(heap_t *h, size_t requested_size, size_t count, void **out) {
+    if (requested_size <= 0 || requested_size > heap_capacity(h) - HDR_SIZE || requested_size > MAX_REQUEST_SIZE) return 0;
+    size_t done = 0;
+    if (requested_size <= SLAB_MAX_OBJ) {
+        while (done < count && (out[done] = slab_malloc(h, requested_size)) != NULL) done++;
+        if (done == count) return done; // else fall back to blocks
+    }
+
+    size_t needed_sz = align_pl(requested_size + CANARY_SIZE);
+    if (needed_sz < MIN_PL) needed_sz = MIN_PL;
+    size_t stride = needed_sz + HDR_SIZE;
+    for (node *block; done < count && (block = quick_pop(h, needed_sz)) != NULL; done++) {
+        ARM_CANARY(h, block);
+        out[done] = to_pl(block);
+    }
+
+    while (done < count) {
+        size_t want = count - done;
+        if (want > MAX_REQUEST_SIZE / stride) want = MAX_REQUEST_SIZE / stride;
+        if (want == 0) want = 1;
+        node *span = find_fit(h, want * stride - HDR_SIZE);
+        if (span == NULL) span = find_fit(h, needed_sz);
+        if (span == NULL && h->quick_blocks != 0) {
+            quick_consolidate(h);
+            span = find_fit(h, needed_sz);
+        }
+        if (span == NULL && (heap_grow(h, want * stride - HDR_SIZE) || heap_grow(h, needed_sz))) {
+            span = find_fit(h, needed_sz);
+        }
+        if (span == NULL) break;
+
+        size_t pl = grab_pl(span);
+        delete_node(h, span); // must leave its bin before its size changes
+        size_t fits = (pl + HDR_SIZE) / stride;
+        if (fits > count - done) fits = count - done;
+        size_t rem = pl + HDR_SIZE - fits * stride;
+
+        // blocks back to back, the last one taking a remainder too small to split
+        node *block = span;
+        for (size_t i = 0; i < fits; i++) {
+            size_t block_pl = (i == fits - 1 && rem < MIN_BLOCK_SIZE) ? needed_sz + rem : needed_sz;
+            if (i == 0) {
+                set_pl(block, block_pl);
+            } else {
+                make_hdr(block, block_pl);
+            }
+            make_taken(block);
+            ARM_CANARY(h, block);
+            out[done++] = to_pl(block);
+            block = skip_to_next_header((hdr *)block);
+        }
+        if (rem >= MIN_BLOCK_SIZE) {
+            make_hdr(block, rem - HDR_SIZE);
+            write_footer(block);
+            add_node(h, block);
+        } else {
+            mark_right_neighbor(h, back_to_hdr(out[done - 1]), false);
+        }
+    }
+    return done;
+}
+
+/* Function: grow_right
+ * -------------------------
+ * Parameters:
+ *     h - a pointer to the heap instance
+ *     start - a node * to the allocated block to grow
+ *     new_s - the size_t rounded payload size it needs
+ * 
+ * Returns: a void * to the same payload, or NULL if the block and
+ *          a free right neighbour together are too small
+ *
+ * This function grows a block into the free block to its right,
+ * splitting off what is left over if it can hold a block.
+ */
+void *grow_right(heap_t *h, node *start, size_t new_s) {
+    size_t prev_size = grab_pl(start);
+    node *to_check = skip_to_next_header((hdr *)start);
+    if ((hdr *)to_check >= h->segment_end || !is_avail(to_check)) return NULL;
+
+    size_t right_size = grab_pl(to_check);
+    if (right_size + prev_size + HDR_SIZE < new_s) return NULL;
+    delete_node(h, to_check);
+
+    if (right_size + prev_size + HDR_SIZE - new_s >= MIN_BLOCK_SIZE) {
+        node *new_hdr = (node *)((char *)start + HDR_SIZE + new_s);
+        return split_rem(h, start, new_hdr, new_s, (right_size + prev_size - new_s));
+    }
+    (start->b_hdr) += right_size + HDR_SIZE;
+    mark_right_neighbor(h, start, false);
+    return to_pl(start);
+}
+
+/* Function: grow_left
+ * -------------------------
+ * Parameters:
+ *     h - a pointer to the heap instance
+ *     start - a node * to the allocated block to grow
+ *     new_s - the size_t rounded payload size it needs
+ * 
+ * Returns: a void * to the payload at its new place, or NULL if
+ *          the block and its free neighbours are too small
+ *
+ * This function merges a block with its free left neighbour, and
+ * its free right neighbour if it has one, sliding the payload down
+ * to the start of the span with memmove. Whatever the payload does
+ * not need at the end is split off as a free block.
+ */
+void *grow_left(heap_t *h, node *start, size_t new_s) {
+    if (!(start->b_hdr & PREV_FREE_BIT)) return NULL;
+
+    size_t prev_size = grab_pl(start);
+    node *left = (node *)((char *)start - HDR_SIZE - *((hdr *)start - 1));
+    node *right = skip_to_next_header((hdr *)start);
+    bool right_free = (hdr *)right < h->segment_end && is_avail(right);
+    size_t total = grab_pl(left) + HDR_SIZE + prev_size;
+    if (right_free) total += HDR_SIZE + grab_pl(right);
+    if (total < new_s) return NULL;
+
+    delete_node(h, left);
+    if (right_free) delete_node(h, right);
+    cursor_absorbed(h, start, left);
+    memmove(to_pl(left), to_pl(start), prev_size);
+
+    if (total - new_s >= MIN_BLOCK_SIZE) {
+        set_pl(left, new_s);
+        make_taken(left);
+        node *new_hdr = (node *)((char *)left + HDR_SIZE + new_s);
+        make_hdr(new_hdr, total - new_s - HDR_SIZE);
+        write_footer(new_hdr);
+        mark_right_neighbor(h, new_hdr, true);
+        add_node(h, new_hdr);
+        return to_pl(left);
+    }
+    set_pl(left, total);
+    make_taken(left);
+    mark_right_neighbor(h, left, false);
+    return to_pl(left);
+}
+
+/* Function: reaches_tail
+ * -------------------------
+ * Parameters:
+ *     h - a pointer to the heap instance
+ *     start - a node * to an allocated block
+ * 
+ * Returns: boolean representation of if only free space lies
+ *          between the block and the end of the segment
+ *
+ * This function tells realloc when growing the heap would give a
+ * block room right where it is.
+ */
+bool reaches_tail(heap_t *h, node *start) {
+    node *right = skip_to_next_header((hdr *)start);
+    if ((hdr *)right < h->segment_end && is_avail(right)) {
+        right = skip_to_next_header((hdr *)right);
+    }
+    return (hdr *)right == h->segment_end;
+}
+
+/* Function: central_realloc
+ * -------------------------
+ * Parameters:
+ *     h - a pointer to the heap instance
+ *     old_ptr - a pointer to the space to reallocate 
+ *     new_size - a size_t representation
+ *                 of the payload size
+ * 
+ * Returns: a void * to the payload of the new memory
+ *
+ * This function will reallocate a previous request to
+ * a new size. In explicit, there is in_place, so we will
+ * check the right header to expand into if we need extra space,
+ * then grow a growable heap whose tail the block reaches, then take
+ * in a free left neighbour too, consolidating the quick lists and
+ * trying both sides again if that fails. As a last resort, the allocation
+ * will just move locations if in-place realloc is not possible.
+ * A size that can never fit leaves the block as it was. The caller
+ * holds the heap lock.
+ */
+void *central_realloc(heap_t *h, void *old_ptr, size_t new_size) {
+
+    if (!old_ptr) {
+        return central_malloc(h, new_size);
+   } else if (new_size <= 0) {
+        central_free(h, old_ptr);
+        return NULL; // a zero size frees the block
+    } else if (new_size > heap_capacity(h) || new_size > MAX_REQUEST_SIZE) {
+        return NULL; // can never fit, and the old block stays as it was
+    } else if ((hdr *)old_ptr > h->segment_end || (hdr *)old_ptr < h->segment_start) return NULL;
+
+    // slab objects stay put while they fit and move to a new home otherwise
+    if (is_slab_ptr(h, old_ptr)) {
+        size_t obj_size = slab_of(old_ptr)->obj_size;
+        if (new_size <= obj_size) return old_ptr;
+        void *new_request = central_malloc(h, new_size);
+        if (new_request == NULL) return NULL;
+        memcpy(new_request, old_ptr, obj_size);
+        slab_free(h, old_ptr);
+        return new_request;
+    }
+    
+    node *start = back_to_hdr((node *)old_ptr);
+    size_t prev_size = grab_pl(start);
+    size_t new_s = align_pl(new_size + CANARY_SIZE);
+    if (new_s < MIN_PL) {
+        new_s = MIN_PL;
+        } 
+
+    // shrinking in space
+    if (new_s <= prev_size) {
+        if (prev_size == new_s) {
+            make_taken(start);
+            return to_pl(start);
+        }
+        node *new_hdr = (node *)((char *)start + HDR_SIZE + new_s);
+        size_t rem = prev_size - new_s - HDR_SIZE; 
+        if (rem >= MIN_PL) { // if there's enough room to split
+            
+            return split_block(h, start, new_hdr, rem, new_s);
+        }
+        
+        set_pl(start, prev_size);
+        make_taken(start);
+        return to_pl(start);
+        
+    } else { //growing in place into the neighboring blocks if applicable
+        void *grown = grow_right(h, start, new_s);
+        if (grown == NULL && reaches_tail(h, start) && heap_grow(h, new_s - prev_size)) {
+            grown = grow_right(h, start, new_s);
+        }
+        if (grown == NULL) {
+            grown = grow_left(h, start, new_s);
+        }
+        if (grown == NULL && h->quick_blocks != 0) { // a quick neighbour may be in the way
+            quick_consolidate(h);
+            grown = grow_right(h, start, new_s);
+            if (grown == NULL) grown = grow_left(h, start, new_s);
+        }
+        if (grown != NULL) return grown;
+        return old_realloc(h, start, old_ptr, new_size); //last resort is old reallocation
+    }
+}
+
+/* Function: region_malloc
+ * -------------------------
+ * Parameters: 
+ *     h - a pointer to a region
+ *     requested_size - a size_t representation
+ *               of the payload size to be allocated
+ * 
+ * Returns: the void * representation of the payload address
+ *
+ * This function bumps a region's pointer past a header and the
+ * rounded payload. Region blocks never join a free list, so they
+ * skip the minimum payload. The caller holds the heap lock.
+ */
+void *region_malloc(heap_t *h, size_t requested_size) {
+    if (requested_size <= 0 || requested_size > MAX_REQUEST_SIZE) return NULL;
+
+    size_t needed_sz = align_pl(requested_size);
+    if ((size_t)((char *)h->segment_end - h->bump) < needed_sz + HDR_SIZE) return NULL;
+
+    node *block = (node *)h->bump;
+    make_hdr(block, needed_sz);
+    make_taken(block);
+    h->bump += HDR_SIZE + needed_sz;
+    return to_pl(block);
+}
+
+/* Function: region_aligned_malloc
+ * -------------------------
+ * Parameters: 
+ *     h - a pointer to a region
+ *     align - the size_t power of two, above ALIGNMENT, the payload
+ *             must be aligned to
+ *     requested_size - the size_t payload size to be allocated
+ * 
+ * Returns: the void * representation of the payload address
+ *
+ * This function bumps the gap up to the next aligned payload as a
+ * block of its own, which heap_reset rolls back like any other,
+ * and then the block itself. The caller holds the heap lock.
+ */
+void *region_aligned_malloc(heap_t *h, size_t align, size_t requested_size) {
+    char *mark = h->bump;
+    size_t payload = (size_t)mark + HDR_SIZE;
+    size_t gap = roundup(payload, align) - payload;
+    if (gap != 0 && region_malloc(h, gap - HDR_SIZE) == NULL) return NULL;
+
+    void *aligned = region_malloc(h, requested_size);
+    if (aligned == NULL) h->bump = mark; // no gap block left behind
+    return aligned;
+}
+
+/* Function: region_realloc
+ * -------------------------
+ * Parameters:
+ *     h - a pointer to a region
+ *     old_ptr - a pointer to the space to reallocate 
+ *     new_size - a size_t representation
+ *                 of the payload size
+ * 
+ * Returns: a void * to the payload of the new memory
+ *
+ * This function resizes the most recent block of a region in
+ * place by moving the bump pointer. Any other block keeps its
+ * spot when shrinking and is bumped and copied when growing.
+ * The caller holds the heap lock.
+ */
+void *region_realloc(heap_t *h, void *old_ptr, size_t new_size) {
+    if (!old_ptr) return region_malloc(h, new_size);
+    if (new_size <= 0 || new_size > MAX_REQUEST_SIZE
+        || (hdr *)old_ptr <= h->segment_start || (char *)old_ptr >= h->bump) return NULL;
+
+    node *block = back_to_hdr(old_ptr);
+    size_t prev_size = grab_pl(block);
+    size_t new_s = align_pl(new_size);
+
+    // the last block can move the bump pointer either way
+    if ((char *)old_ptr + prev_size == h->bump) {
+        if ((size_t)((char *)h->segment_end - (char *)old_ptr) < new_s) return NULL;
+        make_hdr(block, new_s);
+        make_taken(block);
+        h->bump = (char *)old_ptr + new_s;
+        return old_ptr;
+    }
+    if (new_s <= prev_size) return old_ptr;
+
+    void *new_request = region_malloc(h, new_size);
+    if (new_request != NULL) {
+        memcpy(new_request, old_ptr, prev_size);
+    }
+    return new_request;
+}
+
+/* Function: huge_of
+ * -------------------------
+ * Parameters:
+ *     ptr - a void * to a huge payload
+ * 
+ * Returns: a huge * to the header of its mapping
+ *
+ * This function steps back from a huge payload to its header.
+ */
+huge *huge_of(void *ptr) {
+    return (huge *)((char *)ptr - HUGE_HDR_SIZE);
+}
+
+/* Function: is_huge_ptr
+ * -------------------------
+ * Parameters:
+ *     h - a pointer to the heap instance
+ *     ptr - a void * to a payload
+ * 
+ * Returns: boolean representation of if ptr is a huge payload of h
+ *
+ * This function only trusts pointers outside the segment that sit
+ * where a mapping puts its payload and whose header names h.
+ */
+bool is_huge_ptr(heap_t *h, void *ptr) {
+    if (!ptr || ((size_t)ptr & (PAGE_SIZE - 1)) != HUGE_HDR_SIZE) return false;
+    if ((hdr *)ptr >= h->segment_start
+        && (hdr *)ptr < __atomic_load_n(&h->segment_end, __ATOMIC_RELAXED)) return false;
+    return huge_of(ptr)->owner == h;
+}
+
+/* Function: huge_link
+ * -------------------------
+ * Parameters:
+ *     h - a pointer to the heap instance
+ *     hg - a huge * to a mapping that was just made or moved
+ * 
+ * Returns: NA
+ *
+ * This function puts a mapping at the front of the heap's list of
+ * huge mappings. The caller holds the heap lock.
+ */
+void huge_link(heap_t *h, huge *hg) {
+    hg->prev = NULL;
+    hg->next = h->huge_list;
+    if (hg->next != NULL) hg->next->prev = hg;
+    h->huge_list = hg;
+    h->huge_bytes += hg->map_size;
+}
+
+/* Function: huge_unlink
+ * -------------------------
+ * Parameters:
+ *     h - a pointer to the heap instance
+ *     hg - a huge * on the heap's list of huge mappings
+ * 
+ * Returns: NA
+ *
+ * This function takes a mapping off the heap's list of huge
+ * mappings. The caller holds the heap lock.
+ */
+void huge_unlink(heap_t *h, huge *hg) {
+    if (hg->prev != NULL) {
+        hg->prev->next = hg->next;
+    } else {
+        h->huge_list = hg->next;
+    }
+    if (hg->next != NULL) hg->next->prev = hg->prev;
+    h->huge_bytes -= hg->map_size;
+}
+
+/* Function: huge_release_all
+ * -------------------------
+ * Parameters:
+ *     h - a pointer to the heap instance
+ * 
+ * Returns: NA
+ *
+ * This function unmaps every huge mapping of a heap that is being
+ * wiped or dropped. The caller holds the heap lock.
+ */
+void huge_release_all(heap_t *h) {
+    while (h->huge_list != NULL) {
+        huge *hg = h->huge_list;
+        h->huge_list = hg->next;
+        munmap(hg, hg->map_size);
+    }
+    h->huge_bytes = 0;
+}
+
+/* Function: huge_malloc
+ * -------------------------
+ * Parameters:
+ *     h - a pointer to the heap instance
+ *     requested_size - a size_t of at least the mmap threshold
+ * 
+ * Returns: the void * representation of the payload address
+ *
+ * This function gives a huge request a mapping of its own, with the
+ * whole tail of its last page usable. The mmap runs outside the lock.
+ */
+void *huge_malloc(heap_t *h, size_t requested_size) {
+    if (requested_size > MAX_REQUEST_SIZE) return NULL;
+
+    size_t map_size = roundup(HUGE_HDR_SIZE + align_pl(requested_size), PAGE_SIZE);
+    huge *hg = mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (hg == MAP_FAILED) return NULL;
+    hg->owner = h;
+    hg->map_size = map_size;
+    make_hdr((node *)&hg->b_hdr, map_size - HUGE_HDR_SIZE);
+    make_taken((node *)&hg->b_hdr);
+
+    LOCK_HEAP(h);
+    huge_link(h, hg);
+    note_peak(h);
+    UNLOCK_HEAP(h);
+    return (char *)hg + HUGE_HDR_SIZE;
+}
+
+/* Function: huge_free
+ * -------------------------
+ * Parameters:
+ *     h - a pointer to the heap instance
+ *     ptr - a void * to a huge payload
+ * 
+ * Returns: NA
+ *
+ * This function gives a huge mapping straight back to the OS.
+ */
+void huge_free(heap_t *h, void *ptr) {
+    huge *hg = huge_of(ptr);
+    LOCK_HEAP(h);
+    huge_unlink(h, hg);
+    UNLOCK_HEAP(h);
+    munmap(hg, hg->map_size);
+}
+
+/* Function: huge_realloc
+ * -------------------------
+ * Parameters:
+ *     h - a pointer to the heap instance
+ *     ptr - a void * to a huge payload
+ *     new_size - a size_t representation
+ *                 of the payload size
+ * 
+ * Returns: a void * to the payload of the new memory
+ *
+ * This function resizes a huge mapping with mremap, which moves
+ * page table entries instead of copying bytes. A huge block stays
+ * huge even if it shrinks below the threshold.
+ */
+void *huge_realloc(heap_t *h, void *ptr, size_t new_size) {
+    if (new_size <= 0) {
+        huge_free(h, ptr);
+        return NULL; // malformed requests
+    }
+    if (new_size > MAX_REQUEST_SIZE) return NULL;
+
+    huge *hg = huge_of(ptr);
+    size_t map_size = roundup(HUGE_HDR_SIZE + align_pl(new_size), PAGE_SIZE);
+    if (map_size == hg->map_size) return ptr;
+
+    LOCK_HEAP(h);
+    huge_unlink(h, hg);
+    huge *moved = mremap(hg, hg->map_size, map_size, MREMAP_MAYMOVE);
+    if (moved == MAP_FAILED) {
+        huge_link(h, hg);
+        UNLOCK_HEAP(h);
+        return NULL;
+    }
+    moved->map_size = map_size;
+    make_hdr((node *)&moved->b_hdr, map_size - HUGE_HDR_SIZE);
+    make_taken((node *)&moved->b_hdr);
+    huge_link(h, moved);
+    note_peak(h);
+    UNLOCK_HEAP(h);
+    return (char *)moved + HUGE_HDR_SIZE;
+}
+
+/* Function: usable_size
+ * -------------------------
+ * Parameters:
+ *     h - a pointer to the heap instance
+ *     ptr - a void * to an allocated payload
+ * 
+ * Returns: the size_t number of bytes the payload can hold
+ *
+ * This function reads a slab object's size from its slab and any
+ * other payload's from the header in front of it, less the canary
+ * of a block in the segment.
+ */
+size_t usable_size(heap_t *h, void *ptr) {
+    if (is_slab_ptr(h, ptr)) return slab_of(ptr)->obj_size;
+    // atomic since other threads may flip the prev-free bit
+    size_t pl = (__atomic_load_n(&back_to_hdr(ptr)->b_hdr, __ATOMIC_RELAXED) & ~0x7) - HDR_SIZE;
+    if (CANARY_SIZE != 0 && !h->is_region && (hdr *)ptr >= h->segment_start
+        && (hdr *)ptr < __atomic_load_n(&h->segment_end, __ATOMIC_RELAXED)) {
+        pl -= CANARY_SIZE; // the canary is not the caller's
+    }
+    return pl;
+}
+
+/* Function: is_allocated
+ * -------------------------
+ * Parameters:
+ *     h - a pointer to the heap instance
+ *     ptr - a void * that may be a payload of h's segment
+ * 
+ * Returns: boolean representation of if ptr is an allocated block
+ *          or slab object of the segment
+ *
+ * This function screens a pointer before it is counted or freed
+ * without the lock, with the checks central_free makes. The segment
+ * end and header are read atomically for the THREAD_SAFE build.
+ */
+bool is_allocated(heap_t *h, void *ptr) {
+    if (!ptr || (hdr *)ptr < h->segment_start
+        || (hdr *)ptr >= __atomic_load_n(&h->segment_end, __ATOMIC_RELAXED)) return false;
+    if (is_slab_ptr(h, ptr)) return true;
+    return (__atomic_load_n(&back_to_hdr(ptr)->b_hdr, __ATOMIC_RELAXED) & 0x1) != 0;
+}
+
+#ifdef HARDENED
+/* Function: harden_alloc
+ * -------------------------
+ * Parameters:
+ *     h - a pointer to the heap instance
+ *     ptr - a void * just handed out from a thread cache or by realloc
+ *     fresh - whether ptr comes from a thread cache rather than realloc
+ * 
+ * Returns: NA
+ *
+ * This function arms the canary of a block whose size realloc may
+ * have changed in place or that a thread cache kept with its
+ * pending-free mark. A slab object fresh from a thread cache
+ * still holds that mark, which is cleared; realloc has copied
+ * the caller's data over it. Regions and huge blocks have neither.
+ * central_malloc and slab_malloc do the same for what they carve.
+ */
+void harden_alloc(heap_t *h, void *ptr, bool fresh) {
+    if (ptr == NULL || h->is_region || (hdr *)ptr < h->segment_start
+        || (hdr *)ptr >= __atomic_load_n(&h->segment_end, __ATOMIC_RELAXED)) return;
+    if (is_slab_ptr(h, ptr)) {
+        if (fresh) ((uint64_t *)ptr)[1] = 0;
+        return;
+    }
+    arm_canary(h, back_to_hdr(ptr));
+}
+
+/* Function: harden_free
+ * -------------------------
+ * Parameters:
+ *     h - a pointer to the heap instance
+ *     ptr - a void * about to be freed or reallocated
+ *     mark - whether ptr is being freed, so it gets a pending mark
+ * 
+ * Returns: NA
+ *
+ * This function aborts unless ptr is a live payload of h: a huge
+ * block, a slab object or a block with a sound header and an
+ * intact canary. A freed block's canary is swapped for its
+ * complement and a freed slab object gets the heap's pending key
+ * in its second word, which a thread cache or the remote-free list
+ * keep while they hold it, so freeing it again is caught even
+ * before it reaches the free lists.
+ */
+void harden_free(heap_t *h, void *ptr, bool mark) {
+    hdr *segment_end = __atomic_load_n(&h->segment_end, __ATOMIC_RELAXED);
+    if ((hdr *)ptr < h->segment_start || (hdr *)ptr >= segment_end) {
+        if (!is_huge_ptr(h, ptr)) heap_corrupt("free of a pointer the heap did not hand out", ptr);
+        return;
+    }
+    if ((size_t)ptr % ALIGNMENT != 0) heap_corrupt("free of a misaligned pointer", ptr);
+    if (is_slab_ptr(h, ptr)) { // slab_free checks the object's position
+        uint64_t *words = ptr;
+        if (words[1] == h->pending_key) heap_corrupt("double free", ptr);
+        if (mark) words[1] = h->pending_key;
+        return;
+    }
+
+    node *block = back_to_hdr(ptr);
+    hdr word = __atomic_load_n(&block->b_hdr, __ATOMIC_RELAXED);
+    size_t pl = (word & ~0x7) - HDR_SIZE;
+    if (!(word & 0x1)) heap_corrupt("double free", ptr);
+    if (pl < MIN_PL || pl > (size_t)((char *)segment_end - (char *)ptr)) {
+        heap_corrupt("block header overwritten", ptr);
+    }
+    hdr *canary = (hdr *)((char *)block + pl);
+    if (*canary == (hdr)~canary_of(h, block)) heap_corrupt("double free", ptr);
+    if (*canary != canary_of(h, block)) heap_corrupt("write past the end of a block", ptr);
+    if (mark) *canary = ~canary_of(h, block);
+}
+#endif
+
+/* Function: stats_class
+ * -------------------------
+ * Parameters:
+ *     size - the size_t payload size of a block
+ * 
+ * Returns: the size_t heap_stats class of the size
+ *
+ * This function files payloads of up to 16 << c bytes under class c.
+ */
+size_t stats_class(size_t size) {
+    if (size <= 16) return 0;
+    size_t cls = 64 - __builtin_clzl(size - 1) - 4;
+    return (cls < HEAP_STATS_CLASSES) ? cls : HEAP_STATS_CLASSES - 1;
+}
+
+/* Function: count_add
+ * -------------------------
+ * Parameters:
+ *     c - a size_t * to one counter
+ *     n - the size_t amount to add
+ *     shared - whether other threads add to the counter too
+ * 
+ * Returns: NA
+ *
+ * This function bumps a counter. In the THREAD_SAFE build a shared
+ * counter takes an atomic add, and a thread cache's own counter a
+ * plain add stored atomically, since heap_stats reads it from
+ * another thread.
+ */
+void count_add(size_t *c, size_t n, bool shared) {
+#ifdef THREAD_SAFE
+    if (shared) {
+        __atomic_fetch_add(c, n, __ATOMIC_RELAXED);
+    } else {
+        __atomic_store_n(c, *c + n, __ATOMIC_RELAXED);
+    }
+#else
+    (void)shared;
+    *c += n;
+#endif
+}
+
+/* Function: count_alloc
+ * -------------------------
+ * Parameters:
+ *     oc - a pointer to the counters to update
+ *     size - the size_t payload size handed out
+ *     shared - whether other threads update oc too
+ * 
+ * Returns: NA
+ *
+ * This function counts one allocation for heap_stats.
+ */
+void count_alloc(op_counts *oc, size_t size, bool shared) {
+    count_add(&oc->allocs[stats_class(size)], 1, shared);
+    count_add(&oc->alloc_bytes, size, shared);
+}
+
+/* Function: count_free
+ * -------------------------
+ * Parameters:
+ *     oc - a pointer to the counters to update
+ *     size - the size_t payload size given back
+ *     shared - whether other threads update oc too
+ * 
+ * Returns: NA
+ *
+ * This function counts one free for heap_stats.
+ */
+void count_free(op_counts *oc, size_t size, bool shared) {
+    count_add(&oc->frees[stats_class(size)], 1, shared);
+    count_add(&oc->free_bytes, size, shared);
+}
+
+/* Function: count_realloc
+ * -------------------------
+ * Parameters:
+ *     h - a pointer to the heap instance
+ *     old_ptr - the void * that was reallocated
+ *     old_size - the size_t payload size it had, 0 if it was not
+ *                a block of h
+ *     payload - the void * realloc returned
+ *     freed - whether a NULL payload means old_ptr was freed
+ * 
+ * Returns: NA
+ *
+ * This function counts a realloc for heap_stats as a move or a
+ * resize in place, or as a free if it freed the block.
+ */
+void count_realloc(heap_t *h, void *old_ptr, size_t old_size, void *payload, bool freed) {
+    if (old_size == 0) return;
+    if (payload == NULL) {
+        if (freed) count_free(&h->counts, old_size, true);
+        return;
+    }
+    count_add(&h->counts.free_bytes, old_size, true);
+    count_add(&h->counts.alloc_bytes, usable_size(h, payload), true);
+    count_add(payload == old_ptr ? &h->counts.reallocs_in_place : &h->counts.reallocs_moved, 1, true);
+}
+
+/* Function: note_peak
+ * -------------------------
+ * Parameters:
+ *     h - a pointer to the heap instance
+ * 
+ * Returns: NA
+ *
+ * This function raises the heap's peak to what it has taken now:
+ * the segment less its free blocks, or a region's bumped bytes,
+ * plus the huge mappings. The caller holds the heap lock.
+ */
+void note_peak(heap_t *h) {
+    size_t in_use = h->huge_bytes;
+    if (h->is_region) {
+        in_use += h->bump - (char *)h->segment_start;
+    } else {
+        in_use += h->segment_size - h->bytes_in_free - h->blocks_in_free * HDR_SIZE;
+    }
+    if (in_use > h->peak_in_use) h->peak_in_use = in_use;
+}
+
+/* Function: largest_free
+ * -------------------------
+ * Parameters:
+ *     h - a pointer to the heap instance
+ * 
+ * Returns: the size_t payload of the largest free block
+ *
+ * This function takes the rightmost node of the best-fit tree and
+ * walks the highest non-empty bin, which holds the largest blocks
+ * outside the tree. The caller holds the heap lock.
+ */
+size_t largest_free(heap_t *h) {
+    size_t largest = 0;
+    node *n = h->free_tree;
+    while (n != NULL && link_node(h, n->next) != NULL) n = link_node(h, n->next);
+    if (n != NULL) largest = grab_pl(n);
+    size_t bin = NUM_BINS;
+    while (bin > 0 && !bin_marked(h, bin - 1)) bin--;
+    if (bin > 0) {
+        for (n = h->free_bins[bin - 1]; n != NULL; n = link_node(h, n->next)) {
+            if (grab_pl(n) > largest) largest = grab_pl(n);
+        }
+    }
+    return largest;
+}
+
+#ifdef THREAD_SAFE
+/* Function: chain_next
+ * -------------------------
+ * Parameters:
+ *     h - a pointer to the heap instance
+ *     ptr - a void * to a payload on a thread cache or remote-free chain
+ * 
+ * Returns: a void * to the payload after it, or NULL
+ *
+ * This function reads the link a chain keeps in a payload's first
+ * word, which the HARDENED build stores xor'd with the chain key.
+ */
+void *chain_next(heap_t *h, void *ptr) {
+    return (void *)(*(uintptr_t *)ptr ^ CHAIN_KEY(h));
+}
+
+/* Function: chain_set
+ * -------------------------
+ * Parameters:
+ *     h - a pointer to the heap instance
+ *     ptr - a void * to a payload on a chain
+ *     next - a void * to the payload after it, or NULL
+ * 
+ * Returns: NA
+ *
+ * This function is the inverse of chain_next.
+ */
+void chain_set(heap_t *h, void *ptr, void *next) {
+    *(uintptr_t *)ptr = (uintptr_t)next ^ CHAIN_KEY(h);
+}
+
+/* Function: remote_push
+ * -------------------------
+ * Parameters:
+ *     h - a pointer to the heap instance
+ *     first - a void * to the first payload of a chain
+ *     last - a void * to the last payload of the chain
+ * 
+ * Returns: NA
+ *
+ * This function pushes a chain of allocated payloads, linked
+ * through their first word, onto the heap's remote-free list with
+ * one compare-and-swap and no lock. Any number of threads may push
+ * at once, and only a lock holder ever takes the list, whole.
+ */
+void remote_push(heap_t *h, void *first, void *last) {
+    void *head = __atomic_load_n(&h->remote_frees, __ATOMIC_RELAXED);
+    do {
+        chain_set(h, last, head);
+    } while (!__atomic_compare_exchange_n(&h->remote_frees, &head, first, true,
+                                          __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
+
+/* Function: remote_drain
+ * -------------------------
+ * Parameters:
+ *     h - a pointer to the heap instance
+ * 
+ * Returns: NA
+ *
+ * This function takes the whole remote-free list with one atomic
+ * exchange and frees every payload on it into the central free
+ * lists. The caller holds the heap lock.
+ */
+void remote_drain(heap_t *h) {
+    if (__atomic_load_n(&h->remote_frees, __ATOMIC_RELAXED) == NULL) return;
+    void *ptr = __atomic_exchange_n(&h->remote_frees, NULL, __ATOMIC_ACQUIRE);
+    while (ptr != NULL) {
+        void *next = chain_next(h, ptr);
+        central_free(h, ptr);
+        ptr = next;
+    }
+}
+
+// a thread's cache of small allocated payloads of the default heap,
+// one stack per slab class and per block payload size
+typedef struct tcache
+{
+    void *bins[TCACHE_CLASSES];
+    size_t counts[TCACHE_CLASSES];
+    unsigned long heap_gen;
+    bool registered;
+    op_counts ops; // this thread's share of the default heap's counts
+    struct tcache *prev; // every registered cache, for heap_stats
+    struct tcache *next;
+} tcache;
+
+static __thread tcache thread_cache;
+static pthread_key_t tcache_key;
+static pthread_once_t tcache_once = PTHREAD_ONCE_INIT;
+static tcache *tcache_list;
+static pthread_mutex_t tcache_list_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Function: counts_fold
+ * -------------------------
+ * Parameters:
+ *     into - a pointer to the counters to add to
+ *     from - a pointer to the counters to add
+ * 
+ * Returns: NA
+ *
+ * This function adds one set of counters to another, reading each
+ * one atomically since its owner may be updating it.
+ */
+void counts_fold(op_counts *into, op_counts *from) {
+    size_t *dst = (size_t *)into;
+    size_t *src = (size_t *)from;
+    for (size_t i = 0; i < sizeof(op_counts) / sizeof(size_t); i++) {
+        dst[i] += __atomic_load_n(&src[i], __ATOMIC_RELAXED);
+    }
+}
+
+/* Function: tcache_class
+ * -------------------------
+ * Parameters:
+ *     h - a pointer to the default heap
+ *     ptr - a void * to an allocated payload or slab object
+ * 
+ * Returns: the size_t cache class of ptr, or TCACHE_CLASSES if it
+ *          is too large to be cached
+ *
+ * This function gives slab objects their slab's class and blocks a
+ * class for their exact payload size after the slab classes. Blocks
+ * small enough for a slab, handed out when no slab page fit, go in
+ * the largest slab class they can serve. The
+ * block header is read atomically since other threads may flip its
+ * prev-free bit.
+ */
+size_t tcache_class(heap_t *h, void *ptr) {
+    if (is_slab_ptr(h, ptr)) return slab_of(ptr)->cls;
+
+    size_t pl = (__atomic_load_n(&back_to_hdr(ptr)->b_hdr, __ATOMIC_RELAXED) & ~0x7) - HDR_SIZE;
+    if (pl <= SLAB_MAX_OBJ && pl >= slab_sizes[0]) { // a block standing in for a slab object
+        size_t cls = SLAB_CLASSES - 1;
+        while (slab_sizes[cls] > pl) cls--;
+        return cls;
+    }
+    if (pl > TCACHE_MAX_PL) return TCACHE_CLASSES;
+    return SLAB_CLASSES + (pl - MIN_PL) / ALIGNMENT;
+}
+
+/* Function: tcache_push
+ * -------------------------
+ * Parameters:
+ *     tc - a pointer to the calling thread's cache
+ *     ptr - a void * to an allocated payload or slab object
+ *     cls - the size_t cache class of ptr
+ * 
+ * Returns: NA
+ *
+ * This function pushes a payload onto the cache stack for its class,
+ * linking it through its first word. It stays allocated in the heap,
+ * so it is never coalesced or handed out again while cached.
+ */
+void tcache_push(tcache *tc, void *ptr, size_t cls) {
+    chain_set(&default_heap, ptr, tc->bins[cls]);
+    tc->bins[cls] = ptr;
+    tc->counts[cls] += 1;
+}
+
+/* Function: tcache_flush
+ * -------------------------
+ * Parameters:
+ *     tc - a pointer to a thread cache
+ *     cls - the size_t cache class to flush
+ *     amount - the size_t number of blocks to hand back
+ * 
+ * Returns: NA
+ *
+ * This function returns a batch of cached payloads to the central
+ * free lists under a single lock acquisition. If another thread
+ * holds the lock, the batch is already a chain, so it goes onto the
+ * remote-free list with a single push instead.
+ */
+void tcache_flush(tcache *tc, size_t cls, size_t amount) {
+    heap_t *h = &default_heap;
+    if (amount == 0 || tc->bins[cls] == NULL) return;
+    if (pthread_mutex_trylock(&h->lock) != 0) {
+        void *first = tc->bins[cls];
+        void *last = first;
+        size_t taken = 1;
+        for (; taken < amount && chain_next(h, last) != NULL; taken++) {
+            last = chain_next(h, last);
+        }
+        tc->bins[cls] = chain_next(h, last);
+        tc->counts[cls] -= taken;
+        remote_push(h, first, last);
+        return;
+    }
+    DRAIN_REMOTE(h);
+    while (amount > 0 && tc->bins[cls] != NULL) {
+        void *ptr = tc->bins[cls];
+        tc->bins[cls] = chain_next(h, ptr);
+        tc->counts[cls] -= 1;
+        central_free(h, ptr);
+        amount -= 1;
+    }
+    UNLOCK_HEAP(h);
+}
+
+/* Function: tcache_release
+ * -------------------------
+ * Parameters:
+ *     arg - a void * to the exiting thread's cache
+ * 
+ * Returns: NA
+ *
+ * This function is the thread-exit destructor that gives every
+ * payload still cached by a thread back to the central free lists
+ * and folds its counts into the heap's.
+ */
+void tcache_release(void *arg) {
+    tcache *tc = arg;
+    bool current = (tc->heap_gen == default_heap.heap_gen);
+    for (size_t cls = 0; current && cls < TCACHE_CLASSES; cls++) {
+        tcache_flush(tc, cls, tc->counts[cls]);
+    }
+
+    // hand the thread's counts to the heap before its cache goes away
+    pthread_mutex_lock(&tcache_list_lock);
+    if (current) {
+        size_t *dst = (size_t *)&default_heap.counts;
+        size_t *src = (size_t *)&tc->ops;
+        for (size_t i = 0; i < sizeof(op_counts) / sizeof(size_t); i++) {
+            __atomic_fetch_add(&dst[i], src[i], __ATOMIC_RELAXED);
+        }
+    }
+    if (tc->prev != NULL) tc->prev->next = tc->next;
+    if (tc->next != NULL) tc->next->prev = tc->prev;
+    if (tcache_list == tc) tcache_list = tc->next;
+    pthread_mutex_unlock(&tcache_list_lock);
+}
+
+/* Function: tcache_make_key
+ * -------------------------
+ * Parameters: NA
+ * 
+ * Returns: NA
+ *
+ * This function creates the key whose destructor flushes a
+ * thread's cache when the thread exits. It runs once per process.
+ */
+void tcache_make_key(void) {
+    pthread_key_create(&tcache_key, tcache_release);
+}
+
+/* Function: tcache_get
+ * -------------------------
+ * Parameters: NA
+ * 
+ * Returns: a pointer to the calling thread's cache
+ *
+ * This function registers the calling thread's cache for its exit
+ * destructor and for heap_stats on first use, and empties it if
+ * myinit has reset the heap since the cache was last used.
+ */
+tcache *tcache_get(void) {
+    tcache *tc = &thread_cache;
+    if (!tc->registered) {
+        pthread_once(&tcache_once, tcache_make_key);
+        pthread_setspecific(tcache_key, tc);
+        pthread_mutex_lock(&tcache_list_lock);
+        tc->next = tcache_list;
+        if (tcache_list != NULL) tcache_list->prev = tc;
+        tcache_list = tc;
+        pthread_mutex_unlock(&tcache_list_lock);
+        tc->registered = true;
+    }
+    unsigned long gen = __atomic_load_n(&default_heap.heap_gen, __ATOMIC_RELAXED);
+    if (tc->heap_gen != gen) { // the cached blocks and counts belong to an old heap
+        memset(tc->bins, 0, sizeof(tc->bins));
+        memset(tc->counts, 0, sizeof(tc->counts));
+        size_t *ops = (size_t *)&tc->ops;
+        for (size_t i = 0; i < sizeof(op_counts) / sizeof(size_t); i++) {
+            __atomic_store_n(&ops[i], 0, __ATOMIC_RELAXED);
+        }
+        __atomic_store_n(&tc->heap_gen, gen, __ATOMIC_RELAXED);
+    }
+    return tc;
+}
+
+/* Function: tcache_malloc
+ * -------------------------
+ * Parameters: 
+ *     requested_size - a size_t small enough to be cached
+ * 
+ * Returns: the void * representation of the payload address
+ *
+ * This function pops a payload of the request's slab class, or of
+ * the exact rounded block size, from the thread's cache, counting
+ * it in the thread's own counts. On a miss
+ * it takes the heap lock once, drains the remote frees and allocates
+ * a batch of TCACHE_BATCH, returning one and caching the rest.
+ */
+void *tcache_malloc(size_t requested_size) {
+    heap_t *h = &default_heap;
+    tcache *tc = tcache_get();
+    size_t needed_sz, cls;
+    if (requested_size <= SLAB_MAX_OBJ) {
+        cls = slab_class(requested_size);
+        needed_sz = slab_sizes[cls];
+    } else {
+        needed_sz = align_pl(requested_size + CANARY_SIZE);
+        cls = SLAB_CLASSES + (needed_sz - MIN_PL) / ALIGNMENT;
+        needed_sz -= CANARY_SIZE; // central_malloc adds it back
+    }
+
+    void *cached = tc->bins[cls];
+    if (cached != NULL) {
+        tc->bins[cls] = chain_next(h, cached);
+        tc->counts[cls] -= 1;
+        HARDEN_ALLOC(h, cached, true);
+        count_alloc(&tc->ops, usable_size(h, cached), false);
+        return cached;
+    }
+
+    LOCK_HEAP(h);
+    DRAIN_REMOTE(h);
+    void *payload = central_malloc(h, needed_sz);
+    for (size_t i = 1; payload != NULL && i < TCACHE_BATCH; i++) {
+        void *extra = central_malloc(h, needed_sz);
+        if (extra == NULL) break;
+        if (tcache_class(h, extra) != cls) {
+            central_free(h, extra); // a block standing in for a slab object, or carved too large
+            break;
+        }
+        tcache_push(tc, extra, cls);
+    }
+    note_peak(h);
+    UNLOCK_HEAP(h);
+    if (payload != NULL) count_alloc(&tc->ops, usable_size(h, payload), false);
+    return payload;
+}
+
+/* Function: tcache_free
+ * -------------------------
+ * Parameters:
+ *     ptr - a void * to the payload to be freed
+ * 
+ * Returns: boolean representation of if the block was cached
+ *
+ * This function keeps a freed slab object or small block in the
+ * thread's cache, flushing a batch back to the central lists once
+ * the cache for its class holds more than TCACHE_LIMIT payloads.
+ */
+bool tcache_free(void *ptr) {
+    heap_t *h = &default_heap;
+    if (!is_allocated(h, ptr)) return false;
+
+    size_t cls = tcache_class(h, ptr);
+    if (cls == TCACHE_CLASSES) return false;
+    tcache *tc = tcache_get();
+    count_free(&tc->ops, usable_size(h, ptr), false);
+    tcache_push(tc, ptr, cls);
+    if (tc->counts[cls] > TCACHE_LIMIT) {
+        tcache_flush(tc, cls, TCACHE_BATCH);
+    }
+    return true;
+}
+#endif
+
+// one sampled allocation the profiler is tracking
+typedef struct prof_sample
+{
+    void *ptr; // NULL for an empty slot
+    size_t size; // bytes requested
+    size_t depth;
+    void *stack[PROF_MAX_DEPTH];
+} prof_sample;
+
+// a thread's distance to its next sample
+typedef struct prof_thread
+{
+    size_t countdown; // bytes left to allocate before the next sample
+    uint64_t rng;
+    unsigned long epoch; // prof_epoch the countdown was drawn for
+} prof_thread;
+
+static size_t prof_period; // mean bytes between samples, 0 when off
+static unsigned long prof_epoch; // bumped by every heap_profile_start
+static size_t prof_live; // samples in the table
+static size_t prof_dropped; // samples lost to a full table
+static prof_sample *prof_table; // open addressing on the payload address
+static unsigned char prof_filter[PROF_TABLE_SIZE]; // samples per home slot
+#ifdef THREAD_SAFE
+static __thread prof_thread prof_self;
+static pthread_mutex_t prof_lock = PTHREAD_MUTEX_INITIALIZER;
+#define LOCK_PROF() pthread_mutex_lock(&prof_lock)
+#define UNLOCK_PROF() pthread_mutex_unlock(&prof_lock)
+#else
+static prof_thread prof_self;
+#define LOCK_PROF()
+#define UNLOCK_PROF()
+#endif
+
+// the only profiler work on the fast paths is one load and a branch
+#define PROFILE_MALLOC(ptr, size) do { \
+    if (__atomic_load_n(&prof_period, __ATOMIC_RELAXED) != 0 && (ptr) != NULL) profile_malloc(ptr, size); \
+} while (0)
+#define PROFILE_FREE(ptr) do { \
+    if (__atomic_load_n(&prof_live, __ATOMIC_RELAXED) != 0) profile_free(ptr); \
+} while (0)
+// a realloc that went through is a free of the old block and a new allocation
+#define PROFILE_REALLOC(old_ptr, payload, size, freed) do { \
+    if ((payload) != NULL || (freed)) { \
+        PROFILE_FREE(old_ptr); \
+        PROFILE_MALLOC(payload, size); \
+    } \
+} while (0)
+
+/* Function: prof_slot
+ * -------------------------
+ * Parameters:
+ *     ptr - a void * to a payload
+ *
+ * Returns: the size_t home slot of ptr in the sample table
+ *
+ * This function hashes a payload address with a Fibonacci multiply.
+ */
+size_t prof_slot(void *ptr) {
+    return (size_t)(((uint64_t)(size_t)ptr >> 3) * 0x9E3779B97F4A7C15ULL >> (64 - PROF_TABLE_BITS));
+}
+
+/* Function: prof_next_gap
+ * -------------------------
+ * Parameters:
+ *     pt - a pointer to the calling thread's sampler state
+ *     period - the size_t mean number of bytes between samples
+ *
+ * Returns: the size_t bytes to allocate before the next sample
+ *
+ * This function draws an exponentially distributed gap with the
+ * given mean, so every allocated byte is equally likely to be
+ * sampled. -ln(u) comes from the leading zeros of a random word
+ * and a short atanh series on its mantissa, which is accurate to
+ * about 1e-4 and needs no libm.
+ */
+size_t prof_next_gap(prof_thread *pt, size_t period) {
+    pt->rng ^= pt->rng << 13; // xorshift64
+    pt->rng ^= pt->rng >> 7;
+    pt->rng ^= pt->rng << 17;
+    uint64_t r = pt->rng | 1;
+    int lz = __builtin_clzll(r);
+    double m = (double)(r << lz) / 9223372036854775808.0; // in [1, 2)
+    double s = (m - 1) / (m + 1);
+    double ln_m = 2 * s * (1 + s * s / 3 + s * s * s * s / 5);
+    double gap = ((lz + 1) * 0.6931471805599453 - ln_m) * (double)period;
+    return (size_t)gap + 1;
+}
+
+/* Function: prof_insert
+ * -------------------------
+ * Parameters:
+ *     sample - a pointer to the sample to track
+ *
+ * Returns: NA
+ *
+ * This function files a sample under its payload address, dropping
+ * it if the table is nearly full. The caller holds the profiler lock.
+ */
+void prof_insert(prof_sample *sample) {
+    if (prof_live >= PROF_TABLE_SIZE - PROF_TABLE_SIZE / 4) {
+        prof_dropped += 1;
+        return;
+    }
+    size_t home = prof_slot(sample->ptr);
+    size_t slot = home;
+    while (prof_table[slot].ptr != NULL && prof_table[slot].ptr != sample->ptr) {
+        slot = (slot + 1) & (PROF_TABLE_SIZE - 1);
+    }
+    if (prof_table[slot].ptr == NULL) {
+        __atomic_store_n(&prof_filter[home], prof_filter[home] + 1, __ATOMIC_RELAXED);
+        __atomic_store_n(&prof_live, prof_live + 1, __ATOMIC_RELAXED);
+    }
+    prof_table[slot] = *sample;
+}
+
+/* Function: prof_remove
+ * -------------------------
+ * Parameters:
+ *     ptr - a void * to a payload that may be sampled
+ *
+ * Returns: NA
+ *
+ * This function stops tracking a payload, shifting later entries of
+ * its probe run back so no tombstones are left. The caller holds
+ * the profiler lock.
+ */
+void prof_remove(void *ptr) {
+    size_t slot = prof_slot(ptr);
+    while (prof_table[slot].ptr != ptr) {
+        if (prof_table[slot].ptr == NULL) return;
+        slot = (slot + 1) & (PROF_TABLE_SIZE - 1);
+    }
+    size_t home = prof_slot(ptr);
+    __atomic_store_n(&prof_filter[home], prof_filter[home] - 1, __ATOMIC_RELAXED);
+    __atomic_store_n(&prof_live, prof_live - 1, __ATOMIC_RELAXED);
+
+    size_t hole = slot;
+    for (size_t next = (hole + 1) & (PROF_TABLE_SIZE - 1); prof_table[next].ptr != NULL;
+         next = (next + 1) & (PROF_TABLE_SIZE - 1)) {
+        size_t want = prof_slot(prof_table[next].ptr);
+        // an entry can fill the hole if its home is not between the hole and it
+        if (((next - want) & (PROF_TABLE_SIZE - 1)) >= ((next - hole) & (PROF_TABLE_SIZE - 1))) {
+            prof_table[hole] = prof_table[next];
+            hole = next;
+        }
+    }
+    prof_table[hole].ptr = NULL;
+}
+
+/* Function: profile_malloc
+ * -------------------------
+ * Parameters:
+ *     ptr - a void * to the payload just handed out
+ *     size - the size_t bytes that were requested
+ *
+ * Returns: NA
+ *
+ * This function counts an allocation against the calling thread's
+ * distance to its next sample. Once the distance runs out, the
+ * allocation's backtrace is captured outside the profiler lock and
+ * it is tracked until it is freed.
+ */
+void profile_malloc(void *ptr, size_t size) {
+    prof_thread *pt = &prof_self;
+    size_t period = __atomic_load_n(&prof_period, __ATOMIC_RELAXED);
+    unsigned long epoch = __atomic_load_n(&prof_epoch, __ATOMIC_RELAXED);
+    if (period == 0) return;
+    if (pt->epoch != epoch) { // first allocation since heap_profile_start
+        pt->rng = (uint64_t)(size_t)pt * 0x9E3779B97F4A7C15ULL + epoch;
+        pt->countdown = prof_next_gap(pt, period);
+        pt->epoch = epoch;
+    }
+    if (size < pt->countdown) {
+        pt->countdown -= size;
+        return;
+    }
+    pt->countdown = prof_next_gap(pt, period);
+
+    prof_sample sample;
+    sample.ptr = ptr;
+    sample.size = size;
+    int depth = backtrace(sample.stack, PROF_MAX_DEPTH);
+    sample.depth = (depth > PROF_SKIP_FRAMES) ? depth - PROF_SKIP_FRAMES : 0;
+    memmove(sample.stack, sample.stack + PROF_SKIP_FRAMES, sample.depth * sizeof(void *));
+
+    LOCK_PROF();
+    if (prof_table != NULL && prof_epoch == epoch) prof_insert(&sample);
+    UNLOCK_PROF();
+}
+
+/* Function: profile_free
+ * -------------------------
+ * Parameters:
+ *     ptr - a void * to a payload about to be freed
+ *
+ * Returns: NA
+ *
+ * This function stops tracking a sampled payload. The per-slot
+ * counts let almost every unsampled free return without the lock.
+ */
+void profile_free(void *ptr) {
+    if (ptr == NULL || __atomic_load_n(&prof_table, __ATOMIC_ACQUIRE) == NULL
+        || __atomic_load_n(&prof_filter[prof_slot(ptr)], __ATOMIC_RELAXED) == 0) return;
+    LOCK_PROF();
+    prof_remove(ptr);
+    UNLOCK_PROF();
+}
+
+/* Function: heap_profile_start
+ * -------------------------
+ * Parameters:
+ *     sample_bytes - the size_t mean bytes between samples, or 0
+ *                    to stop profiling
+ *
+ * Returns: boolean representation of if profiling is on
+ *
+ * This function forgets every sample taken so far and starts
+ * sampling one allocation about every sample_bytes bytes, over all
+ * heaps. The sample table is mapped on first use, outside any heap,
+ * and only the pages samples have touched are ever resident.
+ */
+bool heap_profile_start(size_t sample_bytes) {
+    LOCK_PROF();
+    __atomic_store_n(&prof_period, 0, __ATOMIC_RELAXED);
+    if (prof_table == NULL && sample_bytes != 0) {
+        void *table = mmap(NULL, PROF_TABLE_SIZE * sizeof(prof_sample), PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (table != MAP_FAILED) __atomic_store_n(&prof_table, table, __ATOMIC_RELEASE);
+    }
+    if (prof_table != NULL && prof_live != 0) {
+        // hands the pages back, so the table reads as zeroes again
+        madvise(prof_table, PROF_TABLE_SIZE * sizeof(prof_sample), MADV_DONTNEED);
+        for (size_t slot = 0; slot < PROF_TABLE_SIZE; slot++) {
+            __atomic_store_n(&prof_filter[slot], 0, __ATOMIC_RELAXED);
+        }
+    }
+    __atomic_store_n(&prof_live, 0, __ATOMIC_RELAXED);
+    prof_dropped = 0;
+    __atomic_store_n(&prof_epoch, prof_epoch + 1, __ATOMIC_RELAXED);
+    if (prof_table != NULL) __atomic_store_n(&prof_period, sample_bytes, __ATOMIC_RELAXED);
+    UNLOCK_PROF();
+    return sample_bytes != 0 && prof_table != NULL;
+}
+
+/* Function: prof_stack_cmp
+ * -------------------------
+ * Parameters:
+ *     a - a pointer to one sample
+ *     b - a pointer to another
+ *
+ * Returns: an int ordering the two by their stacks for qsort
+ *
+ * This function sorts samples so equal stacks sit side by side.
+ */
+int prof_stack_cmp(const void *a, const void *b) {
+    const prof_sample *x = a;
+    const prof_sample *y = b;
+    if (x->depth != y->depth) return (x->depth > y->depth) - (x->depth < y->depth);
+    return memcmp(x->stack, y->stack, x->depth * sizeof(void *));
+}
+
+/* Function: heap_profile_dump
+ * -------------------------
+ * Parameters:
+ *     path - the file name to write the profile to
+ *
+ * Returns: boolean representation of if the profile was written
+ *
+ * This function writes the live sampled bytes grouped by stack in
+ * the text heap profile format pprof reads (heap_v2, one line of
+ * objects, bytes and return addresses per stack, then the process
+ * mappings for symbolizing). The samples are copied out under the
+ * lock, so allocation carries on while the file is written.
+ */
+bool heap_profile_dump(const char *path) {
+    LOCK_PROF();
+    size_t count = prof_live;
+    size_t period = prof_period;
+    size_t bytes = count * sizeof(prof_sample);
+    prof_sample *copy = NULL;
+    if (count > 0) {
+        copy = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (copy == MAP_FAILED) {
+            UNLOCK_PROF();
+            return false;
+        }
+        size_t taken = 0;
+        for (size_t slot = 0; slot < PROF_TABLE_SIZE && taken < count; slot++) {
+            if (prof_table[slot].ptr != NULL) copy[taken++] = prof_table[slot];
+        }
+    }
+    size_t dropped = prof_dropped;
+    UNLOCK_PROF();
+
+    FILE *fp = fopen(path, "w");
+    if (fp == NULL) {
+        if (copy != NULL) munmap(copy, bytes);
+        return false;
+    }
+    size_t live_bytes = 0;
+    for (size_t i = 0; i < count; i++) live_bytes += copy[i].size;
+    fprintf(fp, "heap profile: %zu: %zu [%zu: %zu] @ heap_v2/%zu\n",
+            count, live_bytes, count, live_bytes, period);
+    if (count > 0) qsort(copy, count, sizeof(prof_sample), prof_stack_cmp);
+    for (size_t i = 0; i < count;) {
+        size_t objs = 0, stack_bytes = 0, j = i;
+        for (; j < count && prof_stack_cmp(&copy[i], &copy[j]) == 0; j++) {
+            objs += 1;
+            stack_bytes += copy[j].size;
+        }
+        fprintf(fp, "%zu: %zu [%zu: %zu] @", objs, stack_bytes, objs, stack_bytes);
+        for (size_t frame = 0; frame < copy[i].depth; frame++) fprintf(fp, " %p", copy[i].stack[frame]);
+        fprintf(fp, "\n");
+        i = j;
+    }
+    if (dropped != 0) fprintf(fp, "# %zu samples dropped, the sample table was full\n", dropped);
+
+    fprintf(fp, "\nMAPPED_LIBRARIES:\n");
+    FILE *maps = fopen("/proc/self/maps", "r");
+    if (maps != NULL) {
+        char line[512];
+        while (fgets(line, sizeof(line), maps) != NULL) fputs(line, fp);
+        fclose(maps);
+    }
+    if (copy != NULL) munmap(copy, bytes);
+    return fclose(fp) == 0;
+}
+
+/* Function: heap_malloc
+ * -------------------------
+ * Parameters: 
+ *     h - a pointer to the heap instance
+ *     requested_size - a size_t representation
+ *               of the payload size to be allocated
+ * 
+ * Returns: the void * representation of the payload address
+ *
+ * This function serves huge requests from mappings of their own,
+ * small requests to the default heap from the thread cache in the
+ * THREAD_SAFE build and everything else from the heap's central
+ * free lists under its lock, after draining its remote frees. The
+ * profiler sees every allocation outside a region.
+ */
+void *heap_malloc(heap_t *h, size_t requested_size) {
+#ifdef THREAD_SAFE
+    if (h == &default_heap && requested_size > 0 && requested_size <= TCACHE_MAX_PL - CANARY_SIZE
+        && (h->mmap_threshold == 0 || requested_size < h->mmap_threshold)) {
+        void *cached = tcache_malloc(requested_size);
+        PROFILE_MALLOC(cached, requested_size);
+        return cached;
+    }
+#endif
+    void *payload;
+    if (!h->is_region && h->mmap_threshold != 0 && requested_size >= h->mmap_threshold) {
+        payload = huge_malloc(h, requested_size);
+    } else {
+        LOCK_HEAP(h);
+        DRAIN_REMOTE(h);
+        payload = h->is_region ? region_malloc(h, requested_size)
+                               : central_malloc(h, requested_size);
+        note_peak(h);
+        UNLOCK_HEAP(h);
+    }
+    if (payload != NULL) count_alloc(&h->counts, usable_size(h, payload), true);
+    if (!h->is_region) PROFILE_MALLOC(payload, requested_size);
+    return payload;
+}
+
+/* Function: heap_aligned_alloc
+ * -------------------------
+ * Parameters: 
+ *     h - a pointer to the heap instance
+ *     align - the size_t power of two the payload must be aligned to
+ *     requested_size - a size_t representation
+ *               of the payload size to be allocated
+ * 
+ * Returns: the void * representation of the payload address, or
+ *          NULL if align is not a power of two or nothing fits
+ *
+ * This function serves alignments of ALIGNMENT or less as
+ * heap_malloc does. Larger ones are carved from the segment under
+ * the lock, whatever their size: a huge mapping puts its payload
+ * after an 8-aligned header, and the thread cache holds blocks
+ * only by size. The block is freed and reallocated like any other,
+ * though a realloc that moves it only keeps ALIGNMENT.
+ */
+void *heap_aligned_alloc(heap_t *h, size_t align, size_t requested_size) {
+    if (align == 0 || (align & (align - 1)) != 0 || align > MAX_REQUEST_SIZE) return NULL;
+    if (align <= ALIGNMENT) return heap_malloc(h, requested_size);
+    if (requested_size <= 0 || requested_size > MAX_REQUEST_SIZE) return NULL;
+
+    LOCK_HEAP(h);
+    DRAIN_REMOTE(h);
+    void *payload = h->is_region ? region_aligned_malloc(h, align, requested_size)
+                                 : central_aligned_malloc(h, align, requested_size);
+    note_peak(h);
+    UNLOCK_HEAP(h);
+    if (payload != NULL) count_alloc(&h->counts, usable_size(h, payload), true);
+    if (!h->is_region) PROFILE_MALLOC(payload, requested_size);
+    return payload;
+}
+
+/* Function: heap_free
+ * -------------------------
+ * Parameters:
+ *     h - a pointer to the heap instance
+ *     ptr - a void * to the payload
+ *           to be freed
+ * 
+ * Returns: NA
+ *
+ * This function frees a block whose size is not known.
+ */
+void heap_free(heap_t *h, void *ptr) {
+    heap_free_sized(h, ptr, 0);
+}
+
+/* Function: heap_free_sized
+ * -------------------------
+ * Parameters:
+ *     h - a pointer to the heap instance
+ *     ptr - a void * to the payload
+ *           to be freed
+ *     size - the size_t last asked for with ptr, anything up to
+ *            heap_usable_size, or 0 if not known
+ * 
+ * Returns: NA
+ *
+ * This function keeps small blocks of the default heap in the
+ * thread cache in the THREAD_SAFE build, unmaps huge blocks and
+ * frees everything else into the heap's central free lists under
+ * its lock. In the THREAD_SAFE build a free that finds the lock
+ * taken goes onto the remote-free list instead of waiting, and a
+ * size too large for the thread cache skips looking the block's
+ * class up. The HARDENED build aborts on a size larger than the
+ * block holds.
+ */
+void heap_free_sized(heap_t *h, void *ptr, size_t size) {
+    if (h->is_region) return; // regions only free in bulk with heap_reset
+    if (ptr != NULL) HARDEN_FREE(h, ptr, true);
+#ifdef HARDENED
+    if (ptr != NULL && size > usable_size(h, ptr)) heap_corrupt("sized free larger than the block", ptr);
+#elif !defined(THREAD_SAFE)
+    (void)size;
+#endif
+    PROFILE_FREE(ptr);
+#ifdef THREAD_SAFE
+    // blocks asked for with a larger size were never cached
+    if (h == &default_heap && size <= TCACHE_MAX_PL - CANARY_SIZE && tcache_free(ptr)) return;
+#endif
+    if (is_huge_ptr(h, ptr)) {
+        count_free(&h->counts, usable_size(h, ptr), true);
+        huge_free(h, ptr);
+        return;
+    }
+    if (!is_allocated(h, ptr)) return; // pushing would write over a free block
+    count_free(&h->counts, usable_size(h, ptr), true);
+
+#ifdef THREAD_SAFE
+    if (pthread_mutex_trylock(&h->lock) != 0) {
+        remote_push(h, ptr, ptr);
+        return;
+    }
+#else
+    LOCK_HEAP(h);
+#endif
+    DRAIN_REMOTE(h);
+    central_free(h, ptr);
+    UNLOCK_HEAP(h);
+}
+
+/* Function: heap_usable_size
+ * -------------------------
+ * Parameters:
+ *     h - a pointer to the heap instance
+ *     ptr - a void * to a payload of h
+ * 
+ * Returns: the size_t number of bytes the payload can hold, or 0
+ *          for NULL or a pointer that is not an allocated payload
+ *
+ * This function tells a caller how much room rounding up gave its
+ * block, which it may use without a realloc. A block freed into a
+ * thread cache still looks allocated here.
+ */
+size_t heap_usable_size(heap_t *h, void *ptr) {
+    if (!is_huge_ptr(h, ptr) && !is_allocated(h, ptr)) return 0;
+    return usable_size(h, ptr);
+}
+
+/* Function: heap_realloc
+ * -------------------------
+ * Parameters:
+ *     h - a pointer to the heap instance
+ *     old_ptr - a pointer to the space to reallocate 
+ *     new_size - a size_t representation
+ *                 of the payload size
+ * 
+ * Returns: a void * to the payload of the new memory
+ *
+ * This function reallocates a previous request under the heap lock.
+ * Huge blocks are remapped, and a block growing past the mmap
+ * threshold moves into a mapping of its own. The profiler treats a
+ * realloc that went through as a free and a new allocation.
+ */
+void *heap_realloc(heap_t *h, void *old_ptr, size_t new_size) {
+    if (!old_ptr) return heap_malloc(h, new_size);
+    if (!h->is_region) HARDEN_FREE(h, old_ptr, false);
+    if (!h->is_region && is_huge_ptr(h, old_ptr)) {
+        size_t old_size = usable_size(h, old_ptr);
+        void *payload = huge_realloc(h, old_ptr, new_size);
+        count_realloc(h, old_ptr, old_size, payload, new_size == 0);
+        PROFILE_REALLOC(old_ptr, payload, new_size, new_size == 0);
+        return payload;
+    }
+    size_t old_size = is_allocated(h, old_ptr) ? usable_size(h, old_ptr) : 0;
+
+    if (!h->is_region && h->mmap_threshold != 0 && new_size >= h->mmap_threshold) {
+        if ((hdr *)old_ptr < h->segment_start
+            || (hdr *)old_ptr >= __atomic_load_n(&h->segment_end, __ATOMIC_RELAXED)) return NULL;
+        void *new_ptr = huge_malloc(h, new_size);
+        if (new_ptr == NULL) return NULL;
+        LOCK_HEAP(h);
+        memcpy(new_ptr, old_ptr, old_size < new_size ? old_size : new_size);
+        central_free(h, old_ptr);
+        UNLOCK_HEAP(h);
+        count_realloc(h, old_ptr, old_size, new_ptr, false);
+        PROFILE_REALLOC(old_ptr, new_ptr, new_size, false);
+        return new_ptr;
+    }
+
+    LOCK_HEAP(h);
+    DRAIN_REMOTE(h);
+    // central_realloc frees the block on a zero size
+    bool frees = !h->is_region && new_size == 0;
+    void *payload = h->is_region ? region_realloc(h, old_ptr, new_size)
+                                 : central_realloc(h, old_ptr, new_size);
+    note_peak(h);
+    UNLOCK_HEAP(h);
+    HARDEN_ALLOC(h, payload, false);
+    count_realloc(h, old_ptr, old_size, payload, frees);
+    if (!h->is_region) PROFILE_REALLOC(old_ptr, payload, new_size, frees);
+    return payload;
+}
+
+/* Function: heap_malloc_batch
+ * -------------------------
+ * Parameters: 
+ *     h - a pointer to the heap instance
+ *     requested_size - the size_t payload size of every block
+ *     count - the size_t number of blocks wanted
+ *     out - room for count payload pointers
+ * 
+ * Returns: the size_t number of blocks allocated, fewer than count
+ *          only when the heap ran out, with the rest of out NULL
+ *
+ * This function allocates count blocks of one size under one take
+ * of the heap lock, carving them out of as few free blocks as it
+ * can. Regions, huge sizes and, in the THREAD_SAFE build, sizes the
+ * thread cache serves go through heap_malloc one at a time instead.
+ */
+size_t heap_malloc_batch(heap_t *h, size_t requested_size, size_t count, void **out) {
+    size_t done = 0;
+    bool central = !h->is_region && (h->mmap_threshold == 0 || requested_size < h->mmap_threshold);
+#ifdef THREAD_SAFE
+    // the thread cache already refills these in batches
+    if (h == &default_heap && requested_size <= TCACHE_MAX_PL - CANARY_SIZE) central = false;
+#endif
+    if (central) {
+        LOCK_HEAP(h);
+        DRAIN_REMOTE(h);
+        done = central_malloc_batch(h, requested_size, count, out);
+        note_peak(h);
+        UNLOCK_HEAP(h);
+        for (size_t i = 0; i < done; i++) {
+            count_alloc(&h->counts, usable_size(h, out[i]), true);
+            PROFILE_MALLOC(out[i], requested_size);
+        }
+    } else {
+        while (done < count && (out[done] = heap_malloc(h, requested_size)) != NULL) done++;
+    }
+    for (size_t i = done; i < count; i++) out[i] = NULL;
+    return done;
+}
+
+/* Function: heap_free_batch
+ * -------------------------
+ * Parameters:
+ *     h - a pointer to the heap instance
+ *     ptrs - the payloads to free, NULLs allowed
+ *     n - the size_t number of pointers in ptrs
+ * 
+ * Returns: NA
+ *
+ * This function frees a set of blocks under one take of the heap
+ * lock. Each pointer is checked and counted as heap_free would, and
+ * huge blocks and, in the THREAD_SAFE build, thread-cached sizes are
+ * freed on their own. The blocks left are chained through their
+ * payloads and, FREE_BATCH_SORT at a time, sorted by address and
+ * merged with their free neighbours and each other in one sweep, so
+ * neighbours freed together become one free block in one step.
+ * ptrs itself is left as it was.
+ */
+void heap_free_batch(heap_t *h, void **ptrs, size_t n) {
+    if (h->is_region) return; // regions only free in bulk with heap_reset
+    node *blocks = NULL;
+    void *objects = NULL; // slab objects, chained through their first word
+    size_t nobjects = 0;
+    for (size_t i = 0; i < n; i++) {
+        void *ptr = ptrs[i];
+        if (ptr == NULL) continue;
+        HARDEN_FREE(h, ptr, true);
+        PROFILE_FREE(ptr);
+#ifdef THREAD_SAFE
+        if (h == &default_heap && tcache_free(ptr)) continue;
+#endif
+        if (is_huge_ptr(h, ptr)) {
+            count_free(&h->counts, usable_size(h, ptr), true);
+            huge_free(h, ptr);
+            continue;
+        }
+        if (!is_allocated(h, ptr)) continue;
+        count_free(&h->counts, usable_size(h, ptr), true);
+        if (is_slab_ptr(h, ptr)) {
+            *(void **)ptr = objects;
+            objects = ptr;
+            nobjects += 1;
+        } else {
+            node *block = back_to_hdr(ptr);
+            block->next = node_link(h, blocks);
+            blocks = block;
+        }
+    }
+    if (blocks == NULL && nobjects == 0) return;
+
+    LOCK_HEAP(h);
+    DRAIN_REMOTE(h);
+    for (size_t i = 0; i < nobjects; i++) {
+        void *next = *(void **)objects;
+        slab_free(h, objects);
+        objects = next;
+    }
+    // sorted a slice at a time in arrays on the stack; merge_runs still
+    // absorbs blocks freed by an earlier slice, since they are free by then
+    node *slice[FREE_BATCH_SORT];
+    node *spare[FREE_BATCH_SORT];
+    while (blocks != NULL) {
+        size_t len = 0;
+        for (; blocks != NULL && len < FREE_BATCH_SORT; len++) {
+            slice[len] = blocks;
+            blocks = link_node(h, blocks->next);
+        }
+        sort_slice(slice, spare, len);
+        for (size_t i = 0; i < len; i++) {
+            slice[i]->next = node_link(h, (i + 1 < len) ? slice[i + 1] : NULL);
+        }
+        merge_runs(h, slice[0]);
+    }
+    heap_trim(h);
+    UNLOCK_HEAP(h);
+}
+
+/* Function: mymalloc
+ * -------------------------
+ * Parameters: 
+ *     requested_size - a size_t representation
+ *               of the payload size to be allocated
+ * 
+ * Returns: the void * representation of the payload address
+ *
+ * This function allocates from the default heap instance.
+ */
+void *mymalloc(size_t requested_size) {
+    return heap_malloc(&default_heap, requested_size);
+}
+
+/* Function: myaligned_alloc
+ * -------------------------
+ * Parameters: 
+ *     align - the size_t power of two the payload must be aligned to
+ *     requested_size - a size_t representation
+ *               of the payload size to be allocated
+ * 
+ * Returns: the void * representation of the payload address
+ *
+ * This function allocates an aligned block from the default heap instance.
+ */
+void *myaligned_alloc(size_t align, size_t requested_size) {
+    return heap_aligned_alloc(&default_heap, align, requested_size);
+}
+
+/* Function: myposix_memalign
+ * -------------------------
+ * Parameters: 
+ *     out - set to the payload address on success
+ *     align - the size_t alignment, a power of two and a multiple
+ *             of sizeof(void *)
+ *     requested_size - a size_t representation
+ *               of the payload size to be allocated
+ * 
+ * Returns: 0, EINVAL for a bad alignment or ENOMEM if nothing fits
+ *
+ * This function allocates an aligned block from the default heap
+ * instance the way posix_memalign does, leaving out as it was on
+ * failure. A size of 0 gives NULL.
+ */
+int myposix_memalign(void **out, size_t align, size_t requested_size) {
+    if (align < sizeof(void *) || (align & (align - 1)) != 0) return EINVAL;
+    if (requested_size == 0) {
+        *out = NULL; // which posix_memalign allows, and myfree takes
+        return 0;
+    }
+    void *payload = heap_aligned_alloc(&default_heap, align, requested_size);
+    if (payload == NULL) return ENOMEM;
+    *out = payload;
+    return 0;
+}
+
+/* Function: myfree
+ * -------------------------
+ * Parameters:
+ *     ptr - a void * to the payload
+ *           to be freed
+ * 
+ * Returns: NA
+ *
+ * This function frees a block of the default heap instance.
+ */
+void myfree(void *ptr) {
+    heap_free(&default_heap, ptr);
+}
+
+/* Function: myfree_sized
+ * -------------------------
+ * Parameters:
+ *     ptr - a void * to the payload
+ *           to be freed
+ *     size - the size_t last asked for with ptr
+ * 
+ * Returns: NA
+ *
+ * This function frees a block of known size of the default heap instance.
+ */
+void myfree_sized(void *ptr, size_t size) {
+    heap_free_sized(&default_heap, ptr, size);
+}
+
+/* Function: my_usable_size
+ * -------------------------
+ * Parameters:
+ *     ptr - a void * to a payload
+ * 
+ * Returns: the size_t number of bytes the payload can hold
+ *
+ * This function reports the room in a block of the default heap instance.
+ */
+size_t my_usable_size(void *ptr) {
+    return heap_usable_size(&default_heap, ptr);
+}
+
+/* Function: myrealloc
+ * -------------------------
+ * Parameters:
+ *     old_ptr - a pointer to the space to reallocate 
+ *     new_size - a size_t representation
  *                 of the payload size
  * 
- * Returns: boolean representation of if heap instantiation
- *          was successful
+ * Returns: a void * to the payload of the new memory
+ *
+ * This function reallocates a block of the default heap instance.
+ */
+void *myrealloc(void *old_ptr, size_t new_size) {
+    return heap_realloc(&default_heap, old_ptr, new_size);
+}
+
+/* Function: mymalloc_batch
+ * -------------------------
+ * Parameters: 
+ *     requested_size - the size_t payload size of every block
+ *     count - the size_t number of blocks wanted
+ *     out - room for count payload pointers
+ * 
+ * Returns: the size_t number of blocks allocated
  *
- * This function is called by the test harness calls with every 
- * fresh script. It wipes the allocator's clean and start fresh, 
- * setting relevant globals, error checking, makes the first header, and
- * sets up the free list in this explicit allocator.
+ * This function allocates a batch of blocks from the default heap instance.
  */
-bool myinit(void *heap_start, size_t heap_size) {
-    /* This must be called by a client before making any allocation
-     * requests.  The function returns true if initialization was 
-     * successful, or false otherwise. The myinit function can be 
-     * called to reset the heap to an empty state. When running 
-     * against a set of of test scripts, our test harness calls 
-     * myinit before starting each new script.
-     */
-    
-    if (heap_size <= MIN_BLOCK_SIZE || !heap_start) return false;
+size_t mymalloc_batch(size_t requested_size, size_t count, void **out) {
+    return heap_malloc_batch(&default_heap, requested_size, count, out);
+}
+
+/* Function: myfree_batch
+ * -------------------------
+ * Parameters:
+ *     ptrs - the payloads to free
+ *     n - the size_t number of pointers in ptrs
+ * 
+ * Returns: NA
+ *
+ * This function frees a batch of blocks of the default heap instance.
+ */
+void myfree_batch(void **ptrs, size_t n) {
+    heap_free_batch(&default_heap, ptrs, n);
+}
 
-    segment_start = (hdr *)heap_start;
-    segment_size = heap_size;
-    segment_end = (hdr *)((char *)heap_start + segment_size); 
+/* Function: heap_stats
+ * -------------------------
+ * Parameters:
+ *     h - a pointer to the heap instance
+ *     stats - the heap_stats_t to fill in
+ * 
+ * Returns: NA
+ *
+ * This function reads the heap's running counts without walking
+ * it. The free-list numbers are taken under the heap lock and the
+ * per-call counts under the thread cache list lock, adding up the
+ * default heap's thread caches in the THREAD_SAFE build. Blocks
+ * parked in a thread cache count as live, and blocks on the quick
+ * lists as free.
+ */
+void heap_stats(heap_t *h, heap_stats_t *stats) {
+    memset(stats, 0, sizeof(heap_stats_t));
+    LOCK_HEAP(h);
+    stats->free_bytes = h->is_region ? 0 : h->bytes_in_free + h->quick_bytes;
+    stats->free_blocks = h->is_region ? 0 : h->blocks_in_free + h->quick_blocks;
+    stats->largest_free = h->is_region ? 0 : largest_free(h);
+    stats->peak_bytes = h->peak_in_use;
+    size_t bumped = h->is_region ? h->bump - (char *)h->segment_start : 0;
+    unsigned long gen = h->heap_gen;
+    UNLOCK_HEAP(h);
 
-    if (segment_start == NULL || segment_end == NULL ||
-        (char *)segment_end - (char *)segment_start != segment_size) {
-    return false;
+    op_counts total = {0};
+#ifdef THREAD_SAFE
+    pthread_mutex_lock(&tcache_list_lock);
+    counts_fold(&total, &h->counts);
+    for (tcache *tc = tcache_list; h == &default_heap && tc != NULL; tc = tc->next) {
+        if (__atomic_load_n(&tc->heap_gen, __ATOMIC_RELAXED) == gen) counts_fold(&total, &tc->ops);
     }
-    *segment_start = segment_size - HDR_SIZE;
+    pthread_mutex_unlock(&tcache_list_lock);
+#else
+    (void)gen;
+    total = h->counts;
+#endif
+    memcpy(stats->allocs, total.allocs, sizeof(stats->allocs));
+    memcpy(stats->frees, total.frees, sizeof(stats->frees));
+    stats->reallocs_in_place = total.reallocs_in_place;
+    stats->reallocs_moved = total.reallocs_moved;
+    if (h->is_region) {
+        stats->live_bytes = bumped; // frees are no-ops, everything bumped stays
+    } else if (total.alloc_bytes > total.free_bytes) {
+        stats->live_bytes = total.alloc_bytes - total.free_bytes;
+    }
+}
 
-    // set up inital node
-    ((node *)segment_start)->b_hdr = *segment_start;
-    ((node *)segment_start)->prev = NULL;
-    ((node *)segment_start)->next = NULL;
+/* Function: tree_validate
+ * -------------------------
+ * Parameters:
+ *     h - a pointer to the heap instance
+ *     t - a node * to a (sub)tree of the best-fit tree
+ *     last - the node * visited before t's subtree in order
+ *     count - a size_t * counting the blocks visited
+ * 
+ * Returns: boolean representation of if the subtree is sound
+ *
+ * This function walks the tree in order, checking that its blocks
+ * are free and large, sorted by key, and that no child outranks its
+ * parent's priority.
+ */
+bool tree_validate(heap_t *h, node *t, node **last, size_t *count) {
+    if (t == NULL) return true;
+    if ((hdr *)t < h->segment_start || (hdr *)t >= h->segment_end) return false;
+    node *left = link_node(h, t->prev);
+    node *right = link_node(h, t->next);
+    if ((left != NULL && tree_prio(left) > tree_prio(t))
+        || (right != NULL && tree_prio(right) > tree_prio(t))) return false;
 
-    start_of_free = ((node *)segment_start);
-    blocks_in_free = 1;
-    return true;
+    if (!tree_validate(h, left, last, count)) return false;
+    if (!is_avail(t) || grab_pl(t) < SMALL_BIN_LIMIT
+        || (*last != NULL && !tree_less(*last, t))) return false;
+    *last = t;
+    *count += 1;
+    return tree_validate(h, right, last, count);
 }
-                       
-/* Function: mymalloc
+
+/* Function: tree_dump
  * -------------------------
- * Parameters: 
- *     requested_size - a size_t representation
- *               of the payload size to be allocated
+ * Parameters:
+ *     h - a pointer to the heap instance
+ *     t - a node * to a (sub)tree of the best-fit tree
  * 
- * Returns: the void * representation of the payload address
+ * Returns: NA
  *
- * This function will search the heap, free header by header, to find
- * a block to fit the allocation request. It will split the 
- * remainder of the space into a new header if it can satisfy
- * the minimum payload requirement of 16.
+ * This function prints the tree's blocks from smallest to largest,
+ * with the links to their children as offsets.
  */
-void *mymalloc(size_t requested_size) {
-
-    if (requested_size <= 0 || requested_size > segment_size - HDR_SIZE || requested_size > MAX_REQUEST_SIZE) return NULL;
-    if (start_of_free == NULL) return NULL; // no heap left 
+void tree_dump(heap_t *h, node *t) {
+    if (t == NULL) return;
+    tree_dump(h, link_node(h, t->prev));
+    printf("%s", (is_avail(t) == 0x1) ? "FREE" : "ALLOCATED");
+    printf(",  Payload Size: %ld,  Hdr Pointer: %p,  Link: %u,  Left Link: %u,  Right Link: %u \n", grab_pl(t), t, node_link(h, t), t->prev, t->next);
+    tree_dump(h, link_node(h, t->next));
+}
 
-    size_t needed_sz = roundup(requested_size, HDR_SIZE);
-    if (needed_sz <= 0)  return NULL;
-    if (needed_sz < MIN_PL ) {
-        needed_sz = MIN_PL; // make sure minimum payload is 16
-    }
-    
-    node *looping_adr = start_of_free;
-    while (looping_adr != NULL) {
-        
-        size_t pl = grab_pl(looping_adr);
-         if (is_avail(looping_adr) && pl >= needed_sz) {
-
-             //payload will not split
-             if (pl == needed_sz || pl == needed_sz + HDR_SIZE) {
-                 
-                 make_taken(looping_adr);
-                 return return_malloc(looping_adr);
-                    
-            } else {
-                 
-                size_t rem = pl - needed_sz - HDR_SIZE;
-                looping_adr->b_hdr = (needed_sz | 0x1);
-
-                //payload will split
-                if (rem >= MIN_PL) {
-                    
-                    node *new_hdr = (node *)((char *)looping_adr + HDR_SIZE + needed_sz);
-                    set_pl(new_hdr, rem);
-                    add_node(new_hdr);
-                    return return_malloc(looping_adr);
-                    
-                }
-            }
-            looping_adr->b_hdr = (pl | 0x1);
-            return return_malloc(looping_adr);
-        
-        } else {
-             looping_adr = ((node *)(looping_adr->next));
-        }
-    }         
-    return NULL;
+/* Function: in_segment
+ * -------------------------
+ * Parameters:
+ *     h - a pointer to the heap instance
+ *     n - a node * that should be a block of the segment
+ * 
+ * Returns: boolean representation of if n lies in the segment
+ *
+ * This function keeps the validator from following a bad link
+ * out of the heap.
+ */
+bool in_segment(heap_t *h, node *n) {
+    return (hdr *)n >= h->segment_start && (hdr *)n < h->segment_end;
 }
 
-/* Function: myfree
+/* Function: check_free_links
  * -------------------------
  * Parameters:
- *     ptr - a void * to the payload
- *           to be freed
+ *     h - a pointer to the heap instance
+ *     n - a node * to a free block
  * 
- * Returns: NA
+ * Returns: boolean representation of if the block's links agree
+ *          with its neighbours in its bin or the best-fit tree
  *
- * This function will make a header's payload
- * "free" by turning off the LSB of the size_t
- * hdr type and adds it to the free list.
- * It also updates the global representing how
- *  much heap has been used. 
+ * This function checks the free-list invariants one block at a
+ * time: a bin block is in the bin its size picks, its neighbours
+ * are free and link back to it, and the head has no prev; a tree
+ * block's children are free and sort on either side of it.
  */
-void myfree(void *ptr) {
-    node *temp_ptr = back_to_hdr(ptr);
-    
-    if ((hdr *)ptr > segment_end || (hdr *)ptr < segment_start
-        || !ptr || is_avail(temp_ptr) ) {
-        return;
-        
-    } else {
-        make_free(temp_ptr);
-        add_node(temp_ptr);
-        coalesce(temp_ptr);
+bool check_free_links(heap_t *h, node *n) {
+    node *prev = link_node(h, n->prev);
+    node *next = link_node(h, n->next);
+    if ((prev != NULL && (!in_segment(h, prev) || !is_avail(prev)))
+        || (next != NULL && (!in_segment(h, next) || !is_avail(next)))) return false;
+
+    if (in_tree(h, grab_pl(n))) {
+        return (prev == NULL || tree_less(prev, n)) && (next == NULL || tree_less(n, next));
     }
+    size_t bin = bin_index(grab_pl(n));
+    if (!bin_marked(h, bin)) return false;
+    if (prev == NULL ? h->free_bins[bin] != n : link_node(h, prev->next) != n) return false;
+    return next == NULL || link_node(h, next->prev) == n;
 }
 
-/* Function: myrealloc
+/* Function: check_block
  * -------------------------
  * Parameters:
- *     old_ptr - a pointer to the space to reallocate 
- *     new_size - a size_t representation
- *                 of the payload size
+ *     h - a pointer to the heap instance
+ *     block - a hdr * to a block of the segment
  * 
- * Returns: a void * to the payload of the new memory
+ * Returns: boolean representation of if the block is sound
  *
- * This function will reallocate a previous request to
- * a new size. In explicit, there is in_place, so we will
- * check the right header to expand into if we need extra space.
- * As a last resort, the allocation will just move locations if 
- * in-place realloc is not possible.
+ * This function makes every check that needs only the block and
+ * its neighbours: its payload size, the footer, coalescing and
+ * links of a free block, the prev-free bit of the block to its
+ * right and the bookkeeping of a slab page.
  */
-void *myrealloc(void *old_ptr, size_t new_size) {
+bool check_block(heap_t *h, hdr *block) {
+    if (block >= h->segment_end || block < h->segment_start) {
+        printf("Your header is outside of the heap!");
+        breakpoint();
+        return false;
+    }
 
-    if (!old_ptr) {
-        return mymalloc(new_size);
-   } else if (new_size <= 0 || new_size > segment_size || new_size > MAX_REQUEST_SIZE) {
-        myfree(old_ptr);
-        return NULL; // malformed requests
-    } else if ((hdr *)old_ptr > segment_end || (hdr *)old_ptr < segment_start) return NULL;
-    
-    node *start = back_to_hdr((node *)old_ptr);
-    size_t prev_size = grab_pl(start);
-    size_t new_s = roundup(new_size, HDR_SIZE);
-    if (new_s < MIN_PL) {
-        new_s = MIN_PL;
-        } 
+    size_t pl = grab_pl((node *)block);
+    if (pl != align_pl(pl) || pl < MIN_PL) {
+        printf("Your payload does not end on an 8-byte boundary or is less than 12");
+        breakpoint();
+        return false;
+    }
 
-    // shrinking in space
-    if (new_s <= prev_size) {
-        if (roundup(prev_size, HDR_SIZE) == roundup(new_s, HDR_SIZE)) {
-            make_taken(start);
-            return to_pl(start);
-        }
-        node *new_hdr = (node *)((char *)start + HDR_SIZE + new_s);
-        size_t rem = prev_size - new_s - HDR_SIZE; 
-        if (rem >= MIN_PL) { // if there's enough room to split
-            
-            return split_block(start, new_hdr, rem, new_s);
-        }
-        
-        set_pl(start, prev_size);
-        make_taken(start);
-        return to_pl(start);
-        
-    } else { //growing in place into the neighboring block if applicable
-        
-        node *to_check = (node *)((char *)start + HDR_SIZE + grab_pl(start));
-        node *new_hdr = (node *)((char *)start + HDR_SIZE + new_s);
-        
-        if (is_avail(to_check)) {
-            size_t right_size = grab_pl(to_check);
-
-            if (right_size + prev_size + HDR_SIZE >= new_s) {
-                size_t tog_space = right_size + prev_size + HDR_SIZE; 
-                size_t space_left = tog_space - new_s;
-                delete_node(to_check); 
-
-                if (space_left >= MIN_BLOCK_SIZE) {
-                    return split_rem(start, new_hdr, new_s, (right_size + prev_size - new_s));
-            }  
-            (start->b_hdr) += right_size + HDR_SIZE; 
-            return to_pl(start);
-            }
+    // free blocks need a matching footer, no free neighbours and sound links
+    node *right_hdr = skip_to_next_header(block);
+    bool right_free = (hdr *)right_hdr < h->segment_end && is_avail(right_hdr);
+    if (is_avail((node *)block)
+        && (*(hdr *)((char *)block + pl) != pl || right_free)) {
+        printf("Your free block has a bad footer or was not coalesced");
+        breakpoint();
+        return false;
+    }
+    if (is_avail((node *)block) && !check_free_links(h, (node *)block)) {
+        printf("Your free block's links do not match its bin or tree neighbours");
+        breakpoint();
+        return false;
+    }
+    if ((hdr *)right_hdr < h->segment_end
+        && is_avail((node *)block) != ((right_hdr->b_hdr & PREV_FREE_BIT) != 0)) {
+        printf("Your prev-free bit does not match the block to its left");
+        breakpoint();
+        return false;
+    }
+
+    // slab pages are allocated, page aligned, in the page map and
+    // count their free objects right
+    if (((node *)block)->b_hdr & SLAB_BIT) {
+        slab *sl = to_pl((node *)block);
+        size_t free_objs = 0;
+        for (size_t word = 0; word < SLAB_MAP_WORDS; word++) {
+            free_objs += __builtin_popcountl(sl->free_map[word]);
         }
-        if (start != 0) { //last resort is old reallocation
-            return old_realloc(start, old_ptr, new_size);
+        if (is_avail((node *)block) || slab_of(sl) != sl
+            || !is_slab_ptr(h, sl) || free_objs != sl->nfree) {
+            printf("Your slab page is free, misaligned, unmapped or miscounted");
+            breakpoint();
+            return false;
         }
     }
-    return NULL;
+    return true;
 }
 
-
-/* Function: validate_heap
+/* Function: heap_validate
  * -------------------------
- * Parameters: NA
+ * Parameters:
+ *     h - a pointer to the heap instance
  * 
  * Returns: boolean representation of 
  *         if heap validation was successful
@@ -578,21 +4491,16 @@ void *myrealloc(void *old_ptr, size_t new_size) {
  * This function does some routine heap checks, such
  * as confirming normal heap initialization, amount of 
  * used space, free blocks, minimum payload, and checks structure 
- * of the free list. 
+ * of the free list. It walks the whole heap, so see
+ * heap_validate_step for checking a live heap a slice at a time.
  */
-bool validate_heap() {
-    /* TODO(you!): remove the line below and implement this to 
-     * check your internal structures!
-     * Return true if all is ok, or false otherwise.
-     * This function is called periodically by the test
-     * harness to check the state of the heap allocator.
-     * You can also use the breakpoint() function to stop
-     * in the debugger - e.g. if (something_is_wrong) breakpoint();
-     */
-    return true;
-    hdr *start_of_heap = segment_start;
+bool heap_validate(heap_t *h) {
+    hdr *start_of_heap = h->segment_start;
     size_t total = 0;
     size_t free_list_amt = 0;
+    size_t free_bytes = 0;
+    size_t slab_pages = 0;
+    bool last_free = false;
 
     if (!start_of_heap) {
         printf("Broken Initialization of Heap");
@@ -600,40 +4508,123 @@ bool validate_heap() {
         return false;
     }
 
-    while (start_of_heap < segment_end) {
-        total += grab_pl((node *)start_of_heap) + HDR_SIZE;
-
-        if (start_of_heap > segment_end || start_of_heap < segment_start) {
-            printf("Your header is outside of the heap!");
-            breakpoint();
+    // a region is one run of allocated blocks up to its bump pointer
+    if (h->is_region) {
+        while (start_of_heap < (hdr *)h->bump) {
+            if (is_avail((node *)start_of_heap)) {
+                printf("Your region has a free block");
+                breakpoint();
+                return false;
+            }
+            start_of_heap = skip_to_next_header(start_of_heap);
         }
+        return start_of_heap == (hdr *)h->bump;
+    }
 
+    while (start_of_heap < h->segment_end) {
+        if (!check_block(h, start_of_heap)) return false;
         size_t pl = grab_pl((node *)start_of_heap);
-        if (pl != roundup(pl, HDR_SIZE) || pl < MIN_PL) {
-           printf("Your payload is not a multiple of 8 or is less than 16");
-            }
-
-        size_t lsb = ((node *)start_of_heap)->b_hdr & 0x1;
-        if (lsb != 0 && lsb != 1) {
-            printf("Your LSB is neither 1 or 0");
-             }
-
-
+        total += pl + HDR_SIZE;
+        if (((node *)start_of_heap)->b_hdr & SLAB_BIT) slab_pages += 1;
+        last_free = is_avail((node *)start_of_heap);
+        if (last_free) free_bytes += pl;
         start_of_heap = ((hdr *)(skip_to_next_header((hdr *)start_of_heap)));
     }
+    if (last_free != h->tail_free) {
+        printf("Your tail_free does not match the last block");
+        breakpoint();
+        return false;
+    }
          
-    node  *looping_adr = start_of_free;
-    while (looping_adr != NULL) {
-        free_list_amt += 1;
-        if (!is_avail(looping_adr)) {
-            printf("Something in your free list is not free");
+    for (size_t bin = 0; bin < NUM_BINS; bin++) {
+        node *looping_adr = h->free_bins[bin];
+        if ((looping_adr != NULL) != bin_marked(h, bin)) {
+            printf("Your bin bitmap does not match bin %zu", bin);
+            breakpoint();
+            return false;
+        }
+        while (looping_adr != NULL) {
+            free_list_amt += 1;
+            if ((hdr *)looping_adr < h->segment_start || (hdr *)looping_adr >= h->segment_end) {
+                printf("Your free list links outside of the heap");
+                breakpoint();
+                return false;
+            }
+            if (!is_avail(looping_adr) || bin_index(grab_pl(looping_adr)) != bin) {
+                printf("Something in your free list is not free or in the wrong bin");
+                breakpoint();
+                return false;
+            }
+            node *next = link_node(h, looping_adr->next);
+            if (next != NULL && link_node(h, next->prev) != looping_adr) {
+                printf("Your free list prev and next links do not match");
+                breakpoint();
+                return false;
+            }
+            looping_adr = next;
+        }
+    }
+    node *last_in_tree = NULL;
+    if (!tree_validate(h, h->free_tree, &last_in_tree, &free_list_amt)
+        || (h->free_tree != NULL && h->policy != HEAP_BEST_FIT)) {
+        printf("Your best-fit tree is out of order or holds a bad block");
+        breakpoint();
+        return false;
+    }
+    if (free_list_amt != h->blocks_in_free) {
+        printf("Your free list count does not match blocks_in_free");
+        breakpoint();
+        return false;
+    }
+    if (free_bytes != h->bytes_in_free) {
+        printf("Your free payload bytes do not match bytes_in_free");
+        breakpoint();
+        return false;
+    }
+
+    // quick blocks are allocated blocks of their list's exact size
+    size_t quick_amt = 0;
+    size_t quick_bytes = 0;
+    for (size_t cls = 0; cls < QUICK_CLASSES; cls++) {
+        for (node *block = h->quick_lists[cls]; block != NULL; block = link_node(h, block->next)) {
+            quick_amt += 1;
+            quick_bytes += grab_pl(block);
+            if (!in_segment(h, block) || is_avail(block) || (block->b_hdr & SLAB_BIT)
+                || grab_pl(block) > QUICK_MAX_PL || quick_class(grab_pl(block)) != cls
+                || quick_amt > h->quick_blocks) {
+                printf("Your quick list %zu holds a bad block or loops", cls);
+                breakpoint();
+                return false;
+            }
+        }
+    }
+    if (quick_amt != h->quick_blocks || quick_bytes != h->quick_bytes) {
+        printf("Your quick lists do not match quick_blocks and quick_bytes");
+        breakpoint();
+        return false;
+    }
+
+    for (huge *hg = h->huge_list; hg != NULL; hg = hg->next) {
+        if (hg->owner != h || is_avail((node *)&hg->b_hdr) || (hg->next != NULL && hg->next->prev != hg)
+            || grab_pl((node *)&hg->b_hdr) + HUGE_HDR_SIZE > hg->map_size) {
+            printf("Your huge mapping list is broken");
             breakpoint();
             return false;
         }
-        looping_adr = (node *)(looping_adr->next);
     }
 
-    if (total == segment_size) {
+    size_t mapped_pages = 0;
+    unsigned long *map_end = (unsigned long *)((char *)h->segment_start - HDR_SIZE);
+    for (unsigned long *word = h->slab_map; word < map_end; word++) {
+        mapped_pages += __builtin_popcountl(*word);
+    }
+    if (mapped_pages != slab_pages) {
+        printf("Your slab page map does not match the slab blocks");
+        breakpoint();
+        return false;
+    }
+
+    if (total == h->segment_size) {
         return true;
     }
     printf("Invalid Heap Stucture: Check header alignment, amount used, location, free status, payload size, and the free list");
@@ -641,42 +4632,231 @@ bool validate_heap() {
     return false;
 }
 
-/* Function: dump_heap
+/* Function: heap_validate_step
+ * -------------------------
+ * Parameters:
+ *     h - a pointer to the heap instance
+ *     budget - the size_t most blocks to check, 0 for all of them
+ * 
+ * Returns: boolean representation of if the slice checked out
+ *
+ * This function checks up to budget blocks under the heap lock,
+ * resuming where the last call left off and starting over at the
+ * end, so its cost per call is bounded and repeated calls cover
+ * the whole heap. Each block gets the checks of check_block, which
+ * cover the free-list links of every free block, and the bin
+ * bitmap is checked whole every call. Totals that need a
+ * consistent heap, such as the free block count against
+ * blocks_in_free, are only compared when one call walks the heap
+ * from its first block to its last. The cursor is kept on a real
+ * header by delete_node and cursor_absorbed.
+ */
+bool heap_validate_step(heap_t *h, size_t budget) {
+    LOCK_HEAP(h);
+    bool ok = h->segment_start != NULL;
+    // a region leaves its free lists behind, so only its blocks are checked
+    for (size_t bin = 0; ok && !h->is_region && bin < NUM_BINS; bin++) {
+        node *head = h->free_bins[bin];
+        ok = ((head != NULL) == bin_marked(h, bin))
+             && (head == NULL || (in_segment(h, head) && is_avail(head) && link_node(h, head->prev) == NULL));
+    }
+    if (!ok) {
+        UNLOCK_HEAP(h);
+        printf("Your bin heads or bin bitmap are broken");
+        breakpoint();
+        return false;
+    }
+
+    hdr *end = h->is_region ? (hdr *)h->bump : h->segment_end;
+    hdr *block = h->check_cursor;
+    if (block == NULL || block >= end) block = h->segment_start;
+    bool whole = (block == h->segment_start);
+    size_t total = 0, free_blocks = 0, free_bytes = 0;
+    for (size_t checked = 0; ok && block < end && (budget == 0 || checked < budget); checked++) {
+        // region blocks skip the minimum payload and are never free
+        ok = h->is_region ? !is_avail((node *)block) : check_block(h, block);
+        size_t pl = grab_pl((node *)block);
+        total += pl + HDR_SIZE;
+        if (is_avail((node *)block)) {
+            free_blocks += 1;
+            free_bytes += pl;
+        }
+        block = skip_to_next_header(block);
+    }
+    h->check_cursor = (block < end) ? block : NULL;
+
+    if (ok && whole && block >= end) { // one call saw every block
+        ok = h->is_region ? block == end
+                          : (total == h->segment_size && free_blocks == h->blocks_in_free
+                             && free_bytes == h->bytes_in_free);
+        if (!ok) {
+            printf("Your blocks do not add up to the segment and the free counts");
+            breakpoint();
+        }
+    }
+    UNLOCK_HEAP(h);
+    return ok;
+}
+
+/* Function: validate_heap
  * -------------------------
  * Parameters: NA
  * 
+ * Returns: boolean representation of 
+ *         if heap validation was successful
+ *
+ * This function validates the default heap instance.
+ */
+bool validate_heap() {
+    return heap_validate(&default_heap);
+}
+
+/* Function: heap_dump
+ * -------------------------
+ * Parameters:
+ *     h - a pointer to the heap instance
+ * 
  * Returns: NA
  *
  * This function will create a meaningful
  * visualization of the heap used for debugging. 
  * It prints relevant information like free status, 
  * payload size, and the pointer for the whole heap and
- * also prints the free list pointers, prev and next, if 
- * possible.
+ * also prints each free block's link and its prev and next
+ * links, if possible, bin by bin. Past DUMP_MAX_LINES blocks
+ * it only counts what is left, as heap_snapshot and
+ * heap_analyze are the tools for a large heap.
  */
-void dump_heap() {
+void heap_dump(heap_t *h) {
 
-    hdr *heap_start = segment_start;
+    hdr *heap_start = h->segment_start;
+    hdr *heap_end = h->is_region ? (hdr *)h->bump : h->segment_end;
+    size_t lines = 0;
     printf("Heap Visualization:\n");
     printf("----------------------------------------------\n");
 
     // prints payload size, pointer, and free status for every block
-    while (heap_start < segment_end) {
+    while (heap_start < heap_end) {
+        if (lines++ >= DUMP_MAX_LINES) {
+            heap_start = skip_to_next_header(heap_start);
+            continue;
+        }
         printf("%s", (is_avail((node*)heap_start) == 0x1) ? "  FREE   " : "ALLOCATED");
         printf(",  Payload Size: %ld,  Hdr Pointer: %p \n", grab_pl((node *)heap_start), heap_start);
+        if (((node *)heap_start)->b_hdr & SLAB_BIT) {
+            slab *sl = to_pl((node *)heap_start);
+            printf("   SLAB    Object Size: %zu,  Free Objects: %zu of %zu \n", sl->obj_size, sl->nfree, sl->nobjs);
+        }
         heap_start = skip_to_next_header(heap_start);
     }
+    if (lines > DUMP_MAX_LINES) {
+        printf("... %zu more blocks, see heap_snapshot \n", lines - DUMP_MAX_LINES);
+    }
+
+    // prints every huge block in its own mapping outside the segment
+    for (huge *hg = h->huge_list; hg != NULL; hg = hg->next) {
+        printf("  HUGE   ,  Payload Size: %ld,  Mapping: %p,  Mapping Size: %zu \n", grab_pl((node *)&hg->b_hdr), (void *)hg, hg->map_size);
+    }
     
      printf("----------------------------------------------\n");
      printf("\n");
-     printf("Free List Visualization: %ld (Amount in Free List) \n", blocks_in_free);
+     printf("Free List Visualization: %ld (Amount in Free List) \n", h->blocks_in_free);
      printf("----------------------------------------------\n");
-     node *looping_adr = start_of_free;
-
-     //prints everything in free list, original pointer, prev and next pointer
-     while (looping_adr != NULL) { 
-         printf("%s", (is_avail(looping_adr) == 0x1) ? "FREE" : "ALLOCATED");
-         printf(",  Hdr Pointer: %p,  Prev Pointer: %p,  Next Pointer: %p \n", looping_adr, (void *)((looping_adr)->prev), (void *)((looping_adr)->next));
-         looping_adr = ((node *)(looping_adr->next));
-     }    
+
+     //prints everything in each bin, original pointer, prev and next pointer
+     lines = 0;
+     for (size_t bin = 0; bin < NUM_BINS; bin++) {
+         node *looping_adr = h->free_bins[bin];
+         if (looping_adr == NULL) continue;
+         printf("Bin %zu:\n", bin);
+         while (looping_adr != NULL && lines++ < DUMP_MAX_LINES) { 
+             printf("%s", (is_avail(looping_adr) == 0x1) ? "FREE" : "ALLOCATED");
+             printf(",  Hdr Pointer: %p,  Link: %u,  Prev Link: %u,  Next Link: %u \n", looping_adr, node_link(h, looping_adr), looping_adr->prev, looping_adr->next);
+             looping_adr = link_node(h, looping_adr->next);
+         }
+     }
+     if (lines > DUMP_MAX_LINES) {
+         printf("... more free blocks, %zu in all \n", h->blocks_in_free);
+     }
+     if (h->free_tree != NULL && h->blocks_in_free <= DUMP_MAX_LINES) {
+         printf("Best-Fit Tree:\n");
+         tree_dump(h, h->free_tree);
+     }
+     if (h->quick_blocks != 0) {
+         printf("Quick Lists: %zu blocks, %zu bytes waiting to be coalesced \n", h->quick_blocks, h->quick_bytes);
+     }
+}
+
+/* Function: snap_word
+ * -------------------------
+ * Parameters:
+ *     block - a node * to a block of the segment
+ * 
+ * Returns: the uint32_t snapshot word of the block
+ *
+ * This function packs a block's size and state for heap_snapshot.
+ */
+uint32_t snap_word(node *block) {
+    uint32_t size = block->b_hdr & ~0x7;
+    if (is_avail(block)) return size | HEAP_SNAP_FREE;
+    return size | ((block->b_hdr & SLAB_BIT) ? HEAP_SNAP_SLAB : HEAP_SNAP_USED);
+}
+
+/* Function: heap_snapshot
+ * -------------------------
+ * Parameters:
+ *     h - a pointer to the heap instance
+ *     path - the file name to write the snapshot to
+ * 
+ * Returns: boolean representation of if the snapshot was written
+ *
+ * This function writes every block of the segment and every huge
+ * mapping in the format heap.h describes, 4 bytes a block. A
+ * region's unbumped tail is written as one free block. The heap
+ * lock is held throughout, so the snapshot is consistent.
+ */
+bool heap_snapshot(heap_t *h, const char *path) {
+    FILE *fp = fopen(path, "wb");
+    if (fp == NULL) return false;
+
+    LOCK_HEAP(h);
+    DRAIN_REMOTE(h);
+    hdr *heap_end = h->is_region ? (hdr *)h->bump : h->segment_end;
+    heap_snap_hdr_t snap_hdr;
+    memcpy(snap_hdr.magic, HEAP_SNAP_MAGIC, sizeof(snap_hdr.magic));
+    snap_hdr.segment_size = h->segment_size;
+    snap_hdr.blocks = (h->is_region && heap_end < h->segment_end) ? 1 : 0;
+    snap_hdr.huge_blocks = 0;
+    for (hdr *block = h->segment_start; block < heap_end; block = skip_to_next_header(block)) {
+        snap_hdr.blocks += 1;
+    }
+    for (huge *hg = h->huge_list; hg != NULL; hg = hg->next) snap_hdr.huge_blocks += 1;
+
+    bool ok = fwrite(&snap_hdr, sizeof(snap_hdr), 1, fp) == 1;
+    for (hdr *block = h->segment_start; ok && block < heap_end; block = skip_to_next_header(block)) {
+        uint32_t word = snap_word((node *)block);
+        ok = fwrite(&word, sizeof(word), 1, fp) == 1;
+    }
+    if (ok && h->is_region && heap_end < h->segment_end) {
+        uint32_t word = (uint32_t)((char *)h->segment_end - (char *)heap_end) | HEAP_SNAP_FREE;
+        ok = fwrite(&word, sizeof(word), 1, fp) == 1;
+    }
+    for (huge *hg = h->huge_list; ok && hg != NULL; hg = hg->next) {
+        uint64_t map_size = hg->map_size;
+        ok = fwrite(&map_size, sizeof(map_size), 1, fp) == 1;
+    }
+    UNLOCK_HEAP(h);
+    return (fclose(fp) == 0) && ok;
+}
+
+/* Function: dump_heap
+ * -------------------------
+ * Parameters: NA
+ * 
+ * Returns: NA
+ *
+ * This function dumps the default heap instance.
+ */
+void dump_heap() {
+    heap_dump(&default_heap);
 }
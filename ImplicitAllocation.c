@@ -5,28 +5,108 @@
  *
  * This file represents an implementation of an
  * implicit heap allocator with header and minimum
- * payload sizes of 8. It utilzes a plethora of helper
+ * payload sizes of 4. It utilzes a plethora of helper
  * functions to simlify the code alongside my implementations 
  * of myinit,mymalloc, myfree, myrealloc, validate_heap, 
- * and dump_heap.
+ * and dump_heap. Each heap instance lives in a heap_t, and
+ * the my* functions are wrappers over a default instance.
+ *
+ * Headers are 4-byte payload sizes with the allocated flag in
+ * bit 0. Every payload is 4 more than a multiple of 8 and every
+ * header sits 4 bytes short of an 8-byte boundary, so payloads
+ * stay 8-aligned. This caps a heap at MAX_HEAP_SIZE.
+ *
+ * A malloc takes the first free block that fits, scanning from the
+ * segment start. A free merges the block with the free blocks
+ * after it, and a scan merges runs of free blocks it passes;
+ * without footers a block cannot find the one before it, so
+ * merging only ever looks forward. An occupancy summary at the end
+ * of the segment keeps, for each CHUNK_SIZE chunk, its first header
+ * and a bound on the largest free block whose header falls in it,
+ * so a scan jumps over chunks that are fully allocated or hold only
+ * smaller holes, and each GROUP_SIZE chunks share the largest of
+ * their bounds so it can jump over a whole group with one load. A
+ * free or merge raises the bounds and a scan that walks a whole
+ * chunk lowers them to what it saw. heap_set_scan
+ * switches a heap back to the original scan, which never merges,
+ * or to next fit, which resumes from a roving cursor at the block
+ * the last malloc handed out, with or without the summary. The
+ * -DNEXT_FIT build starts new heaps in next fit with the summary.
+ *
+ * Building with -DHARDENED ends every payload in a canary word and
+ * makes myfree and myrealloc abort on a pointer that is not a live
+ * block: a double free, an overrun into the next header or a
+ * pointer the heap never handed out.
  */
 #include "./allocator.h"
 #include "./debug_break.h"
+#include "./heap.h"
+#include <errno.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#ifdef HARDENED
+#include <stdlib.h>
+#include <sys/random.h>
+#include <time.h>
+#endif
+
+typedef uint32_t hdr;
 
-typedef size_t hdr;
+// what the occupancy summary keeps for one chunk of the segment
+typedef struct chunk
+{
+    uint32_t first; // offset of the chunk's first header, or NO_HEADER
+    uint32_t max_free; // no free block whose header is in the chunk has more payload
+} chunk_t;
 
-// relevant  globals
-static hdr *segment_start;
-static size_t segment_size;
-static hdr *segment_end;
-static size_t nused;
+// relevant fields of one heap instance
+struct heap
+{
+    hdr *segment_start;
+    size_t segment_size;
+    hdr *segment_end;
+    size_t nused;
+    heap_scan_t scan;
+    hdr *rover; // block the last malloc handed out, where the next one starts
+    chunk_t *chunks; // occupancy summary, just past segment_end
+    size_t nchunks;
+    uint32_t *groups; // largest bound of each GROUP_SIZE chunks, just past chunks
+#ifdef HARDENED
+    hdr canary_key; // mixed with a block's address into its canary
+#endif
+};
+
+// the instance behind myinit and the other my* functions
+static heap_t default_heap;
 
 // constant representing header size, min. payload size, and alignment
-#define HDR_SIZE 8
+#define HDR_SIZE 4
 #define MIN_BLOCK 16
 #define MAX_REQUEST_SIZE (1 << 30)
+#define MAX_HEAP_SIZE (((size_t)1 << 32) - ALIGNMENT) // headers are 32 bits
+#define DUMP_MAX_LINES 256 // blocks heap_dump prints before it points at heap_snapshot
+
+// constants used by the occupancy summary
+#define CHUNK_SHIFT 12
+#define CHUNK_SIZE ((size_t)1 << CHUNK_SHIFT)
+#define NO_HEADER UINT32_MAX // a chunk no header starts in, inside one large block
+#define GROUP_SHIFT 6
+#define GROUP_SIZE ((size_t)1 << GROUP_SHIFT) // chunks under one entry of groups
+
+// scan mode new heaps start with
+#ifdef NEXT_FIT
+#define DEFAULT_SCAN HEAP_SCAN_NEXT_SUMMARY
+#else
+#define DEFAULT_SCAN HEAP_SCAN_SUMMARY
+#endif
+
+// constants used by the -DHARDENED build
+#ifdef HARDENED
+#define CANARY_SIZE 4 // guard word that ends every payload
+#else
+#define CANARY_SIZE 0
+#endif
 
 /* Function: roundup (from bump.c)
  * -----------------
@@ -66,7 +146,7 @@ bool is_avail(hdr *hdr_ptr) {
  * Returns: NA
  *
  * This function will make a header's payload
- * "allocated" by turning on the LSB of the size_t
+ * "allocated" by turning on the LSB of the
  * hdr type.
  */
 void make_taken(hdr *hdr_ptr) {
@@ -83,7 +163,7 @@ void make_taken(hdr *hdr_ptr) {
  * Returns: NA
  *
  * This function will make a header's payload
- * "allocated" by turning on the LSB of the size_t
+ * "allocated" by turning on the LSB of the
  * hdr type while setting its payload size to 
  * the new size, or param2.
  */
@@ -92,6 +172,22 @@ void taken_and_new_sz(hdr *ptr, size_t needed_sz) {
 }
 
 
+/* Function: align_pl
+ * -------------------------
+ * Parameters:
+ *     sz - a size_t payload size being requested
+ * 
+ * Returns: size_t representation of the payload
+ *          a block needs for it
+ *
+ * This function rounds a payload up so that header and
+ * payload together are a multiple of ALIGNMENT, which keeps
+ * the payload of the next block aligned too.
+ */
+size_t align_pl(size_t sz) {
+    return roundup(sz + HDR_SIZE, ALIGNMENT) - HDR_SIZE;
+}
+
 /* Function: grab_pl
  * -------------------------
  * Parameters:
@@ -113,6 +209,7 @@ size_t grab_pl(hdr *hdr_ptr) {
 /* Function: set_pl_of_new
  * -------------------------
  * Parameters:
+ *     h - a pointer to the heap instance
  *     old_hdr - a pointer to the old header 
  *     new_hdr - a pointer to the new header
  *     amt_to_remove - a size_t representation
@@ -123,8 +220,8 @@ size_t grab_pl(hdr *hdr_ptr) {
  * This function takes in an old and new pointer and
  * sets the remainder of the size left to the new header.
  */
-void set_pl_of_new(hdr *old_hdr, hdr *new_hdr, size_t amt_to_remove) {
-    if (new_hdr == segment_end) return;
+void set_pl_of_new(heap_t *h, hdr *old_hdr, hdr *new_hdr, size_t amt_to_remove) {
+    if (new_hdr == h->segment_end) return;
     *new_hdr = *old_hdr - HDR_SIZE - amt_to_remove;
 }
 
@@ -176,6 +273,380 @@ void set_pl(hdr *hdr_ptr, size_t new_sz) {
     *hdr_ptr = new_sz;
 }
 
+/* Function: summary_mode
+ * -------------------------
+ * Parameters:
+ *     scan - a heap_scan_t mode
+ * 
+ * Returns: boolean representation of if a heap in that mode keeps
+ *          the occupancy summary
+ *
+ * This function tells the summary modes from the plain ones.
+ */
+bool summary_mode(heap_scan_t scan) {
+    return scan == HEAP_SCAN_SUMMARY || scan == HEAP_SCAN_NEXT_SUMMARY;
+}
+
+/* Function: chunk_of
+ * -------------------------
+ * Parameters:
+ *     h - a pointer to the heap instance
+ *     block - a pointer to a header of the segment, or its end
+ * 
+ * Returns: the size_t index of the chunk block lies in
+ *
+ * This function finds the occupancy summary entry of a block.
+ */
+size_t chunk_of(heap_t *h, hdr *block) {
+    return (size_t)((char *)block - (char *)h->segment_start) >> CHUNK_SHIFT;
+}
+
+/* Function: note_free
+ * -------------------------
+ * Parameters:
+ *     h - a pointer to the heap instance
+ *     block - a pointer to a header that became free or grew
+ * 
+ * Returns: NA
+ *
+ * This function raises the bound of block's chunk and of its group
+ * to cover it when the heap keeps a summary. Nothing lowers the
+ * bound when a block is taken; it only has to be an upper bound.
+ */
+void note_free(heap_t *h, hdr *block) {
+    if (!summary_mode(h->scan)) return;
+    size_t c = chunk_of(h, block);
+    if (grab_pl(block) > h->chunks[c].max_free) h->chunks[c].max_free = grab_pl(block);
+    if (grab_pl(block) > h->groups[c >> GROUP_SHIFT]) h->groups[c >> GROUP_SHIFT] = grab_pl(block);
+}
+
+/* Function: lower_bound
+ * -------------------------
+ * Parameters:
+ *     h - a pointer to the heap instance
+ *     c - the size_t index of a chunk a scan walked all of
+ *     seen - the size_t payload of the largest free block it saw
+ * 
+ * Returns: NA
+ *
+ * This function sets the bound of chunk c to what a scan saw and,
+ * if that lowered it, works its group's bound out again from the
+ * chunks under it.
+ */
+void lower_bound(heap_t *h, size_t c, size_t seen) {
+    if (seen >= h->chunks[c].max_free) return;
+    h->chunks[c].max_free = seen;
+    size_t first = c & ~(GROUP_SIZE - 1), bound = 0;
+    for (size_t i = first; i < first + GROUP_SIZE && i < h->nchunks; i++) {
+        if (h->chunks[i].max_free > bound) bound = h->chunks[i].max_free;
+    }
+    h->groups[c >> GROUP_SHIFT] = bound;
+}
+
+/* Function: add_header
+ * -------------------------
+ * Parameters:
+ *     h - a pointer to the heap instance
+ *     block - a pointer to a header a split just made
+ * 
+ * Returns: NA
+ *
+ * This function makes block the first header of its chunk if
+ * nothing before it in the chunk is.
+ */
+void add_header(heap_t *h, hdr *block) {
+    if (!summary_mode(h->scan)) return;
+    chunk_t *chunk = &h->chunks[chunk_of(h, block)];
+    uint32_t offset = (uint32_t)((char *)block - (char *)h->segment_start);
+    if (chunk->first == NO_HEADER || chunk->first > offset) chunk->first = offset;
+}
+
+/* Function: drop_header
+ * -------------------------
+ * Parameters:
+ *     h - a pointer to the heap instance
+ *     gone - a pointer to a header a merge just swallowed
+ *     next - a pointer to the header that now follows it, or the
+ *            segment end
+ * 
+ * Returns: NA
+ *
+ * This function moves the first header of gone's chunk on to next,
+ * or marks the chunk empty with nothing free in it if next is
+ * past it. Both ends are O(1), whatever the merged block spans;
+ * the group's bound is left high, which it is allowed to be.
+ */
+void drop_header(heap_t *h, hdr *gone, hdr *next) {
+    if (!summary_mode(h->scan)) return;
+    size_t c = chunk_of(h, gone);
+    if (h->chunks[c].first != (uint32_t)((char *)gone - (char *)h->segment_start)) return;
+    if (next < h->segment_end && chunk_of(h, next) == c) {
+        h->chunks[c].first = (uint32_t)((char *)next - (char *)h->segment_start);
+    } else {
+        h->chunks[c].first = NO_HEADER;
+        h->chunks[c].max_free = 0;
+    }
+}
+
+/* Function: build_summary
+ * -------------------------
+ * Parameters:
+ *     h - a pointer to the heap instance
+ * 
+ * Returns: NA
+ *
+ * This function rebuilds the occupancy summary from a walk of the
+ * heap, when a heap starts keeping it.
+ */
+void build_summary(heap_t *h) {
+    for (size_t c = 0; c < h->nchunks; c++) {
+        h->chunks[c].first = NO_HEADER;
+        h->chunks[c].max_free = 0;
+    }
+    for (size_t g = 0; g <= (h->nchunks - 1) >> GROUP_SHIFT; g++) {
+        h->groups[g] = 0;
+    }
+    for (hdr *block = h->segment_start; block < h->segment_end; block = skip_to_next_header(block)) {
+        add_header(h, block);
+        if (is_avail(block)) note_free(h, block);
+    }
+}
+
+/* Function: absorb_next
+ * -------------------------
+ * Parameters:
+ *     h - a pointer to the heap instance
+ *     block - a pointer to the header of a free block
+ * 
+ * Returns: boolean representation of if a block was merged in
+ *
+ * This function merges the block after block into it if that one
+ * is free too, moving the rover off the header that goes away.
+ */
+bool absorb_next(heap_t *h, hdr *block) {
+    hdr *next = skip_to_next_header(block);
+    if (next >= h->segment_end || !is_avail(next)) return false;
+
+    set_pl(block, grab_pl(block) + HDR_SIZE + grab_pl(next));
+    drop_header(h, next, skip_to_next_header(block));
+    note_free(h, block);
+    if (h->rover == next) h->rover = block;
+    return true;
+}
+
+/* Function: next_fit_chunk
+ * -------------------------
+ * Parameters:
+ *     h - a pointer to the heap instance
+ *     c - the size_t index of the first chunk to look at
+ *     needed_sz - the size_t payload the block needs
+ * 
+ * Returns: a hdr * to the first header of the first chunk from c
+ *          on that may hold a fit, or the segment end if none may
+ *
+ * This function is how a scan jumps over chunks, a whole group of
+ * them at a time when the group's bound is too small. A chunk with
+ * no header always has a bound of 0.
+ */
+hdr *next_fit_chunk(heap_t *h, size_t c, size_t needed_sz) {
+    while (c < h->nchunks) {
+        if (h->groups[c >> GROUP_SHIFT] < needed_sz) {
+            c = (c | (GROUP_SIZE - 1)) + 1;
+            continue;
+        }
+        if (h->chunks[c].max_free >= needed_sz) return (hdr *)((char *)h->segment_start + h->chunks[c].first);
+        c++;
+    }
+    return h->segment_end;
+}
+
+/* Function: find_fit
+ * -------------------------
+ * Parameters:
+ *     h - a pointer to the heap instance
+ *     from - a pointer to the header to start at
+ *     to - a pointer past the last header to look at
+ *     needed_sz - the size_t payload the block needs
+ * 
+ * Returns: a hdr * to the first free block from on that fits,
+ *          or NULL if there is none before to
+ *
+ * This function walks the heap header by header, merging each
+ * free block it reaches with the free blocks after it. With a
+ * summary it jumps over chunks whose bound is too small, and sets
+ * the bound of each chunk it walks from its first header to the
+ * next chunk to the largest free block it saw there.
+ */
+hdr *find_fit(heap_t *h, hdr *from, hdr *to, size_t needed_sz) {
+    bool summary = summary_mode(h->scan);
+    size_t cur = chunk_of(h, from); // chunk the walk is in
+    bool whole = summary && h->chunks[cur].first == (uint32_t)((char *)from - (char *)h->segment_start);
+    size_t seen = 0; // largest free payload seen in cur
+
+    hdr *block = from;
+    while (block < to) {
+        if (chunk_of(h, block) != cur) { // walked into the next chunk at its first header
+            if (whole) lower_bound(h, cur, seen);
+            cur = chunk_of(h, block);
+            whole = summary;
+            seen = 0;
+        }
+        if (summary && h->chunks[cur].max_free < needed_sz) {
+            whole = false;
+            block = next_fit_chunk(h, cur + 1, needed_sz);
+            continue;
+        }
+        if (is_avail(block)) {
+            if (h->scan != HEAP_SCAN_FIRST) {
+                while (absorb_next(h, block)) { }
+            }
+            if (grab_pl(block) >= needed_sz) return block;
+            if (grab_pl(block) > seen) seen = grab_pl(block);
+        }
+        block = skip_to_next_header(block);
+    }
+    if (whole && block >= h->segment_end) lower_bound(h, cur, seen);
+    return NULL;
+}
+
+#ifdef HARDENED
+/* Function: heap_corrupt
+ * -------------------------
+ * Parameters:
+ *     what - a description of the corruption found
+ *     ptr - the void * it was found at
+ * 
+ * Returns: does not return
+ *
+ * This function reports corruption found by the HARDENED build
+ * and aborts, since carrying on would hand the corruption on.
+ */
+void heap_corrupt(const char *what, void *ptr) {
+    fprintf(stderr, "heap corruption: %s (%p)\n", what, ptr);
+    abort();
+}
+
+/* Function: harden_secret
+ * -------------------------
+ * Parameters: NA
+ * 
+ * Returns: a random nonzero uint64_t
+ *
+ * This function draws a heap's canary key from the kernel,
+ * falling back to the clock and a stack address if getrandom is
+ * not available.
+ */
+uint64_t harden_secret(void) {
+    uint64_t secret = 0;
+    if (getrandom(&secret, sizeof(secret), GRND_NONBLOCK) != (ssize_t)sizeof(secret)) {
+        struct timespec t;
+        clock_gettime(CLOCK_MONOTONIC, &t);
+        secret = ((uint64_t)t.tv_nsec << 32) ^ (uint64_t)t.tv_sec ^ (uint64_t)(uintptr_t)&secret;
+        secret *= 0x9e3779b97f4a7c15ULL; // spread the bits over the whole word
+    }
+    return secret | 1;
+}
+
+/* Function: canary_at
+ * -------------------------
+ * Parameters:
+ *     h - a pointer to the heap instance
+ *     block - a pointer to an allocated block's header
+ *     canary - set to the hdr the block's canary should hold
+ * 
+ * Returns: a hdr * to the last word of the block's payload
+ *
+ * This function finds a block's canary and works out its value,
+ * the heap's key mixed with the block's address so a canary
+ * copied from another block does not pass.
+ */
+hdr *canary_at(heap_t *h, hdr *block, hdr *canary) {
+    *canary = h->canary_key ^ (hdr)((uintptr_t)block >> 3);
+    return (hdr *)((char *)block + grab_pl(block));
+}
+
+/* Function: harden_check
+ * -------------------------
+ * Parameters:
+ *     h - a pointer to the heap instance
+ *     ptr - a void * about to be freed or reallocated
+ * 
+ * Returns: NA
+ *
+ * This function aborts unless ptr is the payload of an allocated
+ * block of the segment whose size stays inside it and whose canary
+ * is intact.
+ */
+void harden_check(heap_t *h, void *ptr) {
+    if ((hdr *)ptr <= h->segment_start || (hdr *)ptr >= h->segment_end
+        || (size_t)ptr % ALIGNMENT != 0) {
+        heap_corrupt("free of a pointer the heap did not hand out", ptr);
+    }
+    hdr *block = (hdr *)((char *)ptr - HDR_SIZE);
+    if (is_avail(block)) heap_corrupt("double free", ptr);
+    if (grab_pl(block) < CANARY_SIZE || grab_pl(block) > (size_t)((char *)h->segment_end - (char *)ptr)) {
+        heap_corrupt("block header overwritten", ptr);
+    }
+    hdr canary;
+    if (*canary_at(h, block, &canary) != canary) heap_corrupt("write past the end of a block", ptr);
+}
+#endif
+
+/* Function: heap_init
+ * -------------------------
+ * Parameters:
+ *     h - a pointer to the heap instance to set up
+ *     heap_start - a pointer to a hdr type 
+ *     heap_size - a size_t representation
+ *                 of the payload size
+ * 
+ * Returns: boolean representation of if heap instantiation
+ *          was successful
+ *
+ * This function wipes a heap instance clean and starts fresh, 
+ * setting its fields, error checking, and makes the first header.
+ * The first header starts 4 bytes in so its payload is aligned,
+ * and anything past MAX_HEAP_SIZE is left unused.
+ */
+bool heap_init(heap_t *h, void *heap_start, size_t heap_size) {
+    if (heap_size <= HDR_SIZE + MIN_BLOCK || !heap_start ) { 
+        return false;
+    }
+    if (heap_size > MAX_HEAP_SIZE) heap_size = MAX_HEAP_SIZE;
+
+    // set fields about heap attributes, keeping room for the summary at the end
+    size_t avail = (heap_size - HDR_SIZE) & ~(size_t)(ALIGNMENT - 1);
+    h->nchunks = (avail >> CHUNK_SHIFT) + 1;
+    size_t ngroups = ((h->nchunks - 1) >> GROUP_SHIFT) + 1;
+    size_t summary_size = roundup(h->nchunks * sizeof(chunk_t) + ngroups * sizeof(uint32_t), ALIGNMENT);
+    if (avail <= summary_size + HDR_SIZE + MIN_BLOCK) {
+        return false;
+    }
+    h->segment_start = (hdr *)((char *)heap_start + HDR_SIZE);
+    h->segment_size = avail - summary_size;
+    h->segment_end = (hdr *)((char *)h->segment_start + h->segment_size); // grab heap start address and finds end of heap
+    h->chunks = (chunk_t *)h->segment_end;
+    h->groups = (uint32_t *)(h->chunks + h->nchunks);
+    h->nused = 0;
+
+    // validity checks about fields
+    if (h->segment_start == NULL || h->segment_end == NULL ||
+        (char *)h->segment_end - (char *)h->segment_start != h->segment_size) {
+    return false;
+    }
+
+#ifdef HARDENED
+    h->canary_key = (hdr)harden_secret();
+#endif
+
+    // set up initial header and set its payload size
+    *h->segment_start = h->segment_size - HDR_SIZE;
+    h->rover = h->segment_start;
+    h->scan = DEFAULT_SCAN;
+    build_summary(h);
+    return true;      
+}
+
 /* Function: myinit
  * -------------------------
  * Parameters:
@@ -183,11 +654,12 @@ void set_pl(hdr *hdr_ptr, size_t new_sz) {
  *     heap_size - a size_t representation
  *                 of the payload size
  * 
- * Returns: NA
+ * Returns: boolean representation of if heap instantiation
+ *          was successful
  *
  * This function is called by the test harness calls with every 
- * fresh script. It wipes the llocator's clean and start fresh, 
- * setting relevant globals, error checking, and makes the first header.
+ * fresh script. It wipes the default heap instance clean and
+ * starts fresh over the given segment.
  */
 bool myinit(void *heap_start, size_t heap_size) {
     /* This must be called by a client before making any allocation
@@ -197,108 +669,301 @@ bool myinit(void *heap_start, size_t heap_size) {
      * against a set of of test scripts, our test harness calls 
      * myinit before starting each new script.
      */
+    return heap_init(&default_heap, heap_start, heap_size);
+}
 
-    if (heap_size <= MIN_BLOCK || !heap_start ) { 
-        return false;
-    }
+/* Function: heap_create
+ * -------------------------
+ * Parameters:
+ *     start - a void * to the memory the new heap will own
+ *     size - the size_t number of bytes at start
+ * 
+ * Returns: a heap_t * to the new heap instance, or NULL if
+ *          the memory is too small to hold one
+ *
+ * This function makes an independent heap instance. Its
+ * bookkeeping sits at the front of the memory it is given
+ * and the rest becomes its segment.
+ */
+heap_t *heap_create(void *start, size_t size) {
+    size_t meta_size = roundup(sizeof(heap_t), ALIGNMENT);
+    if (!start || size <= meta_size + HDR_SIZE + MIN_BLOCK) return NULL;
 
-    // set globals about heap attributes
-    segment_start = (hdr *)heap_start;
-    segment_size = heap_size;
-    segment_end = (hdr *)((char *)heap_start + segment_size); // grab heap start address and finds end of heap
-    nused = 0;
+    heap_t *h = (heap_t *)start;
+    if (!heap_init(h, (char *)start + meta_size, size - meta_size)) return NULL;
+    return h;
+}
 
-    // validity checks about globals
-    if (segment_start == NULL || segment_end == NULL ||
-        (char *)segment_end - (char *)segment_start != segment_size) {
-    return false;
-    }
+/* Function: heap_destroy
+ * -------------------------
+ * Parameters:
+ *     h - a pointer to the heap instance to drop
+ * 
+ * Returns: NA
+ *
+ * This function drops a whole heap instance in O(1) without
+ * walking its blocks. Every pointer it handed out dies with it
+ * and its memory can be reused as soon as this returns.
+ */
+void heap_destroy(heap_t *h) {
+    if (!h || h == &default_heap) return;
+    memset(h, 0, sizeof(heap_t));
+}
 
-    // set up initial header and set its payload size
-    *segment_start = segment_size - HDR_SIZE;
-    return true;      
+/* Function: heap_set_scan
+ * -------------------------
+ * Parameters:
+ *     h - a pointer to the heap instance
+ *     scan - the heap_scan_t mode its mallocs use from now on
+ * 
+ * Returns: NA
+ *
+ * This function switches how a heap looks for free blocks. The
+ * summary is not kept up in the other modes, so switching to a
+ * summary mode from one of them rebuilds it with one walk of the
+ * heap.
+ */
+void heap_set_scan(heap_t *h, heap_scan_t scan) {
+    bool rebuild = (summary_mode(scan) && !summary_mode(h->scan));
+    h->scan = scan;
+    if (rebuild) build_summary(h);
 }
 
 
-/* Function: mymalloc
+/* Function: scan_for
+ * -------------------------
+ * Parameters:
+ *     h - a pointer to the heap instance
+ *     needed_sz - the size_t payload the block needs
+ * 
+ * Returns: a hdr * to a free block that fits, or NULL
+ *
+ * This function searches the heap, header by header, from the
+ * start (first fit), or under the next-fit modes from the rover to
+ * the end and then from the start back to the rover.
+ */
+hdr *scan_for(heap_t *h, size_t needed_sz) {
+    if (h->scan == HEAP_SCAN_FIRST || h->scan == HEAP_SCAN_SUMMARY) {
+        return find_fit(h, h->segment_start, h->segment_end, needed_sz);
+    }
+    hdr *stop = h->rover; // merging may move the rover, not where the wrap ends
+    hdr *looping_adr = find_fit(h, h->rover, h->segment_end, needed_sz);
+    if (looping_adr == NULL) looping_adr = find_fit(h, h->segment_start, stop, needed_sz);
+    return looping_adr;
+}
+
+/* Function: take_block
+ * -------------------------
+ * Parameters:
+ *     h - a pointer to the heap instance
+ *     looping_adr - a pointer to the header of a free block that fits
+ *     needed_sz - the size_t payload the block needs
+ * 
+ * Returns: the void * representation of the payload address
+ *
+ * This function marks a free block allocated and splits the
+ * remainder of the space into a new header if it can satisfy
+ * the minimum payload requirement.
+ */
+void *take_block(heap_t *h, hdr *looping_adr, size_t needed_sz) {
+    size_t rem  = grab_pl(looping_adr) - needed_sz;
+    if (rem < MIN_BLOCK) {
+        make_taken(looping_adr);
+
+    } else {
+        hdr *new_hdr = (hdr *)((char *)looping_adr + HDR_SIZE + needed_sz);
+        set_pl_of_new(h, looping_adr, new_hdr, needed_sz);
+        taken_and_new_sz(looping_adr, needed_sz);
+        add_header(h, new_hdr);
+        note_free(h, new_hdr);
+    }
+    h->rover = looping_adr;
+#ifdef HARDENED
+    hdr canary;
+    *canary_at(h, looping_adr, &canary) = canary;
+#endif
+    return address_of_pl(looping_adr);
+}
+
+/* Function: heap_malloc
  * -------------------------
  * Parameters: 
+ *     h - a pointer to the heap instance
  *     requested_sizez - a size_t representation
  *               of the payload size to be allocated
  * 
  * Returns: the void * representation of the payload address
  *
- * This function will search the heap, header by header, to find
- * a free block to fit the allocation request. It will split the 
- * remainder of the space into a new header if it can satisfy
- * the minimum payload requirement.
+ * This function will search the heap for a free block to fit
+ * the allocation request and take it, splitting off what the
+ * request does not need.
  */
-void *mymalloc(size_t requested_size) {
+void *heap_malloc(heap_t *h, size_t requested_size) {
  
-    if (requested_size <= 0 || requested_size > segment_size - HDR_SIZE || requested_size > MAX_REQUEST_SIZE) { // invalid request size
+    if (requested_size <= 0 || requested_size > h->segment_size - HDR_SIZE || requested_size > MAX_REQUEST_SIZE) { // invalid request size
         return NULL;
     }
 
-    // check properties of padded size
-    size_t needed_sz = roundup(requested_size, ALIGNMENT);
+    // check properties of padded size, leaving room for the canary
+    size_t needed_sz = align_pl(requested_size + CANARY_SIZE);
     if (needed_sz <= 0) { 
         return NULL;
     }
 
-    // now finds first fit for allocation if it exists
-    hdr *looping_adr = segment_start;
-    while ( looping_adr < segment_end) { // traverses implicit listblock-by-block
-        
-        if (is_avail(looping_adr) && grab_pl(looping_adr) >= needed_sz) {
-
-            size_t rem  = grab_pl(looping_adr) - needed_sz;
-
-            if (rem < MIN_BLOCK) {
-                make_taken(looping_adr);
-            
-            } else {
-                 hdr *new_hdr = (hdr *)((char *)looping_adr + HDR_SIZE + needed_sz);
-                 set_pl_of_new(looping_adr, new_hdr, needed_sz);
-                 taken_and_new_sz(looping_adr, needed_sz);
-                 
-             }
-             return address_of_pl(looping_adr);
-        }
-        else {
-            looping_adr = skip_to_next_header(looping_adr);
-        }
+    // now finds a fit for allocation if it exists
+    hdr *looping_adr = scan_for(h, needed_sz);
+    if (looping_adr == NULL) {
+        return NULL;
     }
-    return NULL;
+    return take_block(h, looping_adr, needed_sz);
 }
 
+/* Function: heap_aligned_alloc
+ * -------------------------
+ * Parameters: 
+ *     h - a pointer to the heap instance
+ *     align - the size_t power of two the payload must be aligned to
+ *     requested_size - a size_t representation
+ *               of the payload size to be allocated
+ * 
+ * Returns: the void * representation of the payload address, or
+ *          NULL if align is not a power of two or nothing fits
+ *
+ * This function serves alignments of ALIGNMENT or less as
+ * heap_malloc does. For larger ones it finds a free block with
+ * room for the payload at any alignment and splits the gap in
+ * front of the aligned payload off as a free block of its own,
+ * pushed one more step of align if it would be too small to be a
+ * block. The block is freed and reallocated like any other,
+ * though a realloc only keeps ALIGNMENT.
+ */
+void *heap_aligned_alloc(heap_t *h, size_t align, size_t requested_size) {
+    if (align == 0 || (align & (align - 1)) != 0) return NULL;
+    if (align <= ALIGNMENT) return heap_malloc(h, requested_size);
+    if (requested_size <= 0 || requested_size > MAX_REQUEST_SIZE || align > MAX_REQUEST_SIZE) return NULL;
 
-/* Function: myfree
+    size_t needed_sz = align_pl(requested_size + CANARY_SIZE);
+    if (needed_sz + align + MIN_BLOCK > h->segment_size) return NULL;
+    hdr *block = scan_for(h, needed_sz + align + MIN_BLOCK);
+    if (block == NULL) return NULL;
+
+    char *payload = address_of_pl(block);
+    char *aligned = (char *)roundup((size_t)payload, align);
+    while (aligned != payload && (size_t)(aligned - payload) < MIN_BLOCK) {
+        aligned += align;
+    }
+
+    // the leading gap stays behind as a free block
+    if (aligned != payload) {
+        hdr *taken = (hdr *)(aligned - HDR_SIZE);
+        set_pl(taken, grab_pl(block) - (aligned - payload));
+        set_pl(block, aligned - payload - HDR_SIZE);
+        add_header(h, taken);
+        block = taken;
+    }
+    return take_block(h, block, needed_sz);
+}
+
+/* Function: free_block
  * -------------------------
  * Parameters:
+ *     h - a pointer to the heap instance
  *     ptr - a void * to the payload
  *           to be freed
  * 
  * Returns: NA
  *
  * This function will make a header's payload
- * "free" by turning off the LSB of the size_t
- * hdr type. It also updates the global representing
- * how much heap has been used. 
+ * "free" by turning off the LSB of the
+ * hdr type. Outside HEAP_SCAN_FIRST it then merges the
+ * free blocks that follow into it. Callers in the HARDENED
+ * build have checked the block already.
  */
-void myfree(void *ptr) {
-    if ((hdr *)ptr > segment_end || (hdr *)ptr < segment_start || !ptr) {
+void free_block(heap_t *h, void *ptr) {
+    if ((hdr *)ptr >= h->segment_end || (hdr *)ptr < h->segment_start || !ptr) {
         return;
     }
     else { // turn off last bit
         hdr *temp_ptr = (hdr *)((char *)ptr - HDR_SIZE); // go back to header
-        *temp_ptr &= ~(0x7); // turn off last bit 
+        *temp_ptr &= ~(0x1); // turn off last bit 
+        if (h->scan != HEAP_SCAN_FIRST) {
+            while (absorb_next(h, temp_ptr)) { }
+            note_free(h, temp_ptr);
+        }
     }
 }
 
+/* Function: heap_free
+ * -------------------------
+ * Parameters:
+ *     h - a pointer to the heap instance
+ *     ptr - a void * to the payload
+ *           to be freed
+ * 
+ * Returns: NA
+ *
+ * This function frees a block of the heap instance. The
+ * HARDENED build checks the block first.
+ */
+void heap_free(heap_t *h, void *ptr) {
+#ifdef HARDENED
+    if (ptr) harden_check(h, ptr);
+#endif
+    free_block(h, ptr);
+}
+
 
-/* Function: myrealloc
+/* Function: heap_free_sized
  * -------------------------
  * Parameters:
+ *     h - a pointer to the heap instance
+ *     ptr - a void * to the payload
+ *           to be freed
+ *     size - the size_t last asked for with ptr
+ * 
+ * Returns: NA
+ *
+ * This function frees a block like heap_free, which reads the size
+ * from the header anyway. The HARDENED build checks the block and
+ * that the size fits in it.
+ */
+void heap_free_sized(heap_t *h, void *ptr, size_t size) {
+#ifdef HARDENED
+    if (ptr) {
+        harden_check(h, ptr);
+        if (size > grab_pl((hdr *)((char *)ptr - HDR_SIZE)) - CANARY_SIZE) {
+            heap_corrupt("sized free larger than the block", ptr);
+        }
+    }
+#else
+    (void)size;
+#endif
+    free_block(h, ptr);
+}
+
+/* Function: heap_usable_size
+ * -------------------------
+ * Parameters:
+ *     h - a pointer to the heap instance
+ *     ptr - a void * to a payload
+ * 
+ * Returns: the size_t number of bytes the payload can hold, or 0
+ *          for NULL or a pointer that is not an allocated payload
+ *
+ * This function reads the payload size from the header, less the
+ * canary, so a caller can use the room rounding gave it.
+ */
+size_t heap_usable_size(heap_t *h, void *ptr) {
+    if (!ptr || (hdr *)ptr <= h->segment_start || (hdr *)ptr >= h->segment_end) return 0;
+    hdr *block = (hdr *)((char *)ptr - HDR_SIZE);
+    if (is_avail(block)) return 0;
+    return grab_pl(block) - CANARY_SIZE;
+}
+
+/* Function: heap_realloc
+ * -------------------------
+ * Parameters:
+ *     h - a pointer to the heap instance
  *     old_ptr - a pointer to the space to reallocate 
  *     new_size - a size_t representation
  *                 of the payload size
@@ -310,41 +975,197 @@ void myfree(void *ptr) {
  * after some error checking, there is just a new
  * malloc call, and memmove is utilized.
  */
-void *myrealloc(void *old_ptr, size_t new_size) {
+void *heap_realloc(heap_t *h, void *old_ptr, size_t new_size) {
+#ifdef HARDENED
+    if (old_ptr) harden_check(h, old_ptr);
+#endif
 
     if (!old_ptr && new_size == 0) { //edge case from man pages
-        myfree(old_ptr);
-        return mymalloc(new_size);
+        free_block(h, old_ptr);
+        return heap_malloc(h, new_size);
         
-    } else if  (new_size <= 0 || new_size > segment_size - HDR_SIZE) {
-        myfree(old_ptr);
-        return mymalloc(new_size); // malformed requests
+    } else if  (new_size <= 0) {
+        free_block(h, old_ptr);
+        return heap_malloc(h, new_size); // malformed requests
+    } else if (new_size > h->segment_size - HDR_SIZE) {
+        return NULL; // can never fit, and the old block stays as it was
     }
 
-    void *new_request = mymalloc(new_size);
+    void *new_request = heap_malloc(h, new_size);
 
     if (new_request != 0) { // make sure new request was successful
         if (old_ptr != 0) {
-           memmove(new_request, old_ptr, new_size);
+           size_t old_size = grab_pl((hdr *)((char *)old_ptr - HDR_SIZE)) - CANARY_SIZE;
+           memmove(new_request, old_ptr, new_size < old_size ? new_size : old_size); // no reading past the old block
            }
-        myfree(old_ptr);
+        free_block(h, old_ptr);
     }
     return new_request;
 }
 
+/* Function: mymalloc
+ * -------------------------
+ * Parameters: 
+ *     requested_size - a size_t representation
+ *               of the payload size to be allocated
+ * 
+ * Returns: the void * representation of the payload address
+ *
+ * This function allocates from the default heap instance.
+ */
+void *mymalloc(size_t requested_size) {
+    return heap_malloc(&default_heap, requested_size);
+}
+
+/* Function: myaligned_alloc
+ * -------------------------
+ * Parameters: 
+ *     align - the size_t power of two the payload must be aligned to
+ *     requested_size - a size_t representation
+ *               of the payload size to be allocated
+ * 
+ * Returns: the void * representation of the payload address
+ *
+ * This function allocates an aligned block from the default heap instance.
+ */
+void *myaligned_alloc(size_t align, size_t requested_size) {
+    return heap_aligned_alloc(&default_heap, align, requested_size);
+}
+
+/* Function: myposix_memalign
+ * -------------------------
+ * Parameters: 
+ *     out - set to the payload address on success
+ *     align - the size_t alignment, a power of two and a multiple
+ *             of sizeof(void *)
+ *     requested_size - a size_t representation
+ *               of the payload size to be allocated
+ * 
+ * Returns: 0, EINVAL for a bad alignment or ENOMEM if nothing fits
+ *
+ * This function allocates an aligned block from the default heap
+ * instance the way posix_memalign does, leaving out as it was on
+ * failure. A size of 0 gives NULL.
+ */
+int myposix_memalign(void **out, size_t align, size_t requested_size) {
+    if (align < sizeof(void *) || (align & (align - 1)) != 0) return EINVAL;
+    if (requested_size == 0) {
+        *out = NULL; // which posix_memalign allows, and myfree takes
+        return 0;
+    }
+    void *payload = heap_aligned_alloc(&default_heap, align, requested_size);
+    if (payload == NULL) return ENOMEM;
+    *out = payload;
+    return 0;
+}
 
-/* Function: validate_heap
+/* Function: myfree
  * -------------------------
- * Parameters: NA
+ * Parameters:
+ *     ptr - a void * to the payload
+ *           to be freed
+ * 
+ * Returns: NA
+ *
+ * This function frees a block of the default heap instance.
+ */
+void myfree(void *ptr) {
+    heap_free(&default_heap, ptr);
+}
+
+/* Function: myfree_sized
+ * -------------------------
+ * Parameters:
+ *     ptr - a void * to the payload
+ *           to be freed
+ *     size - the size_t last asked for with ptr
+ * 
+ * Returns: NA
+ *
+ * This function frees a block of known size of the default heap instance.
+ */
+void myfree_sized(void *ptr, size_t size) {
+    heap_free_sized(&default_heap, ptr, size);
+}
+
+/* Function: my_usable_size
+ * -------------------------
+ * Parameters:
+ *     ptr - a void * to a payload
+ * 
+ * Returns: the size_t number of bytes the payload can hold
+ *
+ * This function reports the room in a block of the default heap instance.
+ */
+size_t my_usable_size(void *ptr) {
+    return heap_usable_size(&default_heap, ptr);
+}
+
+/* Function: myrealloc
+ * -------------------------
+ * Parameters:
+ *     old_ptr - a pointer to the space to reallocate 
+ *     new_size - a size_t representation
+ *                 of the payload size
+ * 
+ * Returns: a void * to the payload of the new memory
+ *
+ * This function reallocates a block of the default heap instance.
+ */
+void *myrealloc(void *old_ptr, size_t new_size) {
+    return heap_realloc(&default_heap, old_ptr, new_size);
+}
+
+
+/* Function: summary_ok
+ * -------------------------
+ * Parameters:
+ *     h - a pointer to the heap instance
+ * 
+ * Returns: boolean representation of if the occupancy summary
+ *          matches the blocks
+ *
+ * This function checks the first header each chunk records, that
+ * chunks without one have a bound of 0, that no free block is
+ * larger than the bound of its chunk and that no chunk's bound is
+ * larger than its group's.
+ */
+bool summary_ok(heap_t *h) {
+    size_t next_chunk = 0; // chunks before it have been checked
+    for (hdr *block = h->segment_start; block < h->segment_end; block = skip_to_next_header(block)) {
+        size_t c = chunk_of(h, block);
+        if (is_avail(block) && grab_pl(block) > h->chunks[c].max_free) return false;
+        if (c < next_chunk) continue;
+        for (; next_chunk < c; next_chunk++) {
+            if (h->chunks[next_chunk].first != NO_HEADER || h->chunks[next_chunk].max_free != 0) return false;
+        }
+        if (h->chunks[c].first != (uint32_t)((char *)block - (char *)h->segment_start)) return false;
+        next_chunk = c + 1;
+    }
+    for (; next_chunk < h->nchunks; next_chunk++) {
+        if (h->chunks[next_chunk].first != NO_HEADER || h->chunks[next_chunk].max_free != 0) return false;
+    }
+    for (size_t c = 0; c < h->nchunks; c++) {
+        if (h->chunks[c].max_free > h->groups[c >> GROUP_SHIFT]) return false;
+    }
+    return true;
+}
+
+/* Function: heap_validate
+ * -------------------------
+ * Parameters:
+ *     h - a pointer to the heap instance
  * 
  * Returns: boolean representation of 
  *         if heap validation was successful
  *
  * This function does some routine heap checks, such
  * as confirming normal heap initialization, amount of 
- * used space, free blocks, minimum payload, etc.
+ * used space, free blocks, minimum payload, etc. It also
+ * checks that the rover is on a header and that the
+ * occupancy summary, when kept, matches the blocks.
  */
-bool validate_heap() {
+bool heap_validate(heap_t *h) {
     /* check your internal structures!
      * Return true if all is ok, or false otherwise.
      * This function is called periodically by the test
@@ -352,8 +1173,9 @@ bool validate_heap() {
      * You can also use the breakpoint() function to stop
      * in the debugger - e.g. if (something_is_wrong) breakpoint();
      */
-    hdr *start_of_heap = segment_start;
+    hdr *start_of_heap = h->segment_start;
     size_t total = 0; // will include framentation purely amt that is not usable
+    bool rover_seen = false;
    
     if (start_of_heap == NULL) {
         printf("Incorrect Initialization of Heap");
@@ -362,16 +1184,27 @@ bool validate_heap() {
     }
 
     // check payload size and free status throughout heap
-    while (start_of_heap < segment_end) {
+    while (start_of_heap < h->segment_end) {
         total += grab_pl(start_of_heap) + HDR_SIZE;
-        if ( (*start_of_heap & ~0x1) < HDR_SIZE) {
+        if (start_of_heap == h->rover) rover_seen = true;
+        if (grab_pl(start_of_heap) < HDR_SIZE || grab_pl(start_of_heap) != align_pl(grab_pl(start_of_heap))) {
             breakpoint();
-            printf("Incorrect payload size, must be at least 8 in this design");
+            printf("Incorrect payload size, must be at least 4 and end on an 8-byte boundary in this design");
         }
         start_of_heap = skip_to_next_header(start_of_heap);  
     }
 
-    if (total == segment_size) { 
+    if (!rover_seen) {
+        printf("Rover is not on a block header");
+        breakpoint();
+        return false;
+    }
+    if (summary_mode(h->scan) && !summary_ok(h)) {
+        printf("Occupancy summary does not match the blocks");
+        breakpoint();
+        return false;
+    }
+    if (total == h->segment_size) { 
         return true;
     }
     
@@ -382,25 +1215,92 @@ bool validate_heap() {
 }
 
 
-/* Function: dump_heap
+/* Function: validate_heap
  * -------------------------
  * Parameters: NA
  * 
+ * Returns: boolean representation of 
+ *         if heap validation was successful
+ *
+ * This function validates the default heap instance.
+ */
+bool validate_heap() {
+    return heap_validate(&default_heap);
+}
+
+
+/* Function: heap_dump
+ * -------------------------
+ * Parameters:
+ *     h - a pointer to the heap instance
+ * 
  * Returns: NA
  *
  * This function will create a meaningful
  * visualization of the heap used for debugging. 
  * It prints relevant information like free status, 
- * payload size, and the pointer. 
+ * payload size, and the pointer. Past DUMP_MAX_LINES
+ * blocks it only counts what is left, as heap_snapshot
+ * and heap_analyze are the tools for a large heap.
  */
-void dump_heap() {
-    hdr *heap_start = segment_start;
+void heap_dump(heap_t *h) {
+    hdr *heap_start = h->segment_start;
+    size_t lines = 0;
 
-    while (heap_start < segment_end) {
-        printf("|------------------------|---------------------------|---------------------------|\n");
-        printf("|Free(1 = yes): %d        | Payload Size: %ld         | Pointer: %p          \n", is_avail(heap_start), grab_pl(heap_start), heap_start);
-        printf("|------------------------|---------------------------|---------------------------|\n");
+    while (heap_start < h->segment_end) {
+        if (lines++ < DUMP_MAX_LINES) {
+            printf("|------------------------|---------------------------|---------------------------|\n");
+            printf("|Free(1 = yes): %d        | Payload Size: %ld         | Pointer: %p          \n", is_avail(heap_start), grab_pl(heap_start), (void *)heap_start);
+            printf("|------------------------|---------------------------|---------------------------|\n");
+        }
         heap_start = skip_to_next_header(heap_start);
     }
+    if (lines > DUMP_MAX_LINES) {
+        printf("... %zu more blocks, see heap_snapshot\n", lines - DUMP_MAX_LINES);
+    }
+}
+
+/* Function: heap_snapshot
+ * -------------------------
+ * Parameters:
+ *     h - a pointer to the heap instance
+ *     path - the file name to write the snapshot to
+ * 
+ * Returns: boolean representation of if the snapshot was written
+ *
+ * This function writes every block of the segment in the
+ * format heap.h describes, 4 bytes a block.
+ */
+bool heap_snapshot(heap_t *h, const char *path) {
+    FILE *fp = fopen(path, "wb");
+    if (fp == NULL) return false;
+
+    heap_snap_hdr_t snap_hdr;
+    memcpy(snap_hdr.magic, HEAP_SNAP_MAGIC, sizeof(snap_hdr.magic));
+    snap_hdr.segment_size = h->segment_size;
+    snap_hdr.blocks = 0;
+    snap_hdr.huge_blocks = 0;
+    for (hdr *block = h->segment_start; block < h->segment_end; block = skip_to_next_header(block)) {
+        snap_hdr.blocks += 1;
+    }
+
+    bool ok = fwrite(&snap_hdr, sizeof(snap_hdr), 1, fp) == 1;
+    for (hdr *block = h->segment_start; ok && block < h->segment_end; block = skip_to_next_header(block)) {
+        uint32_t word = (uint32_t)(grab_pl(block) + HDR_SIZE)
+                        | (is_avail(block) ? HEAP_SNAP_FREE : HEAP_SNAP_USED);
+        ok = fwrite(&word, sizeof(word), 1, fp) == 1;
+    }
+    return (fclose(fp) == 0) && ok;
+}
 
+/* Function: dump_heap
+ * -------------------------
+ * Parameters: NA
+ * 
+ * Returns: NA
+ *
+ * This function dumps the default heap instance.
+ */
+void dump_heap() {
+    heap_dump(&default_heap);
 }
@@ -0,0 +1,1008 @@
+/* File: tlsf.c
+ * -------------------------
+ *
+ * This file represents an implementation of a two-level
+ * segregated fit (TLSF) heap allocator with a header size of
+ * 4 and a minimum payload size of 12, built as a third
+ * allocator next to implicit.c and explicit.c on the same
+ * myinit segment. Every mymalloc, myfree and in-place myrealloc
+ * runs in a bounded number of steps, whatever the heap holds.
+ *
+ * Free blocks sit in one list per (first level, second level)
+ * class. The first level is the power of two of the payload
+ * size, and each power of two is split into SL_INDEX_COUNT
+ * equal second-level classes. Payloads below SMALL_BLOCK_SIZE
+ * get one exact class per multiple of 8 instead. A bitmap of
+ * non-empty first levels and one of non-empty second levels per
+ * first level let mymalloc find a free block with two
+ * find-first-set instructions. A request is rounded up to the
+ * next class boundary first, so the first block of the class it
+ * lands in always fits and no list is ever walked.
+ *
+ * Blocks use the same layout as the explicit allocator: a 4-byte
+ * header with the block size and the allocated and prev-free
+ * flags, a footer in every free block, and free-list links that
+ * are 32-bit offsets from the start of the heap. myfree merges
+ * with both neighbours at once through the prev-free bit and
+ * the footer.
+ */
+#include "./allocator.h"
+#include "./debug_break.h"
+#include "./heap.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+typedef uint32_t hdr;
+typedef uint32_t link_t; // offset of a free block from heap_start, 0 for none
+
+// struct definition for casting of a block
+typedef struct node
+{
+    hdr b_hdr;
+    link_t prev;
+    link_t next;
+} node;
+
+// constants used for arithmitic
+#define HDR_SIZE 4
+#define MIN_BLOCK_SIZE 16
+#define MIN_PL 12
+#define PREV_FREE_BIT 0x2
+#define MAX_REQUEST_SIZE (1 << 30)
+#define MAX_HEAP_SIZE (((size_t)1 << 32) - ALIGNMENT) // links and headers are 32 bits
+
+// constants used for the two-level index
+#define SL_INDEX_LOG2 4
+#define SL_INDEX_COUNT (1 << SL_INDEX_LOG2)
+#define FL_INDEX_SHIFT (SL_INDEX_LOG2 + 3) // 3 = log2 of ALIGNMENT
+#define SMALL_BLOCK_SIZE (1 << FL_INDEX_SHIFT)
+#define FL_INDEX_MAX 32
+#define FL_INDEX_COUNT (FL_INDEX_MAX - FL_INDEX_SHIFT + 1)
+
+// relevant fields of one heap instance
+struct heap
+{
+    hdr *segment_start;
+    size_t segment_size;
+    hdr *segment_end;
+    void *heap_start; // where links are measured from
+    unsigned int fl_map; // bit set = first level has a free block
+    unsigned int sl_map[FL_INDEX_COUNT];
+    node *free_lists[FL_INDEX_COUNT][SL_INDEX_COUNT];
+    size_t blocks_in_free;
+};
+
+// the instance behind myinit and the other my* functions
+static heap_t default_heap;
+
+/* Function: roundup (from bump.c)
+ * -----------------
+ * Parameters:
+ *     sz - a size_t value to be rounded to the next multiple of n
+ *     n   - the size_t that param 1 will be rounded to
+ *
+ * Returns: NA
+ *
+ * This function rounds up the given number to the given multiple, which
+ * must be a power of 2, and returns the result.  (you saw this code in lab1!).
+ */
+size_t roundup(size_t sz, size_t mult) {
+    return (sz + mult - 1) & ~(mult - 1);
+}
+
+/* Function: align_pl
+ * -----------------
+ * Parameters:
+ *     sz - a size_t payload size being requested
+ *
+ * Returns: the size_t payload size a block needs for it
+ *
+ * This function rounds a payload up so that header and payload
+ * together are a multiple of ALIGNMENT, which keeps the payload of
+ * the next block aligned too.
+ */
+size_t align_pl(size_t sz) {
+    return roundup(sz + HDR_SIZE, ALIGNMENT) - HDR_SIZE;
+}
+
+/* Function: is_avail
+ * -----------------
+ * Parameters:
+ *     hdr_ptr - a node pointer to the block to be checked
+ *
+ * Returns: boolean representation of if the block is able to
+ *         to be allocated or not
+ *
+ * This function tells if a block is allocated or not.
+ */
+bool is_avail(node *hdr_ptr) {
+    return !((hdr_ptr->b_hdr) & 0x1);
+}
+
+/* Function: grab_pl
+ * -----------------
+ * Parameters:
+ *     hdr_node - a pointer to a node to be checked
+ *
+ * Returns: a size_t representation of the payload size
+ *
+ * This function masks the flag bits off the block size in the
+ * header and takes away the header itself.
+ */
+size_t grab_pl(node *hdr_node) {
+    size_t block_size = (hdr_node->b_hdr) & ~0x7;
+    return block_size ? block_size - HDR_SIZE : 0;
+}
+
+/* Function: skip_to_next_header
+ * -----------------
+ * Parameters:
+ *     hdr_ptr - a pointer to a node
+ *
+ * Returns: a node * to the next header
+ *
+ * This function skips the current header and its payload
+ * through pointer arithmetic.
+ */
+node *skip_to_next_header(node *hdr_ptr) {
+    return (node *)((char *)hdr_ptr + grab_pl(hdr_ptr) + HDR_SIZE);
+}
+
+/* Function: back_to_hdr
+ * -----------------
+ * Parameters:
+ *     ptr - a void * to a payload
+ *
+ * Returns: a node * to its header
+ *
+ * This function returns the address of the header
+ * after being given the payload address.
+ */
+node *back_to_hdr(void *ptr) {
+    return (node *)((char *)ptr - HDR_SIZE);
+}
+
+/* Function: to_pl
+ * -----------------
+ * Parameters:
+ *     hdr_ptr - a pointer to a header node
+ *
+ * Returns: a void * to the payload
+ *
+ * This function returns the address of the payload
+ * after being given a header address.
+ */
+void *to_pl(node *hdr_ptr) {
+    return (char *)hdr_ptr + HDR_SIZE;
+}
+
+/* Function: set_pl
+ * -----------------
+ * Parameters:
+ *     node_hdr - a pointer to a node
+ *     size - size_t representation of the payload to be set
+ *
+ * Returns: NA
+ *
+ * This function sets a header's payload, stored as the block
+ * size, keeping the header's prev-free bit and clearing the
+ * allocated bit.
+ */
+void set_pl(node *node_hdr, size_t size) {
+    node_hdr->b_hdr = ((size + HDR_SIZE) & ~0x7) | (node_hdr->b_hdr & PREV_FREE_BIT);
+}
+
+/* Function: make_hdr
+ * -----------------
+ * Parameters:
+ *     node_hdr - a pointer to where a new header is written
+ *     size - size_t representation of the payload to be set
+ *
+ * Returns: NA
+ *
+ * This function writes a brand new free header for a block split
+ * off the end of an allocated block, so its prev-free bit starts
+ * cleared.
+ */
+void make_hdr(node *node_hdr, size_t size) {
+    node_hdr->b_hdr = ((size + HDR_SIZE) & ~0x7);
+}
+
+/* Function: make_taken
+ * -----------------
+ * Parameters:
+ *     node_hdr - a pointer to a node
+ *
+ * Returns: NA
+ *
+ * This function sets a header's LSB to 1, making the
+ * header allocated.
+ */
+void make_taken(node *node_hdr) {
+    node_hdr->b_hdr |= 0x1;
+}
+
+/* Function: make_free
+ * -----------------
+ * Parameters:
+ *     node_hdr - a pointer to a node
+ *
+ * Returns: NA
+ *
+ * This function clears a header's LSB through bitmasking.
+ */
+void make_free(node *node_hdr) {
+    node_hdr->b_hdr &= ~0x1;
+}
+
+/* Function: write_footer
+ * -----------------
+ * Parameters:
+ *     node_hdr - a pointer to a free node
+ *
+ * Returns: NA
+ *
+ * This function copies a free block's payload size into
+ * its last 4 bytes so the block to its right can find it.
+ */
+void write_footer(node *node_hdr) {
+    *(hdr *)((char *)node_hdr + grab_pl(node_hdr)) = grab_pl(node_hdr);
+}
+
+/* Function: mark_right_neighbor
+ * -----------------
+ * Parameters:
+ *     h - a pointer to the heap instance
+ *     node_hdr - a pointer to a node whose status just changed
+ *     now_free - whether node_hdr is now free
+ *
+ * Returns: NA
+ *
+ * This function updates the prev-free bit in the header to the
+ * right of node_hdr, if there is one before h->segment_end.
+ */
+void mark_right_neighbor(heap_t *h, node *node_hdr, bool now_free) {
+    node *right_hdr = skip_to_next_header(node_hdr);
+    if ((hdr *)right_hdr >= h->segment_end) return;
+    if (now_free) {
+        right_hdr->b_hdr |= PREV_FREE_BIT;
+    } else {
+        right_hdr->b_hdr &= ~PREV_FREE_BIT;
+    }
+}
+
+/* Function: link_node
+ * -----------------
+ * Parameters:
+ *     h - a pointer to the heap instance
+ *     off - a link_t read from a free block
+ *
+ * Returns: a node * to the block the link names, or NULL
+ *
+ * This function turns a free-list link back into a pointer. The
+ * first header sits HDR_SIZE past h->heap_start, so no block is
+ * ever at offset 0.
+ */
+node *link_node(heap_t *h, link_t off) {
+    if (off == 0) return NULL;
+    return (node *)((char *)h->heap_start + off);
+}
+
+/* Function: node_link
+ * -----------------
+ * Parameters:
+ *     h - a pointer to the heap instance
+ *     n - a node * to a free block, or NULL
+ *
+ * Returns: the link_t that names the block in a free list
+ *
+ * This function is the inverse of link_node.
+ */
+link_t node_link(heap_t *h, node *n) {
+    if (n == NULL) return 0;
+    return (link_t)((char *)n - (char *)h->heap_start);
+}
+
+/* Function: mapping_insert
+ * -----------------
+ * Parameters:
+ *     pl - the size_t payload size of a free block
+ *     fl - set to its first-level index
+ *     sl - set to its second-level index
+ *
+ * Returns: NA
+ *
+ * This function finds the class a free block is filed under. Below
+ * SMALL_BLOCK_SIZE every multiple of 8 has a class of its own, and
+ * above it the first level is the highest set bit and the second
+ * level the next SL_INDEX_LOG2 bits.
+ */
+void mapping_insert(size_t pl, size_t *fl, size_t *sl) {
+    if (pl < SMALL_BLOCK_SIZE) {
+        *fl = 0;
+        *sl = pl / (SMALL_BLOCK_SIZE / SL_INDEX_COUNT);
+        return;
+    }
+    size_t top = 63 - __builtin_clzl(pl);
+    *sl = (pl >> (top - SL_INDEX_LOG2)) ^ SL_INDEX_COUNT;
+    *fl = top - FL_INDEX_SHIFT + 1;
+}
+
+/* Function: mapping_search
+ * -----------------
+ * Parameters:
+ *     needed_sz - the size_t rounded payload size being requested
+ *     fl - set to the first-level index to search from
+ *     sl - set to the second-level index to search from
+ *
+ * Returns: NA
+ *
+ * This function rounds a request up to the start of the next
+ * class before mapping it, so every block filed at or above the
+ * result is large enough and the lists never need a walk. This
+ * trades at most 1/SL_INDEX_COUNT of the request for O(1).
+ */
+void mapping_search(size_t needed_sz, size_t *fl, size_t *sl) {
+    if (needed_sz >= SMALL_BLOCK_SIZE) {
+        size_t top = 63 - __builtin_clzl(needed_sz);
+        needed_sz += (1UL << (top - SL_INDEX_LOG2)) - 1;
+    }
+    mapping_insert(needed_sz, fl, sl);
+}
+
+/* Function: find_fit
+ * -----------------
+ * Parameters:
+ *    h - a pointer to the heap instance
+ *    needed_sz - the size_t rounded payload size being requested
+ *
+ * Returns: a node * to a free block that can hold the request,
+ *          or NULL if there is none
+ *
+ * This function looks for a non-empty class at or above the
+ * request's in its own first level, and otherwise in the first
+ * non-empty larger first level, with one find-first-set each.
+ */
+node *find_fit(heap_t *h, size_t needed_sz) {
+    size_t fl, sl;
+    mapping_search(needed_sz, &fl, &sl);
+    if (fl >= FL_INDEX_COUNT) return NULL;
+
+    unsigned int sl_map = h->sl_map[fl] & (~0U << sl);
+    if (sl_map == 0) {
+        unsigned int fl_map = h->fl_map & (~0U << (fl + 1));
+        if (fl_map == 0) return NULL;
+        fl = __builtin_ctz(fl_map);
+        sl_map = h->sl_map[fl];
+    }
+    return h->free_lists[fl][__builtin_ctz(sl_map)];
+}
+
+/* Function: insert_free
+ * -----------------
+ * Parameters:
+ *    h - a pointer to the heap instance
+ *    new_node - a pointer to a free node
+ *
+ * Returns: NA
+ *
+ * This function puts a free block first in its class's list and
+ * sets the class's bits in both bitmaps.
+ */
+void insert_free(heap_t *h, node *new_node) {
+    size_t fl, sl;
+    mapping_insert(grab_pl(new_node), &fl, &sl);
+    node *first = h->free_lists[fl][sl];
+
+    new_node->prev = 0;
+    new_node->next = node_link(h, first);
+    if (first != NULL) first->prev = node_link(h, new_node);
+    h->free_lists[fl][sl] = new_node;
+    h->fl_map |= 1U << fl;
+    h->sl_map[fl] |= 1U << sl;
+    h->blocks_in_free += 1;
+}
+
+/* Function: remove_free
+ * -----------------
+ * Parameters:
+ *    h - a pointer to the heap instance
+ *    old_node - a pointer to a node in a free list
+ *
+ * Returns: NA
+ *
+ * This function unlinks a free block from its class's list and
+ * clears the class's bits once the list is empty. The block's
+ * payload must not have changed since it was inserted, as the
+ * payload picks the class.
+ */
+void remove_free(heap_t *h, node *old_node) {
+    size_t fl, sl;
+    mapping_insert(grab_pl(old_node), &fl, &sl);
+    node *prev = link_node(h, old_node->prev);
+    node *next = link_node(h, old_node->next);
+
+    if (prev != NULL) {
+        prev->next = old_node->next;
+    } else {
+        h->free_lists[fl][sl] = next;
+    }
+    if (next != NULL) next->prev = old_node->prev;
+
+    if (h->free_lists[fl][sl] == NULL) {
+        h->sl_map[fl] &= ~(1U << sl);
+        if (h->sl_map[fl] == 0) h->fl_map &= ~(1U << fl);
+    }
+    h->blocks_in_free -= 1;
+}
+
+/* Function: coalesce
+ * -----------------
+ * Parameters:
+ *    h - a pointer to the heap instance
+ *    node_hdr - a pointer to a free node that is in no list
+ *
+ * Returns: a node * to the header of the coalesced block
+ *
+ * This function merges a free block with a free right neighbour,
+ * found through skip_to_next_header, and a free left neighbour,
+ * found through the prev-free bit and the left footer. The merged
+ * block gets a footer and its right neighbour's prev-free bit is
+ * set. Callers insert the returned header afterwards.
+ */
+node *coalesce(heap_t *h, node *node_hdr) {
+    node *right_hdr = skip_to_next_header(node_hdr);
+    if ((hdr *)right_hdr < h->segment_end && is_avail(right_hdr)) {
+        remove_free(h, right_hdr);
+        node_hdr->b_hdr += grab_pl(right_hdr) + HDR_SIZE;
+    }
+
+    // the left payload size sits in the footer just before us
+    if (node_hdr->b_hdr & PREV_FREE_BIT) {
+        node *left_hdr = (node *)((char *)node_hdr - HDR_SIZE - *((hdr *)node_hdr - 1));
+        remove_free(h, left_hdr);
+        left_hdr->b_hdr += grab_pl(node_hdr) + HDR_SIZE;
+        node_hdr = left_hdr;
+    }
+
+    make_free(node_hdr);
+    write_footer(node_hdr);
+    mark_right_neighbor(h, node_hdr, true);
+    return node_hdr;
+}
+
+/* Function: split_off
+ * -----------------
+ * Parameters:
+ *    h - a pointer to the heap instance
+ *    block - a node * to a block in no list
+ *    needed_sz - the size_t payload size it keeps
+ *
+ * Returns: NA
+ *
+ * This function makes block allocated with needed_sz bytes and
+ * gives whatever follows back as a free block, merged with a free
+ * right neighbour, if that can hold a block.
+ */
+void split_off(heap_t *h, node *block, size_t needed_sz) {
+    size_t pl = grab_pl(block);
+    if (pl >= needed_sz + MIN_BLOCK_SIZE) {
+        set_pl(block, needed_sz);
+        make_taken(block);
+        node *rest = skip_to_next_header(block);
+        make_hdr(rest, pl - needed_sz - HDR_SIZE);
+        insert_free(h, coalesce(h, rest));
+        return;
+    }
+    make_taken(block);
+    mark_right_neighbor(h, block, false);
+}
+
+/* Function: heap_init
+ * -------------------------
+ * Parameters:
+ *     h - a pointer to the heap instance to set up
+ *     heap_start - a void * to the beginning of heap
+ *     heap_size - a size_t representation
+ *                 of the payload size
+ *
+ * Returns: boolean representation of if heap instantiation
+ *          was successful
+ *
+ * This function wipes a heap instance clean and starts fresh,
+ * setting its fields, error checking, and making the first block
+ * the only free one. The first header starts 4 bytes in so its
+ * payload is aligned, and anything past MAX_HEAP_SIZE is left
+ * unused.
+ */
+bool heap_init(heap_t *h, void *heap_start, size_t heap_size) {
+    if (heap_size <= HDR_SIZE + MIN_BLOCK_SIZE || !heap_start) return false;
+    if (heap_size > MAX_HEAP_SIZE) heap_size = MAX_HEAP_SIZE;
+
+    memset(h, 0, sizeof(heap_t));
+    h->heap_start = heap_start;
+    h->segment_start = (hdr *)((char *)heap_start + HDR_SIZE);
+    h->segment_size = (heap_size - HDR_SIZE) & ~(size_t)(ALIGNMENT - 1);
+    h->segment_end = (hdr *)((char *)h->segment_start + h->segment_size);
+
+    node *first = (node *)h->segment_start;
+    make_hdr(first, h->segment_size - HDR_SIZE);
+    write_footer(first);
+    insert_free(h, first);
+    return true;
+}
+
+/* Function: myinit
+ * -------------------------
+ * Parameters:
+ *     heap_start - a void * to the beginning of heap
+ *     heap_size - a size_t representation
+ *                 of the payload size
+ *
+ * Returns: boolean representation of if heap instantiation
+ *          was successful
+ *
+ * This function is called by the test harness calls with every
+ * fresh script. It wipes the default heap instance clean and
+ * starts fresh over the given segment.
+ */
+bool myinit(void *heap_start, size_t heap_size) {
+    return heap_init(&default_heap, heap_start, heap_size);
+}
+
+/* Function: heap_create
+ * -------------------------
+ * Parameters:
+ *     start - a void * to the memory the new heap will own
+ *     size - the size_t number of bytes at start
+ *
+ * Returns: a heap_t * to the new heap instance, or NULL if
+ *          the memory is too small to hold one
+ *
+ * This function makes an independent heap instance. Its
+ * bookkeeping sits at the front of the memory it is given
+ * and the rest becomes its segment.
+ */
+heap_t *heap_create(void *start, size_t size) {
+    size_t meta_size = roundup(sizeof(heap_t), ALIGNMENT);
+    if (!start || size <= meta_size + HDR_SIZE + MIN_BLOCK_SIZE) return NULL;
+
+    heap_t *h = (heap_t *)start;
+    if (!heap_init(h, (char *)start + meta_size, size - meta_size)) return NULL;
+    return h;
+}
+
+/* Function: heap_destroy
+ * -------------------------
+ * Parameters:
+ *     h - a pointer to the heap instance to drop
+ *
+ * Returns: NA
+ *
+ * This function drops a whole heap instance in O(1) without
+ * walking its blocks. Every pointer it handed out dies with it
+ * and its memory can be reused as soon as this returns.
+ */
+void heap_destroy(heap_t *h) {
+    if (!h || h == &default_heap) return;
+    memset(h, 0, sizeof(heap_t));
+}
+
+/* Function: heap_malloc
+ * -------------------------
+ * Parameters:
+ *     h - a pointer to the heap instance
+ *     requested_size - a size_t representation
+ *               of the payload size to be allocated
+ *
+ * Returns: the void * representation of the payload address
+ *
+ * This function takes the first block of the smallest non-empty
+ * class that is sure to fit the request and splits off what the
+ * request does not need, all in constant time.
+ */
+void *heap_malloc(heap_t *h, size_t requested_size) {
+    if (requested_size <= 0 || requested_size > h->segment_size
+        || requested_size > MAX_REQUEST_SIZE) return NULL;
+
+    size_t needed_sz = align_pl(requested_size);
+    if (needed_sz < MIN_PL) {
+        needed_sz = MIN_PL; // make sure minimum payload is 12
+    }
+    node *block = find_fit(h, needed_sz);
+    if (block == NULL) return NULL;
+
+    remove_free(h, block);
+    split_off(h, block, needed_sz);
+    return to_pl(block);
+}
+
+/* Function: heap_free
+ * -------------------------
+ * Parameters:
+ *     h - a pointer to the heap instance
+ *     ptr - a void * to the payload
+ *           to be freed
+ *
+ * Returns: NA
+ *
+ * This function frees a block, merges it with its free
+ * neighbours and files the result under its class, all in
+ * constant time. Pointers outside the segment and blocks that
+ * are already free are ignored.
+ */
+void heap_free(heap_t *h, void *ptr) {
+    if (!ptr || (hdr *)ptr <= h->segment_start || (hdr *)ptr >= h->segment_end) return;
+    node *block = back_to_hdr(ptr);
+    if (is_avail(block)) return;
+
+    make_free(block);
+    insert_free(h, coalesce(h, block));
+}
+
+/* Function: heap_free_sized
+ * -------------------------
+ * Parameters:
+ *     h - a pointer to the heap instance
+ *     ptr - a void * to the payload
+ *           to be freed
+ *     size - the size_t last asked for with ptr
+ *
+ * Returns: NA
+ *
+ * This function frees a block like heap_free. Coalescing reads the
+ * header anyway, so the size is not needed.
+ */
+void heap_free_sized(heap_t *h, void *ptr, size_t size) {
+    (void)size;
+    heap_free(h, ptr);
+}
+
+/* Function: heap_usable_size
+ * -------------------------
+ * Parameters:
+ *     h - a pointer to the heap instance
+ *     ptr - a void * to a payload
+ *
+ * Returns: the size_t number of bytes the payload can hold, or 0
+ *          for NULL or a pointer that is not an allocated payload
+ *
+ * This function reads the payload size from the header.
+ */
+size_t heap_usable_size(heap_t *h, void *ptr) {
+    if (!ptr || (hdr *)ptr <= h->segment_start || (hdr *)ptr >= h->segment_end) return 0;
+    node *block = back_to_hdr(ptr);
+    return is_avail(block) ? 0 : grab_pl(block);
+}
+
+/* Function: heap_realloc
+ * -------------------------
+ * Parameters:
+ *     h - a pointer to the heap instance
+ *     old_ptr - a pointer to the space to reallocate
+ *     new_size - a size_t representation
+ *                 of the payload size
+ *
+ * Returns: a void * to the payload of the new memory
+ *
+ * This function shrinks a block in place, or grows it in place
+ * into a free right neighbour, in constant time. Otherwise the
+ * block moves: a new one is allocated, the payload copied, and
+ * the old one freed. If no new block can be had the old one stays
+ * as it was.
+ */
+void *heap_realloc(heap_t *h, void *old_ptr, size_t new_size) {
+    if (!old_ptr) return heap_malloc(h, new_size);
+    if (new_size <= 0) {
+        heap_free(h, old_ptr);
+        return NULL; // a zero size frees the block
+    } else if (new_size > MAX_REQUEST_SIZE) {
+        return NULL; // can never fit, and the old block stays as it was
+    }
+
+    node *start = back_to_hdr(old_ptr);
+    size_t prev_size = grab_pl(start);
+    size_t new_s = align_pl(new_size);
+    if (new_s < MIN_PL) {
+        new_s = MIN_PL;
+    }
+
+    node *right = skip_to_next_header(start);
+    size_t room = prev_size;
+    if ((hdr *)right < h->segment_end && is_avail(right)) {
+        room += HDR_SIZE + grab_pl(right);
+    }
+    if (new_s <= prev_size) {
+        split_off(h, start, new_s);
+        return old_ptr;
+    }
+    if (new_s <= room) {
+        remove_free(h, right);
+        set_pl(start, room);
+        split_off(h, start, new_s);
+        return old_ptr;
+    }
+
+    void *new_request = heap_malloc(h, new_size);
+    if (new_request == NULL) return NULL;
+    memcpy(new_request, old_ptr, prev_size);
+    heap_free(h, old_ptr);
+    return new_request;
+}
+
+/* Function: mymalloc
+ * -------------------------
+ * Parameters:
+ *     requested_size - a size_t representation
+ *               of the payload size to be allocated
+ *
+ * Returns: the void * representation of the payload address
+ *
+ * This function allocates from the default heap instance.
+ */
+void *mymalloc(size_t requested_size) {
+    return heap_malloc(&default_heap, requested_size);
+}
+
+/* Function: myfree
+ * -------------------------
+ * Parameters:
+ *     ptr - a void * to the payload
+ *           to be freed
+ *
+ * Returns: NA
+ *
+ * This function frees a block of the default heap instance.
+ */
+void myfree(void *ptr) {
+    heap_free(&default_heap, ptr);
+}
+
+/* Function: myfree_sized
+ * -------------------------
+ * Parameters:
+ *     ptr - a void * to the payload
+ *           to be freed
+ *     size - the size_t last asked for with ptr
+ *
+ * Returns: NA
+ *
+ * This function frees a block of known size of the default heap instance.
+ */
+void myfree_sized(void *ptr, size_t size) {
+    heap_free_sized(&default_heap, ptr, size);
+}
+
+/* Function: my_usable_size
+ * -------------------------
+ * Parameters:
+ *     ptr - a void * to a payload
+ *
+ * Returns: the size_t number of bytes the payload can hold
+ *
+ * This function reports the room in a block of the default heap instance.
+ */
+size_t my_usable_size(void *ptr) {
+    return heap_usable_size(&default_heap, ptr);
+}
+
+/* Function: myrealloc
+ * -------------------------
+ * Parameters:
+ *     old_ptr - a pointer to the space to reallocate
+ *     new_size - a size_t representation
+ *                 of the payload size
+ *
+ * Returns: a void * to the payload of the new memory
+ *
+ * This function reallocates a block of the default heap instance.
+ */
+void *myrealloc(void *old_ptr, size_t new_size) {
+    return heap_realloc(&default_heap, old_ptr, new_size);
+}
+
+/* Function: heap_validate
+ * -------------------------
+ * Parameters:
+ *     h - a pointer to the heap instance
+ *
+ * Returns: boolean representation of
+ *         if heap validation was successful
+ *
+ * This function walks every block, checking payload sizes,
+ * footers, prev-free bits and that no two free blocks touch, then
+ * walks every free list, checking that its blocks are free, filed
+ * under the right class and linked both ways, and that the
+ * bitmaps show exactly the non-empty lists.
+ */
+bool heap_validate(heap_t *h) {
+    node *block = (node *)h->segment_start;
+    size_t total = 0;
+    size_t free_blocks = 0;
+
+    if (block == NULL) {
+        printf("Broken Initialization of Heap");
+        breakpoint();
+        return false;
+    }
+
+    while ((hdr *)block < h->segment_end) {
+        size_t pl = grab_pl(block);
+        total += pl + HDR_SIZE;
+        if (pl != align_pl(pl) || pl < MIN_PL) {
+            printf("Your payload does not end on an 8-byte boundary or is less than 12");
+            breakpoint();
+            return false;
+        }
+
+        // free blocks need a matching footer and no free neighbours
+        node *right = skip_to_next_header(block);
+        bool right_free = (hdr *)right < h->segment_end && is_avail(right);
+        if (is_avail(block)) {
+            free_blocks += 1;
+            if (*(hdr *)((char *)block + pl) != pl || right_free) {
+                printf("Your free block has a bad footer or was not coalesced");
+                breakpoint();
+                return false;
+            }
+        }
+        if ((hdr *)right < h->segment_end
+            && is_avail(block) != ((right->b_hdr & PREV_FREE_BIT) != 0)) {
+            printf("Your prev-free bit does not match the block to its left");
+            breakpoint();
+            return false;
+        }
+        block = right;
+    }
+    if (total != h->segment_size) {
+        printf("Your blocks do not add up to the segment");
+        breakpoint();
+        return false;
+    }
+
+    size_t listed = 0;
+    for (size_t fl = 0; fl < FL_INDEX_COUNT; fl++) {
+        if (((h->fl_map >> fl) & 0x1) != (h->sl_map[fl] != 0)) {
+            printf("Your first-level bitmap does not match level %zu", fl);
+            breakpoint();
+            return false;
+        }
+        for (size_t sl = 0; sl < SL_INDEX_COUNT; sl++) {
+            node *looping_adr = h->free_lists[fl][sl];
+            if ((looping_adr != NULL) != ((h->sl_map[fl] >> sl) & 0x1)) {
+                printf("Your second-level bitmap does not match class %zu/%zu", fl, sl);
+                breakpoint();
+                return false;
+            }
+            while (looping_adr != NULL) {
+                listed += 1;
+                size_t fl_at, sl_at;
+                if ((hdr *)looping_adr < h->segment_start || (hdr *)looping_adr >= h->segment_end) {
+                    printf("Your free list links outside of the heap");
+                    breakpoint();
+                    return false;
+                }
+                mapping_insert(grab_pl(looping_adr), &fl_at, &sl_at);
+                if (!is_avail(looping_adr) || fl_at != fl || sl_at != sl) {
+                    printf("Something in your free list is not free or in the wrong class");
+                    breakpoint();
+                    return false;
+                }
+                node *next = link_node(h, looping_adr->next);
+                if (next != NULL && link_node(h, next->prev) != looping_adr) {
+                    printf("Your free list prev and next links do not match");
+                    breakpoint();
+                    return false;
+                }
+                looping_adr = next;
+            }
+        }
+    }
+    if (listed != free_blocks || listed != h->blocks_in_free) {
+        printf("Your free lists do not hold every free block");
+        breakpoint();
+        return false;
+    }
+    return true;
+}
+
+/* Function: validate_heap
+ * -------------------------
+ * Parameters: NA
+ *
+ * Returns: boolean representation of
+ *         if heap validation was successful
+ *
+ * This function validates the default heap instance.
+ */
+bool validate_heap() {
+    return heap_validate(&default_heap);
+}
+
+/* Function: heap_dump
+ * -------------------------
+ * Parameters:
+ *     h - a pointer to the heap instance
+ *
+ * Returns: NA
+ *
+ * This function will create a meaningful visualization of the
+ * heap used for debugging. It prints the free status, payload
+ * size and pointer of every block, then every non-empty class
+ * with its blocks' links.
+ */
+void heap_dump(heap_t *h) {
+    printf("Heap Visualization:\n");
+    printf("----------------------------------------------\n");
+    for (node *block = (node *)h->segment_start; (hdr *)block < h->segment_end;
+         block = skip_to_next_header(block)) {
+        printf("%s", is_avail(block) ? "  FREE   " : "ALLOCATED");
+        printf(",  Payload Size: %zu,  Hdr Pointer: %p \n", grab_pl(block), (void *)block);
+    }
+
+    printf("----------------------------------------------\n");
+    printf("\n");
+    printf("Free List Visualization: %zu (Amount in Free List) \n", h->blocks_in_free);
+    printf("First-Level Bitmap: %#x \n", h->fl_map);
+    printf("----------------------------------------------\n");
+    for (size_t fl = 0; fl < FL_INDEX_COUNT; fl++) {
+        for (size_t sl = 0; sl < SL_INDEX_COUNT; sl++) {
+            node *looping_adr = h->free_lists[fl][sl];
+            if (looping_adr == NULL) continue;
+            printf("Class %zu/%zu:\n", fl, sl);
+            while (looping_adr != NULL) {
+                printf("FREE,  Payload Size: %zu,  Hdr Pointer: %p,  Link: %u,  Prev Link: %u,  Next Link: %u \n",
+                       grab_pl(looping_adr), (void *)looping_adr, node_link(h, looping_adr),
+                       looping_adr->prev, looping_adr->next);
+                looping_adr = link_node(h, looping_adr->next);
+            }
+        }
+    }
+}
+
+/* Function: heap_snapshot
+ * -------------------------
+ * Parameters:
+ *     h - a pointer to the heap instance
+ *     path - the file name to write the snapshot to
+ *
+ * Returns: boolean representation of if the snapshot was written
+ *
+ * This function writes every block of the segment in the format
+ * heap.h describes, 4 bytes a block.
+ */
+bool heap_snapshot(heap_t *h, const char *path) {
+    FILE *fp = fopen(path, "wb");
+    if (fp == NULL) return false;
+
+    heap_snap_hdr_t snap_hdr;
+    memcpy(snap_hdr.magic, HEAP_SNAP_MAGIC, sizeof(snap_hdr.magic));
+    snap_hdr.segment_size = h->segment_size;
+    snap_hdr.blocks = 0;
+    snap_hdr.huge_blocks = 0;
+    for (node *block = (node *)h->segment_start; (hdr *)block < h->segment_end;
+         block = skip_to_next_header(block)) {
+        snap_hdr.blocks += 1;
+    }
+
+    bool ok = fwrite(&snap_hdr, sizeof(snap_hdr), 1, fp) == 1;
+    for (node *block = (node *)h->segment_start; ok && (hdr *)block < h->segment_end;
+         block = skip_to_next_header(block)) {
+        uint32_t word = (block->b_hdr & ~0x7) | (is_avail(block) ? HEAP_SNAP_FREE : HEAP_SNAP_USED);
+        ok = fwrite(&word, sizeof(word), 1, fp) == 1;
+    }
+    return (fclose(fp) == 0) && ok;
+}
+
+/* Function: dump_heap
+ * -------------------------
+ * Parameters: NA
+ *
+ * Returns: NA
+ *
+ * This function dumps the default heap instance.
+ */
+void dump_heap() {
+    heap_dump(&default_heap);
+}
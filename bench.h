@@ -0,0 +1,58 @@
+/* File: bench.h
+ * -------------------------
+ *
+ * This file holds the clock and random number helpers the bench_*.c
+ * programs share. Each benchmark is its own program, so they are
+ * defined here as static inline functions rather than in a library.
+ */
+#ifndef _BENCH_H
+#define _BENCH_H
+
+#include <stdint.h>
+#include <time.h>
+
+/* Function: now_ns
+ * -------------------------
+ * Parameters: NA
+ *
+ * Returns: a long long of the monotonic clock in nanoseconds
+ *
+ * This function reads the clock used for every timing.
+ */
+static inline long long now_ns(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1000000000LL + t.tv_nsec;
+}
+
+/* Function: now_ms
+ * -------------------------
+ * Parameters: NA
+ *
+ * Returns: a double of the monotonic clock in milliseconds
+ *
+ * This function reads the same clock for timings long enough that
+ * milliseconds read better.
+ */
+static inline double now_ms(void) {
+    return now_ns() / 1e6;
+}
+
+/* Function: next_random
+ * -------------------------
+ * Parameters:
+ *     state - a pointer to the generator state, nonzero
+ *
+ * Returns: the next uint64_t of an xorshift sequence
+ *
+ * This function gives every run of a benchmark the same sequence
+ * without depending on the libc generator.
+ */
+static inline uint64_t next_random(uint64_t *state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+#endif
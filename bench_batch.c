@@ -0,0 +1,130 @@
+/* File: bench_batch.c
+ * -------------------------
+ *
+ * This file compares mymalloc_batch and myfree_batch with the same
+ * work done one call at a time. For each size it runs rounds that
+ * allocate a batch of same-sized objects, as a message handler
+ * would for one message, and then free them all in a shuffled
+ * order. Every round is done once as a loop of mymalloc and myfree
+ * and once as one mymalloc_batch and one myfree_batch call, on a
+ * fresh heap each time. A fifth of the heap stays live between the
+ * rounds, scattered, so the batches meet a heap that has holes.
+ *
+ * For each size it prints the time per object of the mallocs and
+ * of the frees both ways, and how much faster the batch calls are.
+ *
+ * Build: gcc -O2 -o bench_batch bench_batch.c ExplicitAllocation.c
+ * Usage: ./bench_batch [batch] [rounds]   (default 256, 20000)
+ */
+#include "./allocator.h"
+#include "./heap.h"
+#include "./bench.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#define HEAP_SIZE ((size_t)256 << 20)
+#define BACKGROUND 20000 // live blocks kept around the batches
+
+static const size_t sizes[] = {32, 128, 512, 2048};
+#define NUM_SIZES (sizeof(sizes) / sizeof(sizes[0]))
+
+/* Function: run_size
+ * -------------------------
+ * Parameters:
+ *     mem - the segment to give myinit
+ *     size - the size_t payload size of every object
+ *     batch - the size_t objects per round
+ *     rounds - the size_t rounds to run
+ *     use_batch - whether to use the batch calls
+ *     malloc_ns - set to the nanoseconds spent allocating
+ *     free_ns - set to the nanoseconds spent freeing
+ *
+ * Returns: boolean representation of if every allocation succeeded
+ *          and the heap validated afterwards
+ *
+ * This function sets up the background on a fresh heap and times
+ * the rounds one way.
+ */
+bool run_size(char *mem, size_t size, size_t batch, size_t rounds, bool use_batch,
+              long long *malloc_ns, long long *free_ns) {
+    void **objects = malloc(batch * sizeof(void *));
+    void **background = malloc(BACKGROUND * sizeof(void *));
+    if (objects == NULL || background == NULL || !myinit(mem, HEAP_SIZE)) return false;
+
+    // a scattered live set: allocate 5 blocks of mixed sizes, keep 1
+    uint64_t state = 0x9e3779b97f4a7c15ULL;
+    for (size_t i = 0; i < BACKGROUND; i++) {
+        void *gone[4];
+        for (size_t j = 0; j < 4; j++) gone[j] = mymalloc(16 + next_random(&state) % 1024);
+        background[i] = mymalloc(16 + next_random(&state) % 1024);
+        for (size_t j = 0; j < 4; j++) myfree(gone[j]);
+    }
+
+    bool ok = true;
+    *malloc_ns = 0;
+    *free_ns = 0;
+    for (size_t round = 0; round < rounds && ok; round++) {
+        long long start = now_ns();
+        if (use_batch) {
+            ok = mymalloc_batch(size, batch, objects) == batch;
+        } else {
+            for (size_t i = 0; i < batch; i++) {
+                objects[i] = mymalloc(size);
+                ok = ok && objects[i] != NULL;
+            }
+        }
+        *malloc_ns += now_ns() - start;
+
+        // the objects are done with in no particular order
+        for (size_t i = batch - 1; i > 0; i--) {
+            size_t j = next_random(&state) % (i + 1);
+            void *tmp = objects[i];
+            objects[i] = objects[j];
+            objects[j] = tmp;
+        }
+        start = now_ns();
+        if (use_batch) {
+            myfree_batch(objects, batch);
+        } else {
+            for (size_t i = 0; i < batch; i++) myfree(objects[i]);
+        }
+        *free_ns += now_ns() - start;
+    }
+
+    for (size_t i = 0; i < BACKGROUND; i++) myfree(background[i]);
+    ok = ok && validate_heap();
+    free(objects);
+    free(background);
+    return ok;
+}
+
+int main(int argc, char *argv[]) {
+    size_t batch = argc > 1 ? strtoul(argv[1], NULL, 10) : 256;
+    size_t rounds = argc > 2 ? strtoul(argv[2], NULL, 10) : 20000;
+    char *mem = malloc(HEAP_SIZE);
+    if (batch == 0 || rounds == 0 || mem == NULL) {
+        printf("usage: %s [batch] [rounds]\n", argv[0]);
+        return 1;
+    }
+
+    printf("%zu objects a batch, %zu rounds, %d live blocks around them\n", batch, rounds, BACKGROUND);
+    printf("%6s  %12s %12s  %12s %12s  %7s %7s\n", "size", "malloc loop", "malloc batch",
+           "free loop", "free batch", "malloc", "free");
+    int failures = 0;
+    for (size_t s = 0; s < NUM_SIZES; s++) {
+        long long loop_malloc, loop_free, batch_malloc, batch_free;
+        if (!run_size(mem, sizes[s], batch, rounds, false, &loop_malloc, &loop_free)
+            || !run_size(mem, sizes[s], batch, rounds, true, &batch_malloc, &batch_free)) {
+            printf("%6zu  run failed\n", sizes[s]);
+            failures += 1;
+            continue;
+        }
+        double objects = (double)batch * rounds;
+        printf("%6zu  %9.1f ns %9.1f ns  %9.1f ns %9.1f ns  %6.2fx %6.2fx\n", sizes[s],
+               loop_malloc / objects, batch_malloc / objects, loop_free / objects,
+               batch_free / objects, (double)loop_malloc / batch_malloc,
+               (double)loop_free / batch_free);
+    }
+    free(mem);
+    return failures != 0;
+}
@@ -0,0 +1,103 @@
+/* File: bench_bins.c
+ * -------------------------
+ *
+ * This file measures how the cost of mymalloc grows with the number
+ * of free blocks in the heap. For each count it builds a heap on a
+ * fresh myinit segment where free fragments too small for the
+ * requests sit among free blocks that fit, with every free block
+ * pinned between allocated ones so nothing merges, and the rest of
+ * the segment used up so no request can carve the tail. It then
+ * times a run of mallocs that each take one of the blocks that fit.
+ *
+ * A single free list walks the fragments on every one of those
+ * mallocs, so its time per malloc grows with the count. The
+ * segregated bins find a fitting block in a bounded number of
+ * steps. It only uses allocator.h, so it builds against the
+ * baseline allocator too, for the numbers before the bins:
+ *     git show 7aa7e28:ExplicitAllocation.c > explicit_before.c
+ *     gcc -O2 -o bench_bins_before bench_bins.c explicit_before.c
+ *
+ * Build: gcc -O2 -o bench_bins bench_bins.c ExplicitAllocation.c
+ * Usage: ./bench_bins [heap_mb]   (default 64)
+ */
+#include "./allocator.h"
+#include "./bench.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#define WANTED 2000 // free blocks the timed mallocs take
+#define WANTED_SIZE 512
+#define FRAGMENT_SIZE 72 // above the slab sizes, so fragments are blocks
+#define FILL_SIZE 4096
+
+static const size_t fragment_counts[] = {10, 100, 1000, 10000, 100000};
+#define NUM_COUNTS (sizeof(fragment_counts) / sizeof(fragment_counts[0]))
+
+/* Function: run_count
+ * -------------------------
+ * Parameters:
+ *     mem - the segment to give myinit
+ *     heap_size - the size_t bytes of mem
+ *     fragments - the size_t free fragments to leave in the heap
+ *     malloc_ns - set to the nanoseconds the timed mallocs took
+ *
+ * Returns: boolean representation of if the heap could be laid out
+ *          and every timed malloc succeeded
+ *
+ * This function lays out a fresh heap with fragments small free
+ * blocks and WANTED free blocks that fit, then times WANTED mallocs.
+ */
+bool run_count(char *mem, size_t heap_size, size_t fragments, long long *malloc_ns) {
+    void **wanted = malloc(WANTED * sizeof(void *));
+    void **pieces = malloc(2 * fragments * sizeof(void *));
+    if (wanted == NULL || pieces == NULL || !myinit(mem, heap_size)) return false;
+
+    // each block that fits and each fragment is followed by a pin
+    bool ok = true;
+    for (size_t i = 0; i < WANTED; i++) {
+        wanted[i] = mymalloc(WANTED_SIZE);
+        ok = ok && wanted[i] != NULL && mymalloc(FRAGMENT_SIZE) != NULL;
+    }
+    for (size_t i = 0; i < 2 * fragments; i++) {
+        pieces[i] = mymalloc(FRAGMENT_SIZE + (i % 4) * 8);
+        ok = ok && pieces[i] != NULL;
+    }
+    while (mymalloc(FILL_SIZE) != NULL) { }
+    while (mymalloc(FRAGMENT_SIZE) != NULL) { }
+
+    // the fragments are freed last, so a LIFO list has them in front
+    for (size_t i = 0; ok && i < WANTED; i++) myfree(wanted[i]);
+    for (size_t i = 0; ok && i < 2 * fragments; i += 2) myfree(pieces[i]);
+
+    long long start = now_ns();
+    for (size_t i = 0; ok && i < WANTED; i++) {
+        ok = mymalloc(WANTED_SIZE) != NULL;
+    }
+    *malloc_ns = now_ns() - start;
+    free(wanted);
+    free(pieces);
+    return ok;
+}
+
+int main(int argc, char *argv[]) {
+    size_t heap_size = (argc > 1 ? strtoul(argv[1], NULL, 10) : 64) << 20;
+    char *mem = malloc(heap_size);
+    if (heap_size == 0 || mem == NULL) {
+        printf("usage: %s [heap_mb]\n", argv[0]);
+        return 1;
+    }
+
+    printf("%12s  %14s\n", "free blocks", "per malloc");
+    int failures = 0;
+    for (size_t c = 0; c < NUM_COUNTS; c++) {
+        long long malloc_ns;
+        if (!run_count(mem, heap_size, fragment_counts[c], &malloc_ns)) {
+            printf("%12zu  run failed, give it more room\n", fragment_counts[c] + WANTED);
+            failures += 1;
+            continue;
+        }
+        printf("%12zu  %11.1f ns\n", fragment_counts[c] + WANTED, (double)malloc_ns / WANTED);
+    }
+    free(mem);
+    return failures != 0;
+}
@@ -0,0 +1,155 @@
+/* File: bench_coalesce.c
+ * -------------------------
+ *
+ * This file compares the explicit allocator's immediate and
+ * deferred coalescing on churn. For each workload and mode it fills
+ * a fresh heap with a live set of blocks and then runs a churn that
+ * frees a random block and mallocs a new one in its slot. The
+ * "classes" workload draws its sizes from a handful of fixed sizes,
+ * as objects of a few types would; the "spread" workload draws any
+ * size from 16 to 512 bytes, and both ask for 1 to 16 KB one
+ * request in 32.
+ *
+ * For each run it prints the churn throughput, how far into the
+ * segment the furthest block handed out reaches, and the heap's
+ * external fragmentation (1 - largest free block / free bytes) and
+ * free block count when the churn ends. Blocks on the quick lists
+ * count as free blocks of their own, so the deferred mode is also
+ * shown after its quick lists are consolidated.
+ *
+ * Build: gcc -O2 -o bench_coalesce bench_coalesce.c ExplicitAllocation.c
+ * Usage: ./bench_coalesce [live_blocks] [churn_ops] [heap_mb]   (default 20000, 2000000, 64)
+ */
+#include "./heap.h"
+#include "./bench.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#define LARGE_EVERY 32
+#define NUM_CLASSES 8
+
+static const size_t class_sizes[NUM_CLASSES] = {24, 40, 56, 96, 136, 200, 328, 480};
+static const char *workload_names[] = {"classes", "spread"};
+static const char *mode_names[] = {"immediate", "deferred"};
+
+/* Function: pick_size
+ * -------------------------
+ * Parameters:
+ *     state - a pointer to the generator state
+ *     workload - 0 for the fixed size classes, 1 for any size
+ *
+ * Returns: the size_t bytes of the next request
+ *
+ * This function draws a request size for a workload.
+ */
+size_t pick_size(uint64_t *state, int workload) {
+    uint64_t r = next_random(state);
+    if (r % LARGE_EVERY == 0) return 1024 + (r >> 8) % 15361;
+    if (workload == 0) return class_sizes[(r >> 8) % NUM_CLASSES];
+    return 16 + (r >> 8) % 497;
+}
+
+/* Function: print_frag
+ * -------------------------
+ * Parameters:
+ *     h - a pointer to the heap instance
+ *
+ * Returns: NA
+ *
+ * This function prints the heap's external fragmentation and free
+ * block count as heap_stats sees them.
+ */
+void print_frag(heap_t *h) {
+    heap_stats_t stats;
+    heap_stats(h, &stats);
+    printf("  frag %5.1f%%  free blocks %7zu",
+           stats.free_bytes ? 100.0 * (1.0 - (double)stats.largest_free / stats.free_bytes) : 0.0,
+           stats.free_blocks);
+}
+
+/* Function: run_mode
+ * -------------------------
+ * Parameters:
+ *     workload - 0 for the fixed size classes, 1 for any size
+ *     mode - the heap_coalesce_t mode to measure
+ *     mem - the memory to build the heap over
+ *     heap_size - the size_t bytes of mem
+ *     slots - room for nblocks pointers
+ *     nblocks - the size_t live blocks to keep
+ *     ops - the size_t churn operations to run
+ *
+ * Returns: boolean representation of if the run was set up and
+ *          the heap validated afterwards
+ *
+ * This function runs the fill and the churn for one workload and
+ * mode and prints its line.
+ */
+bool run_mode(int workload, heap_coalesce_t mode, char *mem, size_t heap_size, char **slots,
+              size_t nblocks, size_t ops) {
+    heap_t *h = heap_create(mem, heap_size);
+    if (h == NULL) return false;
+    heap_set_coalesce(h, mode);
+    uint64_t state = 0x9e3779b97f4a7c15ULL;
+    size_t furthest = 0;
+    for (size_t i = 0; i < nblocks; i++) {
+        size_t size = pick_size(&state, workload);
+        slots[i] = heap_malloc(h, size);
+        if (slots[i] == NULL) {
+            printf("the heap filled up after %zu blocks, give it more room\n", i);
+            return false;
+        }
+        if ((size_t)(slots[i] + size - mem) > furthest) furthest = slots[i] + size - mem;
+    }
+
+    size_t failed = 0;
+    long long start = now_ns();
+    for (size_t done = 0; done < ops; done++) {
+        size_t slot = next_random(&state) % nblocks;
+        heap_free(h, slots[slot]);
+        size_t size = pick_size(&state, workload);
+        slots[slot] = heap_malloc(h, size);
+        if (slots[slot] == NULL) {
+            failed += 1;
+        } else if ((size_t)(slots[slot] + size - mem) > furthest) {
+            furthest = slots[slot] + size - mem;
+        }
+    }
+    double seconds = (now_ns() - start) / 1e9;
+
+    printf("%-8s %-10s %10.0f ops/sec  failed %zu  reaches %5.1f MB", workload_names[workload],
+           mode_names[mode], ops / seconds, failed, furthest / 1048576.0);
+    print_frag(h);
+    if (mode == HEAP_COALESCE_DEFERRED) {
+        heap_set_coalesce(h, HEAP_COALESCE_IMMEDIATE);
+        printf("  consolidated:");
+        print_frag(h);
+    }
+    printf("\n");
+    return heap_validate(h);
+}
+
+int main(int argc, char *argv[]) {
+    size_t nblocks = argc > 1 ? strtoul(argv[1], NULL, 10) : 20000;
+    size_t ops = argc > 2 ? strtoul(argv[2], NULL, 10) : 2000000;
+    size_t heap_size = (argc > 3 ? strtoul(argv[3], NULL, 10) : 64) << 20;
+    char *mem = malloc(heap_size);
+    char **slots = malloc(nblocks * sizeof(char *));
+    if (nblocks == 0 || mem == NULL || slots == NULL) {
+        printf("usage: %s [live_blocks] [churn_ops] [heap_mb]\n", argv[0]);
+        return 1;
+    }
+
+    printf("%zu live blocks, %zu churn ops, %zu MB heap\n", nblocks, ops, heap_size >> 20);
+    int failures = 0;
+    for (int workload = 0; workload < 2; workload++) {
+        for (int mode = HEAP_COALESCE_IMMEDIATE; mode <= HEAP_COALESCE_DEFERRED; mode++) {
+            if (!run_mode(workload, (heap_coalesce_t)mode, mem, heap_size, slots, nblocks, ops)) {
+                printf("%s %s: run failed\n", workload_names[workload], mode_names[mode]);
+                failures += 1;
+            }
+        }
+    }
+    free(mem);
+    free(slots);
+    return failures != 0;
+}
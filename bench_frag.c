@@ -0,0 +1,87 @@
+/* File: bench_frag.c
+ * -------------------------
+ *
+ * This file measures how fragmented the explicit heap gets under a
+ * long random churn. It runs random mallocs, frees and growing
+ * reallocs over a fixed number of slots on one myinit segment,
+ * mostly of up to 256 bytes with one request in four of up to 8 KB,
+ * and then reads heap_stats.
+ *
+ * It prints the free blocks, free bytes and largest free block at
+ * the end, the external fragmentation (1 - largest free / free
+ * bytes), how many mallocs and reallocs failed and how many
+ * reallocs had to move their block. The numbers from when free
+ * blocks only merged to the right come from the version of this
+ * file in the footers commit, which walks the 8-byte headers of
+ * that time, built against the allocator of the commit before it.
+ *
+ * Build: gcc -O2 -o bench_frag bench_frag.c ExplicitAllocation.c
+ * Usage: ./bench_frag [ops] [heap_mb]   (default 2000000, 32)
+ */
+#include "./allocator.h"
+#include "./heap.h"
+#include "./bench.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#define SLOTS 4000
+#define LARGE_EVERY 4
+#define SMALL_MAX 256
+#define LARGE_MAX 8192
+#define GROW_MAX 512 // most bytes a realloc adds
+
+int main(int argc, char *argv[]) {
+    size_t ops = argc > 1 ? strtoul(argv[1], NULL, 10) : 2000000;
+    size_t heap_size = (argc > 2 ? strtoul(argv[2], NULL, 10) : 32) << 20;
+    char *mem = malloc(heap_size);
+    void **slots = calloc(SLOTS, sizeof(void *));
+    size_t *sizes = calloc(SLOTS, sizeof(size_t));
+    if (heap_size == 0 || mem == NULL || slots == NULL || sizes == NULL || !myinit(mem, heap_size)) {
+        printf("usage: %s [ops] [heap_mb]\n", argv[0]);
+        return 1;
+    }
+
+    uint64_t state = 0x9e3779b97f4a7c15ULL;
+    size_t failed = 0, reallocs = 0, moved = 0;
+    long long start = now_ns();
+    for (size_t op = 0; op < ops; op++) {
+        size_t i = next_random(&state) % SLOTS;
+        uint64_t r = next_random(&state);
+        if (slots[i] == NULL) {
+            sizes[i] = 1 + (r >> 8) % (r % LARGE_EVERY == 0 ? LARGE_MAX : SMALL_MAX);
+            slots[i] = mymalloc(sizes[i]);
+            if (slots[i] == NULL) failed += 1;
+        } else if (r % 4 != 0) {
+            myfree(slots[i]);
+            slots[i] = NULL;
+        } else {
+            size_t new_size = sizes[i] + (r >> 8) % GROW_MAX;
+            void *grown = myrealloc(slots[i], new_size);
+            reallocs += 1;
+            if (grown == NULL) {
+                failed += 1;
+            } else {
+                if (grown != slots[i]) moved += 1;
+                slots[i] = grown;
+                sizes[i] = new_size;
+            }
+        }
+    }
+    double seconds = (now_ns() - start) / 1e9;
+
+    heap_stats_t stats;
+    heap_stats(heap_default(), &stats);
+    printf("%zu ops in %.2f s over %zu slots, %zu MB heap\n", ops, seconds, (size_t)SLOTS, heap_size >> 20);
+    printf("free blocks          %zu\n", stats.free_blocks);
+    printf("free bytes           %zu\n", stats.free_bytes);
+    printf("largest free block   %zu\n", stats.largest_free);
+    printf("external frag.       %.3f\n",
+           stats.free_bytes ? 1.0 - (double)stats.largest_free / stats.free_bytes : 0.0);
+    printf("failed requests      %zu\n", failed);
+    printf("reallocs moved       %zu/%zu\n", moved, reallocs);
+    bool ok = validate_heap();
+    free(mem);
+    free(slots);
+    free(sizes);
+    return !ok;
+}
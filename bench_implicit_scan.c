@@ -0,0 +1,136 @@
+/* File: bench_implicit_scan.c
+ * -------------------------
+ *
+ * This file compares the implicit allocator's scan modes on a heap
+ * of many blocks. For each mode it fills a fresh heap with blocks
+ * of 16 to 256 bytes, frees a random quarter of them and then runs
+ * a churn of frees and mallocs over the live set, one malloc in 64
+ * asking for 2 to 8 KB, which no hole left by a small block fits.
+ * The fill always runs under the default HEAP_SCAN_SUMMARY, since
+ * filling a large heap with the original scan is quadratic; the
+ * mode being measured is set before the quarter is freed.
+ *
+ * For each mode it prints the churn throughput, the mean and
+ * slowest malloc, the failed mallocs and how far into the segment
+ * the furthest block handed out reaches. A mode that runs out of
+ * time stops early and reports the ops it managed.
+ *
+ * Build: gcc -O2 -o bench_implicit_scan bench_implicit_scan.c ImplicitAllocation.c
+ * Usage: ./bench_implicit_scan [blocks] [churn_ops] [heap_mb]   (default 1000000, 200000, 176)
+ */
+#include "./heap.h"
+#include "./bench.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#define TIME_LIMIT_NS 10000000000LL // a mode gets 10 seconds of churn
+#define LARGE_EVERY 64
+
+static const char *mode_names[] = {"first fit", "first fit + summary", "next fit", "next fit + summary"};
+
+/* Function: pick_size
+ * -------------------------
+ * Parameters:
+ *     state - a pointer to the generator state
+ *     large - whether this request may be a large one
+ *
+ * Returns: the size_t bytes of the next request
+ *
+ * This function draws a request size.
+ */
+size_t pick_size(uint64_t *state, bool large) {
+    uint64_t r = next_random(state);
+    if (large && r % LARGE_EVERY == 0) return 2048 + (r >> 8) % 6145;
+    return 16 + (r >> 8) % 241;
+}
+
+/* Function: run_mode
+ * -------------------------
+ * Parameters:
+ *     scan - the heap_scan_t mode to measure
+ *     mem - the memory to build the heap over
+ *     heap_size - the size_t bytes of mem
+ *     slots - room for nblocks pointers
+ *     nblocks - the size_t blocks to fill the heap with
+ *     ops - the size_t churn operations to run
+ *
+ * Returns: boolean representation of if the run was set up and
+ *          the heap validated afterwards
+ *
+ * This function runs the fill, the quarter free and the churn for
+ * one mode and prints its line.
+ */
+bool run_mode(heap_scan_t scan, char *mem, size_t heap_size, char **slots, size_t nblocks,
+              size_t ops) {
+    heap_t *h = heap_create(mem, heap_size);
+    if (h == NULL) return false;
+    uint64_t state = 0x9e3779b97f4a7c15ULL;
+    size_t furthest = 0;
+    for (size_t i = 0; i < nblocks; i++) {
+        size_t size = pick_size(&state, false);
+        slots[i] = heap_malloc(h, size);
+        if (slots[i] == NULL) {
+            printf("the heap filled up after %zu blocks, give it more room\n", i);
+            return false;
+        }
+        if ((size_t)(slots[i] + size - mem) > furthest) furthest = slots[i] + size - mem;
+    }
+
+    heap_set_scan(h, scan);
+    for (size_t i = 0; i < nblocks; i++) {
+        if (next_random(&state) % 4 == 0) {
+            heap_free(h, slots[i]);
+            slots[i] = NULL;
+        }
+    }
+
+    long long malloc_ns = 0, malloc_max = 0, start = now_ns();
+    size_t done = 0, mallocs = 0, failed = 0;
+    for (; done < ops; done++) {
+        if (done % 1024 == 0 && now_ns() - start > TIME_LIMIT_NS) break;
+        size_t slot = next_random(&state) % nblocks;
+        if (slots[slot] != NULL) heap_free(h, slots[slot]);
+        size_t size = pick_size(&state, true);
+        long long before = now_ns();
+        slots[slot] = heap_malloc(h, size);
+        long long took = now_ns() - before;
+        malloc_ns += took;
+        if (took > malloc_max) malloc_max = took;
+        mallocs += 1;
+        if (slots[slot] == NULL) {
+            failed += 1;
+        } else if ((size_t)(slots[slot] + size - mem) > furthest) {
+            furthest = slots[slot] + size - mem;
+        }
+    }
+    double seconds = (now_ns() - start) / 1e9;
+
+    printf("%-20s %8zu ops %10.0f ops/sec  malloc mean %8.0f ns  max %9lld ns  failed %zu  "
+           "reaches %.1f MB\n", mode_names[scan], done, done / seconds,
+           mallocs ? (double)malloc_ns / mallocs : 0.0, malloc_max, failed, furthest / 1048576.0);
+    return heap_validate(h);
+}
+
+int main(int argc, char *argv[]) {
+    size_t nblocks = argc > 1 ? strtoul(argv[1], NULL, 10) : 1000000;
+    size_t ops = argc > 2 ? strtoul(argv[2], NULL, 10) : 200000;
+    size_t heap_size = (argc > 3 ? strtoul(argv[3], NULL, 10) : 176) << 20;
+    char *mem = malloc(heap_size);
+    char **slots = malloc(nblocks * sizeof(char *));
+    if (nblocks == 0 || mem == NULL || slots == NULL) {
+        printf("usage: %s [blocks] [churn_ops] [heap_mb]\n", argv[0]);
+        return 1;
+    }
+
+    printf("%zu blocks, %zu churn ops, %zu MB heap\n", nblocks, ops, heap_size >> 20);
+    int failures = 0;
+    for (int scan = HEAP_SCAN_FIRST; scan <= HEAP_SCAN_NEXT_SUMMARY; scan++) {
+        if (!run_mode((heap_scan_t)scan, mem, heap_size, slots, nblocks, ops)) {
+            printf("%s: run failed\n", mode_names[scan]);
+            failures += 1;
+        }
+    }
+    free(mem);
+    free(slots);
+    return failures != 0;
+}
@@ -0,0 +1,222 @@
+/* File: bench_latency.c
+ * -------------------------
+ *
+ * This file measures the worst-case latency of mymalloc and myfree,
+ * for real-time paths where the slowest call matters more than the
+ * average one. It builds against any of the allocators and runs two
+ * workloads on a fresh myinit segment:
+ *
+ *     random      - random mallocs and frees of 16 to 8191 bytes,
+ *                   log-uniform, over a fixed number of slots
+ *     fragmented  - the segment is filled with blocks of one size,
+ *                   every other one is freed, and then requests
+ *                   just too large for any of the holes are made,
+ *                   so a list or heap walk sees every hole
+ *
+ * For each workload it prints the p50, p99, p99.9 and max latency
+ * of mymalloc and of myfree in nanoseconds.
+ *
+ * Build it once per allocator:
+ *     gcc -O2 -o bench_latency_tlsf bench_latency.c TLSFAllocation.c
+ *     gcc -O2 -o bench_latency_explicit bench_latency.c ExplicitAllocation.c
+ *     gcc -O2 -o bench_latency_implicit bench_latency.c ImplicitAllocation.c
+ *
+ * Usage: ./bench_latency_tlsf [heap_mb]   (default 4)
+ */
+#include "./allocator.h"
+#include "./bench.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define RANDOM_OPS 100000
+#define RANDOM_SLOTS 2048
+#define MIN_SIZE 16
+#define MAX_SIZE_LOG2 12
+#define HOLE_SIZE 300
+#define PIN_SIZE 100
+#define MISS_SIZE 400
+#define MISS_REQUESTS 200
+
+// latencies of one kind of call in one workload
+typedef struct samples
+{
+    long long *ns;
+    size_t count;
+} samples;
+
+/* Function: cmp_latency
+ * -------------------------
+ * Parameters:
+ *     a - a pointer to one latency
+ *     b - a pointer to another
+ *
+ * Returns: an int ordering the two for qsort
+ *
+ * This function sorts latencies from fastest to slowest.
+ */
+int cmp_latency(const void *a, const void *b) {
+    long long x = *(const long long *)a;
+    long long y = *(const long long *)b;
+    return (x > y) - (x < y);
+}
+
+/* Function: timed_malloc
+ * -------------------------
+ * Parameters:
+ *     s - the samples to add the call's latency to
+ *     size - the size_t bytes to request
+ *
+ * Returns: the void * mymalloc returned
+ *
+ * This function times one mymalloc call.
+ */
+void *timed_malloc(samples *s, size_t size) {
+    long long start = now_ns();
+    void *ptr = mymalloc(size);
+    s->ns[s->count++] = now_ns() - start;
+    return ptr;
+}
+
+/* Function: timed_free
+ * -------------------------
+ * Parameters:
+ *     s - the samples to add the call's latency to
+ *     ptr - the void * to free
+ *
+ * Returns: NA
+ *
+ * This function times one myfree call.
+ */
+void timed_free(samples *s, void *ptr) {
+    long long start = now_ns();
+    myfree(ptr);
+    s->ns[s->count++] = now_ns() - start;
+}
+
+/* Function: report
+ * -------------------------
+ * Parameters:
+ *     workload - the name of the workload
+ *     call - the name of the timed call
+ *     s - its samples
+ *
+ * Returns: NA
+ *
+ * This function prints the percentiles of one set of samples.
+ */
+void report(const char *workload, const char *call, samples *s) {
+    if (s->count == 0) return;
+    qsort(s->ns, s->count, sizeof(long long), cmp_latency);
+    printf("%-11s %-9s %8zu calls  p50 %6lld  p99 %7lld  p99.9 %8lld  max %9lld ns\n",
+           workload, call, s->count, s->ns[s->count / 2], s->ns[s->count * 99 / 100],
+           s->ns[s->count * 999 / 1000], s->ns[s->count - 1]);
+}
+
+/* Function: random_workload
+ * -------------------------
+ * Parameters:
+ *     m - the samples for mymalloc
+ *     f - the samples for myfree
+ *
+ * Returns: NA
+ *
+ * This function fills and empties random slots with blocks of
+ * log-uniform sizes.
+ */
+void random_workload(samples *m, samples *f) {
+    void *slots[RANDOM_SLOTS] = {0};
+    srand(1);
+    for (size_t i = 0; i < RANDOM_OPS; i++) {
+        size_t slot = rand() % RANDOM_SLOTS;
+        if (slots[slot] != NULL) {
+            timed_free(f, slots[slot]);
+            slots[slot] = NULL;
+        } else {
+            size_t size = (size_t)MIN_SIZE << (rand() % (MAX_SIZE_LOG2 - 3));
+            slots[slot] = timed_malloc(m, size + rand() % size);
+        }
+    }
+    for (size_t slot = 0; slot < RANDOM_SLOTS; slot++) {
+        if (slots[slot] != NULL) myfree(slots[slot]);
+    }
+}
+
+/* Function: fragmented_workload
+ * -------------------------
+ * Parameters:
+ *     m - the samples for mymalloc
+ *     f - the samples for myfree
+ *     max_blocks - the size_t most blocks the segment can hold
+ *
+ * Returns: NA
+ *
+ * This function fills the segment with holes pinned apart by small
+ * blocks and plugs what is left at the end, frees the holes, and
+ * then times requests that none of them can serve, followed by
+ * freeing the pins. The plugs stay until the next myinit.
+ */
+void fragmented_workload(samples *m, samples *f, size_t max_blocks) {
+    void **holes = malloc(max_blocks * sizeof(void *));
+    void **pins = malloc(max_blocks * sizeof(void *));
+    size_t n = 0;
+    while (n < max_blocks) {
+        holes[n] = mymalloc(HOLE_SIZE);
+        pins[n] = mymalloc(PIN_SIZE);
+        if (holes[n] == NULL || pins[n] == NULL) {
+            if (holes[n] != NULL) myfree(holes[n]);
+            break;
+        }
+        n++;
+    }
+    while (mymalloc(MIN_SIZE) != NULL) {
+        // plug the tail so that no larger free block is left either
+    }
+    for (size_t i = 0; i < n; i++) timed_free(f, holes[i]);
+    for (size_t i = 0; i < MISS_REQUESTS; i++) {
+        void *ptr = timed_malloc(m, MISS_SIZE);
+        if (ptr != NULL) myfree(ptr);
+    }
+    for (size_t i = 0; i < n; i++) timed_free(f, pins[i]);
+    free(holes);
+    free(pins);
+}
+
+int main(int argc, char *argv[]) {
+    size_t heap_size = (argc > 1 ? strtoul(argv[1], NULL, 10) : 4) << 20;
+    char *heap = malloc(heap_size);
+    size_t max_blocks = heap_size / (HOLE_SIZE + PIN_SIZE) + 1;
+    samples m = { malloc((RANDOM_OPS + max_blocks) * sizeof(long long)), 0 };
+    samples f = { malloc((RANDOM_OPS + 2 * max_blocks) * sizeof(long long)), 0 };
+    if (heap == NULL || m.ns == NULL || f.ns == NULL) {
+        printf("cannot get a %zu byte segment\n", heap_size);
+        return 1;
+    }
+    memset(heap, 0, heap_size); // page faults are not the allocator's latency
+
+    if (!myinit(heap, heap_size)) {
+        printf("myinit failed\n");
+        return 1;
+    }
+    random_workload(&m, &f);
+    report("random", "mymalloc", &m);
+    report("random", "myfree", &f);
+
+    m.count = 0;
+    f.count = 0;
+    if (!myinit(heap, heap_size)) {
+        printf("myinit failed\n");
+        return 1;
+    }
+    fragmented_workload(&m, &f, max_blocks);
+    report("fragmented", "mymalloc", &m);
+    report("fragmented", "myfree", &f);
+    if (!validate_heap()) {
+        printf("validate_heap failed\n");
+        return 1;
+    }
+    free(heap);
+    free(m.ns);
+    free(f.ns);
+    return 0;
+}
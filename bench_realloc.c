@@ -0,0 +1,92 @@
+/* File: bench_realloc.c
+ * -------------------------
+ *
+ * This file times growing one buffer from 1 MB to 1 GB with
+ * myrealloc, first with huge requests in mappings of their own
+ * (grown by mremap) and then with the mmap threshold off, where
+ * the buffer stays in the segment. There it is the last block, so
+ * realloc grows the heap under it in place instead of copying it
+ * out. It runs
+ * both a doubling and a fixed-step growth pattern and writes one
+ * byte per page of each new tail so the memory is really used.
+ *
+ * Build: gcc -O2 -o bench_realloc bench_realloc.c ExplicitAllocation.c
+ * Usage: ./bench_realloc [step_mb]   (default 64)
+ */
+#include "./allocator.h"
+#include "./heap.h"
+#include "./bench.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#define START_SIZE ((size_t)1 << 20)
+#define END_SIZE ((size_t)1 << 30)
+#define RESERVE_SIZE ((size_t)4 << 30)
+#define TOUCH_STRIDE 4096
+
+/* Function: grow_buffer
+ * -------------------------
+ * Parameters:
+ *     step - the size_t bytes to add each time, or 0 to double
+ *     reallocs - set to the number of myrealloc calls made
+ *
+ * Returns: a double of the milliseconds spent in myrealloc, or
+ *          a negative number if a call failed
+ *
+ * This function grows one buffer to END_SIZE and checks that the
+ * bytes written before every grow are still there afterwards.
+ */
+double grow_buffer(size_t step, size_t *reallocs) {
+    size_t size = START_SIZE;
+    char *buf = mymalloc(size);
+    if (buf == NULL) return -1;
+    for (size_t i = 0; i < size; i += TOUCH_STRIDE) buf[i] = (char)(i / TOUCH_STRIDE);
+
+    double spent = 0;
+    *reallocs = 0;
+    while (size < END_SIZE) {
+        size_t new_size = step ? size + step : size * 2;
+        if (new_size > END_SIZE) new_size = END_SIZE;
+
+        double start = now_ms();
+        char *grown = myrealloc(buf, new_size);
+        spent += now_ms() - start;
+        *reallocs += 1;
+        if (grown == NULL) return -1;
+
+        for (size_t i = 0; i < size; i += TOUCH_STRIDE) {
+            if (grown[i] != (char)(i / TOUCH_STRIDE)) return -1;
+        }
+        for (size_t i = size; i < new_size; i += TOUCH_STRIDE) grown[i] = (char)(i / TOUCH_STRIDE);
+        buf = grown;
+        size = new_size;
+    }
+    myfree(buf);
+    return spent;
+}
+
+int main(int argc, char *argv[]) {
+    size_t step = (argc > 1 ? strtoul(argv[1], NULL, 10) : 64) << 20;
+    size_t steps[] = {0, step};
+
+    for (int mapped = 1; mapped >= 0; mapped--) {
+        for (int s = 0; s < 2; s++) {
+            if (!myinit(NULL, RESERVE_SIZE)) {
+                printf("could not reserve %zu bytes\n", RESERVE_SIZE);
+                return 1;
+            }
+            if (!mapped) heap_set_mmap_threshold(heap_default(), 0);
+
+            size_t reallocs;
+            double spent = grow_buffer(steps[s], &reallocs);
+            if (spent < 0) {
+                printf("myrealloc failed or lost data\n");
+                return 1;
+            }
+            printf("%-14s %-18s %4zu reallocs %10.1f ms  %8.3f ms each\n",
+                   mapped ? "mremap:" : "segment:", steps[s] ? "fixed step growth" : "doubling growth",
+                   reallocs, spent, spent / reallocs);
+        }
+    }
+    return 0;
+}
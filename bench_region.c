@@ -0,0 +1,121 @@
+/* File: bench_region.c
+ * -------------------------
+ *
+ * This file compares a region heap with the explicit free lists for
+ * request-scoped work: each request allocates a set of objects of
+ * 16 to 256 bytes, touches every one and then drops them all. On
+ * the free lists that is a mymalloc and a myfree per object; in a
+ * region it is a pointer bump per object and one heap_reset back
+ * to a mark taken when the request started. The region's memory
+ * is itself a block of the myinit segment.
+ *
+ * It prints the time per request both ways and how much faster the
+ * region is.
+ *
+ * Build: gcc -O2 -o bench_region bench_region.c ExplicitAllocation.c
+ * Usage: ./bench_region [objects] [requests]   (default 2000, 2000)
+ */
+#include "./allocator.h"
+#include "./heap.h"
+#include "./bench.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#define HEAP_SIZE ((size_t)64 << 20)
+#define REGION_SIZE ((size_t)8 << 20)
+#define MIN_OBJECT 16
+#define MAX_OBJECT 256
+
+/* Function: run_free_lists
+ * -------------------------
+ * Parameters:
+ *     objects - room for count pointers
+ *     sizes - the size_t bytes of each object
+ *     count - the size_t objects per request
+ *     requests - the size_t requests to run
+ *
+ * Returns: a long long of the nanoseconds the requests took, or -1
+ *          if a malloc failed
+ *
+ * This function runs the requests with mymalloc and myfree.
+ */
+long long run_free_lists(char **objects, const size_t *sizes, size_t count, size_t requests) {
+    long long start = now_ns();
+    for (size_t r = 0; r < requests; r++) {
+        for (size_t i = 0; i < count; i++) {
+            objects[i] = mymalloc(sizes[i]);
+            if (objects[i] == NULL) return -1;
+            objects[i][0] = 1;
+        }
+        for (size_t i = 0; i < count; i++) myfree(objects[i]);
+    }
+    return now_ns() - start;
+}
+
+/* Function: run_region
+ * -------------------------
+ * Parameters:
+ *     region - the region heap to allocate from
+ *     objects - room for count pointers
+ *     sizes - the size_t bytes of each object
+ *     count - the size_t objects per request
+ *     requests - the size_t requests to run
+ *
+ * Returns: a long long of the nanoseconds the requests took, or -1
+ *          if a malloc failed
+ *
+ * This function runs the requests with heap_malloc on the region
+ * and one heap_reset each.
+ */
+long long run_region(heap_t *region, char **objects, const size_t *sizes, size_t count,
+                     size_t requests) {
+    long long start = now_ns();
+    for (size_t r = 0; r < requests; r++) {
+        heap_mark_t mark = heap_mark(region);
+        for (size_t i = 0; i < count; i++) {
+            objects[i] = heap_malloc(region, sizes[i]);
+            if (objects[i] == NULL) return -1;
+            objects[i][0] = 1;
+        }
+        heap_reset(region, mark);
+    }
+    return now_ns() - start;
+}
+
+int main(int argc, char *argv[]) {
+    size_t count = argc > 1 ? strtoul(argv[1], NULL, 10) : 2000;
+    size_t requests = argc > 2 ? strtoul(argv[2], NULL, 10) : 2000;
+    char *mem = malloc(HEAP_SIZE);
+    char **objects = malloc(count * sizeof(char *));
+    size_t *sizes = malloc(count * sizeof(size_t));
+    if (count == 0 || requests == 0 || mem == NULL || objects == NULL || sizes == NULL) {
+        printf("usage: %s [objects] [requests]\n", argv[0]);
+        return 1;
+    }
+    uint64_t state = 0x9e3779b97f4a7c15ULL;
+    for (size_t i = 0; i < count; i++) {
+        sizes[i] = MIN_OBJECT + next_random(&state) % (MAX_OBJECT - MIN_OBJECT + 1);
+    }
+
+    if (!myinit(mem, HEAP_SIZE)) return 1;
+    long long lists_ns = run_free_lists(objects, sizes, count, requests);
+    bool lists_ok = validate_heap();
+
+    void *region_mem = mymalloc(REGION_SIZE);
+    heap_t *region = region_mem ? heap_create_region(region_mem, REGION_SIZE) : NULL;
+    long long region_ns = region ? run_region(region, objects, sizes, count, requests) : -1;
+    bool region_ok = region && heap_validate(region);
+
+    if (lists_ns < 0 || region_ns < 0 || !lists_ok || !region_ok) {
+        printf("run failed, %zu objects may not fit in a %zu MB region\n", count, REGION_SIZE >> 20);
+        return 1;
+    }
+    printf("%zu objects a request, %zu requests\n", count, requests);
+    printf("mymalloc + myfree         %9.1f us per request\n", lists_ns / 1e3 / requests);
+    printf("region bump + heap_reset  %9.1f us per request  (%.1fx)\n", region_ns / 1e3 / requests,
+           (double)lists_ns / region_ns);
+    free(mem);
+    free(objects);
+    free(sizes);
+    return 0;
+}
@@ -0,0 +1,146 @@
+/* File: bench_remote_free.c
+ * -------------------------
+ *
+ * This file measures frees made on a different thread from the
+ * malloc, as in a producer/consumer pipeline. Each pair of threads
+ * shares a ring of pointers: the producer mallocs blocks of a
+ * rotating set of sizes and hands them over, and the consumer
+ * reads each one and frees it. Small blocks go through the thread
+ * caches, larger ones straight to the central free lists, where a
+ * free that finds the lock taken is pushed onto the remote-free
+ * list instead of waiting for it.
+ *
+ * It prints the wall time, the frees per second over all
+ * consumers and the mean and slowest time of one myfree call.
+ *
+ * Build: gcc -O2 -DTHREAD_SAFE -o bench_remote_free bench_remote_free.c ExplicitAllocation.c -lpthread
+ * Usage: ./bench_remote_free [pairs] [objects_per_pair]   (default 2, 1000000)
+ */
+#include "./allocator.h"
+#include "./bench.h"
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define HEAP_SIZE ((size_t)256 << 20)
+#define RING_SIZE 1024 // a power of two
+#define MAX_PAIRS 16
+
+static const size_t sizes[] = {24, 96, 200, 512, 1500, 4000};
+#define NUM_SIZES (sizeof(sizes) / sizeof(sizes[0]))
+
+// one producer/consumer pair and the ring between them
+typedef struct pair
+{
+    void *slots[RING_SIZE];
+    size_t head; // next slot the producer fills
+    size_t tail; // next slot the consumer empties
+    size_t objects;
+    long long free_ns; // time the consumer spent in myfree
+    long long free_max; // its slowest myfree
+    size_t failed;
+} pair;
+
+/* Function: produce
+ * -------------------------
+ * Parameters:
+ *     arg - a void * to the thread's pair
+ *
+ * Returns: NULL
+ *
+ * This function mallocs every object of the pair, stamps its first
+ * byte and puts it in the ring, yielding while the ring is full.
+ */
+void *produce(void *arg) {
+    pair *p = arg;
+    for (size_t i = 0; i < p->objects; i++) {
+        unsigned char *ptr = mymalloc(sizes[i % NUM_SIZES]);
+        if (ptr == NULL) {
+            p->failed += 1;
+        } else {
+            ptr[0] = (unsigned char)i;
+        }
+        while (i - __atomic_load_n(&p->tail, __ATOMIC_ACQUIRE) == RING_SIZE) sched_yield();
+        p->slots[i % RING_SIZE] = ptr;
+        __atomic_store_n(&p->head, i + 1, __ATOMIC_RELEASE);
+    }
+    return NULL;
+}
+
+/* Function: consume
+ * -------------------------
+ * Parameters:
+ *     arg - a void * to the thread's pair
+ *
+ * Returns: NULL
+ *
+ * This function takes every object of the pair out of the ring,
+ * checks its stamp and frees it, timing each myfree.
+ */
+void *consume(void *arg) {
+    pair *p = arg;
+    for (size_t i = 0; i < p->objects; i++) {
+        while (__atomic_load_n(&p->head, __ATOMIC_ACQUIRE) == i) sched_yield();
+        unsigned char *ptr = p->slots[i % RING_SIZE];
+        __atomic_store_n(&p->tail, i + 1, __ATOMIC_RELEASE);
+        if (ptr == NULL) continue;
+        if (ptr[0] != (unsigned char)i) {
+            printf("object %zu was overwritten\n", i);
+            exit(1);
+        }
+        long long start = now_ns();
+        myfree(ptr);
+        long long took = now_ns() - start;
+        p->free_ns += took;
+        if (took > p->free_max) p->free_max = took;
+    }
+    return NULL;
+}
+
+int main(int argc, char *argv[]) {
+    size_t npairs = argc > 1 ? strtoul(argv[1], NULL, 10) : 2;
+    size_t objects = argc > 2 ? strtoul(argv[2], NULL, 10) : 1000000;
+    if (npairs == 0 || npairs > MAX_PAIRS) {
+        printf("usage: %s [pairs (1-%d)] [objects_per_pair]\n", argv[0], MAX_PAIRS);
+        return 1;
+    }
+    char *heap = malloc(HEAP_SIZE);
+    pair *pairs = calloc(npairs, sizeof(pair));
+    if (heap == NULL || pairs == NULL || !myinit(heap, HEAP_SIZE)) {
+        printf("cannot set up a %zu byte heap\n", HEAP_SIZE);
+        return 1;
+    }
+
+    pthread_t producers[MAX_PAIRS], consumers[MAX_PAIRS];
+    long long start = now_ns();
+    for (size_t i = 0; i < npairs; i++) {
+        pairs[i].objects = objects;
+        pthread_create(&consumers[i], NULL, consume, &pairs[i]);
+        pthread_create(&producers[i], NULL, produce, &pairs[i]);
+    }
+    for (size_t i = 0; i < npairs; i++) {
+        pthread_join(producers[i], NULL);
+        pthread_join(consumers[i], NULL);
+    }
+    double seconds = (now_ns() - start) / 1e9;
+
+    long long free_ns = 0, free_max = 0;
+    size_t failed = 0;
+    for (size_t i = 0; i < npairs; i++) {
+        free_ns += pairs[i].free_ns;
+        if (pairs[i].free_max > free_max) free_max = pairs[i].free_max;
+        failed += pairs[i].failed;
+    }
+    size_t frees = npairs * objects - failed;
+    printf("%zu pairs  %zu frees  %.3f s  %.0f frees/sec  myfree mean %.0f ns  max %lld ns  failed %zu\n",
+           npairs, frees, seconds, frees / seconds, frees ? (double)free_ns / frees : 0.0,
+           free_max, failed);
+    if (!validate_heap()) {
+        printf("validate_heap failed\n");
+        return 1;
+    }
+    free(heap);
+    free(pairs);
+    return 0;
+}
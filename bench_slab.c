@@ -0,0 +1,82 @@
+/* File: bench_slab.c
+ * -------------------------
+ *
+ * This file measures what the slabs save on small objects. For
+ * each slab size it fills a fresh myinit segment with objects of
+ * that one size until mymalloc fails, then frees every other object,
+ * mallocs them back and frees everything.
+ *
+ * It prints the bytes of segment used per object, which counts the
+ * header, rounding and minimum payload of a block, the time per
+ * malloc while filling and the time per call of the free and
+ * malloc churn after it. It only uses allocator.h, so it also
+ * builds against the allocator from before the slabs:
+ *     git show 5dcc32b:ExplicitAllocation.c > explicit_before.c
+ *     gcc -O2 -o bench_slab_before bench_slab.c explicit_before.c
+ *
+ * Build: gcc -O2 -o bench_slab bench_slab.c ExplicitAllocation.c
+ * Usage: ./bench_slab [heap_mb]   (default 16)
+ */
+#include "./allocator.h"
+#include "./bench.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+static const size_t object_sizes[] = {8, 16, 24, 32, 48, 64};
+#define NUM_SIZES (sizeof(object_sizes) / sizeof(object_sizes[0]))
+
+/* Function: run_size
+ * -------------------------
+ * Parameters:
+ *     mem - the segment to give myinit
+ *     heap_size - the size_t bytes of mem
+ *     objects - room for heap_size / 8 pointers
+ *     size - the size_t bytes of every object
+ *
+ * Returns: boolean representation of if the segment held any
+ *          objects and the heap validated afterwards
+ *
+ * This function fills a fresh heap with objects of one size and
+ * prints what that cost.
+ */
+bool run_size(char *mem, size_t heap_size, void **objects, size_t size) {
+    if (!myinit(mem, heap_size)) return false;
+    size_t count = 0;
+    long long start = now_ns();
+    while ((objects[count] = mymalloc(size)) != NULL) count += 1;
+    long long filled = now_ns();
+    if (count == 0) return false;
+
+    for (size_t i = 0; i < count; i += 2) myfree(objects[i]);
+    for (size_t i = 0; i < count; i += 2) objects[i] = mymalloc(size);
+    for (size_t i = 0; i < count; i++) myfree(objects[i]);
+    long long churned = now_ns();
+
+    // the churn is a free and a malloc for half the objects, then a free each
+    double churn_calls = count + 2 * ((count + 1) / 2);
+    printf("%6zu  %9zu  %9.1f  %9.1f ns  %9.1f ns\n", size, count, (double)heap_size / count,
+           (double)(filled - start) / count, (churned - filled) / churn_calls);
+    return validate_heap();
+}
+
+int main(int argc, char *argv[]) {
+    size_t heap_size = (argc > 1 ? strtoul(argv[1], NULL, 10) : 16) << 20;
+    char *mem = malloc(heap_size);
+    void **objects = malloc(heap_size / 8 * sizeof(void *));
+    if (heap_size == 0 || mem == NULL || objects == NULL) {
+        printf("usage: %s [heap_mb]\n", argv[0]);
+        return 1;
+    }
+
+    printf("%6s  %9s  %9s  %12s  %12s\n", "size", "objects", "bytes/obj", "malloc", "churn/call");
+    int failures = 0;
+    for (size_t s = 0; s < NUM_SIZES; s++) {
+        if (!run_size(mem, heap_size, objects, object_sizes[s])) {
+            printf("%6zu  run failed\n", object_sizes[s]);
+            failures += 1;
+        }
+    }
+    free(mem);
+    free(objects);
+    return failures != 0;
+}
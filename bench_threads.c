@@ -0,0 +1,179 @@
+/* File: bench_threads.c
+ * -------------------------
+ *
+ * This file measures how the explicit allocator scales from 1 to 32
+ * threads. Every thread runs the same number of random mallocs and
+ * frees over slots of its own, nine requests in ten of at most 128
+ * bytes and the rest of up to 2 KB, stamping each block and
+ * checking the stamp before it frees it. Each thread count runs on
+ * a fresh myinit segment of the same size.
+ *
+ * Built with -DTHREAD_SAFE it measures the allocator's own design,
+ * where small blocks go through the per-thread caches in front of
+ * the heap lock. Built with -DLOCK_ONLY against the plain allocator
+ * it takes one lock of its own around every mymalloc and myfree
+ * instead, which is the cost of the lock with no caches. It prints
+ * the total Mops/s for each thread count.
+ *
+ * Build: gcc -O2 -DTHREAD_SAFE -o bench_threads bench_threads.c ExplicitAllocation.c -lpthread
+ *        gcc -O2 -DLOCK_ONLY -o bench_threads_locked bench_threads.c ExplicitAllocation.c -lpthread
+ * Usage: ./bench_threads [ops_per_thread]   (default 200000)
+ */
+#include "./allocator.h"
+#include "./bench.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define HEAP_SIZE ((size_t)256 << 20)
+#define MAX_THREADS 32
+#define SLOTS 256 // per thread
+#define SMALL_MAX 128
+#define LARGE_MAX 2048
+#define LARGE_EVERY 10
+
+// what one thread is given and reports back
+typedef struct worker
+{
+    uint64_t seed;
+    size_t ops;
+    bool corrupt;
+} worker;
+
+#ifdef LOCK_ONLY
+static pthread_mutex_t heap_lock = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+/* Function: bench_malloc
+ * -------------------------
+ * Parameters:
+ *     size - the size_t bytes to allocate
+ *
+ * Returns: a void * to the block, or NULL
+ *
+ * This function is mymalloc, under the benchmark's own lock in the
+ * LOCK_ONLY build.
+ */
+void *bench_malloc(size_t size) {
+#ifdef LOCK_ONLY
+    pthread_mutex_lock(&heap_lock);
+    void *ptr = mymalloc(size);
+    pthread_mutex_unlock(&heap_lock);
+    return ptr;
+#else
+    return mymalloc(size);
+#endif
+}
+
+/* Function: bench_free
+ * -------------------------
+ * Parameters:
+ *     ptr - a void * to the block to free
+ *
+ * Returns: NA
+ *
+ * This function is myfree, under the benchmark's own lock in the
+ * LOCK_ONLY build.
+ */
+void bench_free(void *ptr) {
+#ifdef LOCK_ONLY
+    pthread_mutex_lock(&heap_lock);
+    myfree(ptr);
+    pthread_mutex_unlock(&heap_lock);
+#else
+    myfree(ptr);
+#endif
+}
+
+/* Function: run_worker
+ * -------------------------
+ * Parameters:
+ *     arg - a void * to the thread's worker
+ *
+ * Returns: NULL
+ *
+ * This function runs one thread's mallocs and frees and frees
+ * whatever it still holds at the end.
+ */
+void *run_worker(void *arg) {
+    worker *w = arg;
+    unsigned char *slots[SLOTS] = {NULL};
+    size_t sizes[SLOTS];
+    uint64_t state = w->seed;
+    for (size_t op = 0; op < w->ops; op++) {
+        size_t i = next_random(&state) % SLOTS;
+        if (slots[i] != NULL) {
+            if (slots[i][0] != (unsigned char)i || slots[i][sizes[i] - 1] != (unsigned char)i) w->corrupt = true;
+            bench_free(slots[i]);
+            slots[i] = NULL;
+        } else {
+            uint64_t r = next_random(&state);
+            sizes[i] = 1 + (r >> 8) % (r % LARGE_EVERY == 0 ? LARGE_MAX : SMALL_MAX);
+            slots[i] = bench_malloc(sizes[i]);
+            if (slots[i] != NULL) {
+                slots[i][0] = (unsigned char)i;
+                slots[i][sizes[i] - 1] = (unsigned char)i;
+            }
+        }
+    }
+    for (size_t i = 0; i < SLOTS; i++) bench_free(slots[i]);
+    return NULL;
+}
+
+/* Function: run_threads
+ * -------------------------
+ * Parameters:
+ *     mem - the HEAP_SIZE bytes to give myinit
+ *     nthreads - the size_t threads to run
+ *     ops - the size_t operations each thread runs
+ *
+ * Returns: a double of the total Mops/s, or a negative number if a
+ *          stamp was overwritten or the heap did not validate
+ *
+ * This function runs one thread count on a fresh heap.
+ */
+double run_threads(char *mem, size_t nthreads, size_t ops) {
+    if (!myinit(mem, HEAP_SIZE)) return -1;
+
+    pthread_t threads[MAX_THREADS];
+    worker workers[MAX_THREADS];
+    long long start = now_ns();
+    for (size_t i = 0; i < nthreads; i++) {
+        workers[i] = (worker){0x9e3779b97f4a7c15ULL * (i + 1), ops, false};
+        pthread_create(&threads[i], NULL, run_worker, &workers[i]);
+    }
+    for (size_t i = 0; i < nthreads; i++) pthread_join(threads[i], NULL);
+    double seconds = (now_ns() - start) / 1e9;
+
+    bool ok = validate_heap();
+    for (size_t i = 0; i < nthreads; i++) ok = ok && !workers[i].corrupt;
+    return ok ? nthreads * ops / seconds / 1e6 : -1;
+}
+
+int main(int argc, char *argv[]) {
+    size_t ops = argc > 1 ? strtoul(argv[1], NULL, 10) : 200000;
+    char *mem = malloc(HEAP_SIZE);
+    if (ops == 0 || mem == NULL) {
+        printf("usage: %s [ops_per_thread]\n", argv[0]);
+        return 1;
+    }
+
+#ifdef LOCK_ONLY
+    printf("%zu ops per thread, one lock and no caches\n", ops);
+#else
+    printf("%zu ops per thread, thread caches over the heap lock\n", ops);
+#endif
+    printf("%8s  %12s\n", "threads", "Mops/s");
+    int failures = 0;
+    for (size_t nthreads = 1; nthreads <= MAX_THREADS; nthreads *= 2) {
+        double mops = run_threads(mem, nthreads, ops);
+        if (mops < 0) {
+            printf("%8zu  run failed\n", nthreads);
+            failures += 1;
+            continue;
+        }
+        printf("%8zu  %12.2f\n", nthreads, mops);
+    }
+    free(mem);
+    return failures != 0;
+}
@@ -0,0 +1,199 @@
+/* File: heap.h
+ * -------------------------
+ *
+ * This file declares the handle-based interface to the heap
+ * allocators. Every heap_t is an independent heap instance that
+ * owns the memory it was created over, so a process can keep one
+ * heap per subsystem and drop a whole one in O(1). The my* functions
+ * of allocator.h are thin wrappers over one default instance.
+ */
+#ifndef _HEAP_H
+#define _HEAP_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct heap heap_t;
+typedef size_t heap_mark_t;
+
+// how a heap picks the free block for a request
+typedef enum {
+    HEAP_FIRST_FIT, // first block that fits in the segregated bins
+    HEAP_BEST_FIT   // smallest block that fits, from a size-ordered tree
+} heap_policy_t;
+
+heap_t *heap_create(void *start, size_t size);
+void heap_destroy(heap_t *h);
+
+/* Growable mode (explicit allocator): the heap maps its own memory,
+ * reserving max_size bytes of address space, committing chunks as
+ * allocations need them and returning a large free tail to the OS.
+ * myinit(NULL, max_size) does the same for the default heap.
+ */
+heap_t *heap_create_growable(size_t max_size);
+
+/* Requests of at least a heap's mmap threshold get a mapping of their
+ * own that realloc grows with mremap and free unmaps. 0 turns this off,
+ * which is where fixed heaps start. heap_default() is the my* heap.
+ */
+heap_t *heap_default(void);
+void heap_set_mmap_threshold(heap_t *h, size_t threshold);
+
+// Placement policy (explicit allocator). -DBEST_FIT makes best fit the default.
+void heap_set_policy(heap_t *h, heap_policy_t policy);
+
+// when the explicit allocator merges a freed block with its neighbours
+typedef enum {
+    HEAP_COALESCE_IMMEDIATE, // on every free
+    HEAP_COALESCE_DEFERRED   // in batches, small blocks wait on quick lists
+} heap_coalesce_t;
+
+/* Coalescing mode (explicit allocator). In HEAP_COALESCE_DEFERRED a
+ * freed block of up to 516 bytes goes onto a quick list of its exact
+ * size unmerged and is reused as is. The quick lists are merged in
+ * one address-ordered sweep when a malloc finds nothing but the tail
+ * block that fits or once they hold 64 KB. -DDEFERRED_COALESCE makes
+ * it the default; switching back to immediate merges them at once.
+ */
+void heap_set_coalesce(heap_t *h, heap_coalesce_t mode);
+
+// where the implicit allocator starts looking for a free block
+typedef enum {
+    HEAP_SCAN_FIRST,       // from the segment start, never merging free blocks
+    HEAP_SCAN_SUMMARY,     // from the segment start, merging and jumping over chunks with no fit
+    HEAP_SCAN_NEXT,        // from a roving cursor, merging free neighbours
+    HEAP_SCAN_NEXT_SUMMARY // as HEAP_SCAN_NEXT, jumping over chunks with no fit
+} heap_scan_t;
+
+/* Scan mode (implicit allocator). New heaps start in
+ * HEAP_SCAN_SUMMARY, first fit over a bound on the largest free
+ * block of each 4 KB chunk, kept at the end of the segment so a
+ * malloc skips runs of allocated blocks and of holes too small for
+ * it. The next-fit modes are faster on a large heap but reach
+ * further into it, so peak utilisation drops. HEAP_SCAN_FIRST is
+ * the original full scan. -DNEXT_FIT makes HEAP_SCAN_NEXT_SUMMARY
+ * the default, for the my* heap too.
+ */
+void heap_set_scan(heap_t *h, heap_scan_t scan);
+
+void *heap_malloc(heap_t *h, size_t requested_size);
+void heap_free(heap_t *h, void *ptr);
+
+/* Realloc: as with C realloc, a realloc that fails returns NULL and
+ * leaves the old block allocated and unchanged, in every allocator.
+ * A new size of 0 frees the block and returns NULL.
+ */
+void *heap_realloc(heap_t *h, void *old_ptr, size_t new_size);
+
+/* Sizes: heap_usable_size is the room a live block has, rounding
+ * included, and 0 for NULL or a pointer the heap can tell is not
+ * one; a caller may fill all of it without a realloc.
+ * heap_free_sized frees a block given the size last asked for with
+ * it, or anything up to its usable size. The explicit allocator's
+ * thread cache uses it to skip a lookup, and HARDENED builds abort
+ * on a size larger than the block.
+ */
+void heap_free_sized(heap_t *h, void *ptr, size_t size);
+size_t heap_usable_size(heap_t *h, void *ptr);
+void myfree_sized(void *ptr, size_t size);
+size_t my_usable_size(void *ptr);
+
+/* Aligned allocation (explicit and implicit allocators): the payload
+ * starts at a multiple of align, a power of two, and the gap in front
+ * of it is split off as a free block rather than padding. The block
+ * takes heap_free and heap_realloc like any other, though a realloc
+ * that moves it only keeps 8-byte alignment. myposix_memalign returns
+ * 0, EINVAL or ENOMEM as posix_memalign does.
+ */
+void *heap_aligned_alloc(heap_t *h, size_t align, size_t requested_size);
+void *myaligned_alloc(size_t align, size_t requested_size);
+int myposix_memalign(void **out, size_t align, size_t requested_size);
+
+/* Batches (explicit allocator): heap_malloc_batch allocates count
+ * blocks of one size under one lock, carved back to back from as
+ * few free blocks as it can, and returns how many it got; the rest
+ * of out is set to NULL. heap_free_batch frees n blocks under one
+ * lock, merging neighbours in one address-ordered sweep. The my*
+ * versions work on the default heap.
+ */
+size_t heap_malloc_batch(heap_t *h, size_t requested_size, size_t count, void **out);
+void heap_free_batch(heap_t *h, void **ptrs, size_t n);
+size_t mymalloc_batch(size_t requested_size, size_t count, void **out);
+void myfree_batch(void **ptrs, size_t n);
+
+/* Region mode (explicit allocator): allocation is a pointer bump,
+ * heap_free is a no-op and heap_reset rolls back to a mark in O(1).
+ * heap_reset on any other heap wipes it back to empty.
+ */
+heap_t *heap_create_region(void *start, size_t size);
+heap_mark_t heap_mark(heap_t *h);
+void heap_reset(heap_t *h, heap_mark_t mark);
+
+/* Statistics (explicit allocator): kept up to date as blocks come
+ * and go, so heap_stats costs a few loads and no heap walk. Class c
+ * counts payloads of up to 16 << c bytes, the last class the rest.
+ * Peak bytes is the most the heap ever had taken, headers, slab
+ * pages, thread-cached blocks and huge mappings included.
+ */
+#define HEAP_STATS_CLASSES 24
+
+typedef struct heap_stats
+{
+    size_t live_bytes; // payload bytes handed out and not yet freed
+    size_t peak_bytes;
+    size_t free_bytes; // payload bytes of the free blocks
+    size_t free_blocks;
+    size_t largest_free; // payload of the largest free block
+    size_t allocs[HEAP_STATS_CLASSES];
+    size_t frees[HEAP_STATS_CLASSES];
+    size_t reallocs_in_place;
+    size_t reallocs_moved;
+} heap_stats_t;
+
+void heap_stats(heap_t *h, heap_stats_t *stats);
+
+/* Sampling profiler (explicit allocator): heap_profile_start samples
+ * one allocation about every sample_bytes bytes over all heaps, with
+ * its backtrace, and tracks it until it is freed; 0 stops and forgets
+ * every sample. heap_profile_dump writes the live sampled bytes by
+ * stack as a pprof text heap profile. When off, mallocs and frees
+ * pay one load and a branch.
+ */
+bool heap_profile_start(size_t sample_bytes);
+bool heap_profile_dump(const char *path);
+
+bool heap_validate(heap_t *h);
+void heap_dump(heap_t *h);
+
+/* Incremental validation (explicit allocator): heap_validate_step
+ * checks at most budget blocks, free-list links included, from where
+ * the last call stopped, so it can run on a live heap at a bounded
+ * cost per call; 0 checks them all. The totals are compared only on
+ * a call that walks the whole heap.
+ */
+bool heap_validate_step(heap_t *h, size_t budget);
+
+/* Snapshots: heap_snapshot writes every block of a heap to a file for
+ * heap_analyze.c to read offline. The file is a heap_snap_hdr_t, one
+ * 32-bit word per block in address order (the block size, header
+ * included and a multiple of 8, or'd with its HEAP_SNAP_* state),
+ * then one 64-bit mapping size per huge block.
+ */
+#define HEAP_SNAP_MAGIC "HEAPSNP1"
+#define HEAP_SNAP_FREE 0
+#define HEAP_SNAP_USED 1
+#define HEAP_SNAP_SLAB 2 // a slab page, cut into objects
+#define HEAP_SNAP_STATE 0x7
+
+typedef struct heap_snap_hdr
+{
+    char magic[8];
+    uint64_t segment_size;
+    uint64_t blocks;
+    uint64_t huge_blocks;
+} heap_snap_hdr_t;
+
+bool heap_snapshot(heap_t *h, const char *path);
+
+#endif
@@ -0,0 +1,203 @@
+/* File: heap_analyze.c
+ * -------------------------
+ *
+ * This file is an offline fragmentation analyzer for the snapshots
+ * heap_snapshot writes (the format is in heap.h). It reads the
+ * block extents back in address order and reports:
+ *
+ *     - block, used, free and slab page totals and huge mappings
+ *     - a histogram of free block sizes by power of two
+ *     - external fragmentation, 1 - largest free / total free
+ *     - the largest contiguous free region, merging neighbouring
+ *       free blocks (the implicit allocator only merges forward,
+ *       and not at all under HEAP_SCAN_FIRST, so it can be larger
+ *       than the largest block)
+ *     - an occupancy map of the segment, one character per cell:
+ *       ' ' empty, '.' up to a quarter used, ':' up to half,
+ *       '+' up to three quarters, '#' more
+ *
+ * Build: gcc -O2 -o heap_analyze heap_analyze.c
+ * Usage: ./heap_analyze [-w cells] snapshot   (default 512 cells, 64 a row)
+ */
+#include "./heap.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DEFAULT_CELLS 512
+#define ROW_CELLS 64
+#define HIST_BUCKETS 33 // one per power of two up to 4 GB
+
+// what the analyzer adds up over one snapshot
+typedef struct totals
+{
+    uint64_t used_blocks, used_bytes;
+    uint64_t free_blocks, free_bytes;
+    uint64_t slab_pages;
+    uint64_t largest_free;
+    uint64_t largest_run; // bytes of the largest run of neighbouring free blocks
+    uint64_t hist_blocks[HIST_BUCKETS];
+    uint64_t hist_bytes[HIST_BUCKETS];
+} totals;
+
+/* Function: log2_floor
+ * -------------------------
+ * Parameters:
+ *     n - a nonzero uint64_t
+ *
+ * Returns: the size_t index of n's highest set bit
+ *
+ * This function picks the histogram bucket of a block size.
+ */
+size_t log2_floor(uint64_t n) {
+    return 63 - __builtin_clzll(n);
+}
+
+/* Function: add_used
+ * -------------------------
+ * Parameters:
+ *     used - the per-cell used byte counts of the occupancy map
+ *     cells - the size_t number of cells
+ *     segment_size - the uint64_t bytes of the segment
+ *     start - the uint64_t offset of a used block
+ *     size - the uint64_t bytes of the block
+ *
+ * Returns: NA
+ *
+ * This function spreads a used block over the cells it covers.
+ */
+void add_used(uint64_t *used, size_t cells, uint64_t segment_size, uint64_t start, uint64_t size) {
+    uint64_t end = start + size;
+    while (start < end) {
+        size_t cell = (size_t)(start * cells / segment_size);
+        if (cell >= cells) break;
+        uint64_t cell_end = ((uint64_t)(cell + 1) * segment_size + cells - 1) / cells;
+        uint64_t upto = (end < cell_end) ? end : cell_end;
+        used[cell] += upto - start;
+        start = upto;
+    }
+}
+
+/* Function: print_map
+ * -------------------------
+ * Parameters:
+ *     used - the per-cell used byte counts
+ *     cells - the size_t number of cells
+ *     segment_size - the uint64_t bytes of the segment
+ *
+ * Returns: NA
+ *
+ * This function prints the occupancy map, ROW_CELLS cells a row,
+ * each row led by the offset it starts at.
+ */
+void print_map(uint64_t *used, size_t cells, uint64_t segment_size) {
+    static const char glyphs[] = " .:+#";
+    printf("occupancy map (%zu cells of about %llu bytes):\n", cells,
+           (unsigned long long)((segment_size + cells - 1) / cells));
+    for (size_t row = 0; row < cells; row += ROW_CELLS) {
+        printf("  %12llu |", (unsigned long long)(row * segment_size / cells));
+        for (size_t cell = row; cell < cells && cell < row + ROW_CELLS; cell++) {
+            uint64_t cell_size = ((cell + 1) * segment_size / cells) - (cell * segment_size / cells);
+            size_t level = 0;
+            if (used[cell] > 0 && cell_size > 0) {
+                level = 1 + (size_t)(used[cell] * 4 / (cell_size + 1));
+                if (level > 4) level = 4;
+            }
+            putchar(glyphs[level]);
+        }
+        printf("|\n");
+    }
+}
+
+int main(int argc, char *argv[]) {
+    size_t cells = DEFAULT_CELLS;
+    int first = 1;
+    if (argc > 3 && strcmp(argv[1], "-w") == 0) {
+        cells = strtoul(argv[2], NULL, 10);
+        first = 3;
+    }
+    if (first != argc - 1 || cells == 0) {
+        printf("usage: %s [-w cells] snapshot\n", argv[0]);
+        return 1;
+    }
+
+    FILE *fp = fopen(argv[first], "rb");
+    heap_snap_hdr_t snap_hdr;
+    if (fp == NULL || fread(&snap_hdr, sizeof(snap_hdr), 1, fp) != 1
+        || memcmp(snap_hdr.magic, HEAP_SNAP_MAGIC, sizeof(snap_hdr.magic)) != 0) {
+        printf("%s: not a heap snapshot\n", argv[first]);
+        return 1;
+    }
+    uint64_t *used = calloc(cells, sizeof(uint64_t));
+    if (used == NULL) {
+        printf("cannot allocate the occupancy map\n");
+        return 1;
+    }
+
+    totals t = {0};
+    uint64_t offset = 0, run = 0;
+    for (uint64_t i = 0; i < snap_hdr.blocks; i++) {
+        uint32_t word;
+        if (fread(&word, sizeof(word), 1, fp) != 1) {
+            printf("%s: truncated after %llu blocks\n", argv[first], (unsigned long long)i);
+            return 1;
+        }
+        uint64_t size = word & ~(uint32_t)HEAP_SNAP_STATE;
+        if (size == 0) {
+            printf("%s: block %llu has no size\n", argv[first], (unsigned long long)i);
+            return 1;
+        }
+        if ((word & HEAP_SNAP_STATE) == HEAP_SNAP_FREE) {
+            t.free_blocks += 1;
+            t.free_bytes += size;
+            t.hist_blocks[log2_floor(size)] += 1;
+            t.hist_bytes[log2_floor(size)] += size;
+            if (size > t.largest_free) t.largest_free = size;
+            run += size;
+            if (run > t.largest_run) t.largest_run = run;
+        } else {
+            if ((word & HEAP_SNAP_STATE) == HEAP_SNAP_SLAB) t.slab_pages += 1;
+            t.used_blocks += 1;
+            t.used_bytes += size;
+            add_used(used, cells, snap_hdr.segment_size, offset, size);
+            run = 0;
+        }
+        offset += size;
+    }
+    uint64_t huge_bytes = 0;
+    for (uint64_t i = 0; i < snap_hdr.huge_blocks; i++) {
+        uint64_t map_size;
+        if (fread(&map_size, sizeof(map_size), 1, fp) != 1) break;
+        huge_bytes += map_size;
+    }
+    fclose(fp);
+
+    printf("segment %llu bytes, %llu blocks: %llu used (%llu bytes, %llu slab pages), "
+           "%llu free (%llu bytes)\n",
+           (unsigned long long)snap_hdr.segment_size, (unsigned long long)snap_hdr.blocks,
+           (unsigned long long)t.used_blocks, (unsigned long long)t.used_bytes,
+           (unsigned long long)t.slab_pages, (unsigned long long)t.free_blocks,
+           (unsigned long long)t.free_bytes);
+    if (offset != snap_hdr.segment_size) {
+        printf("blocks cover %llu bytes, not the whole segment\n", (unsigned long long)offset);
+    }
+    if (snap_hdr.huge_blocks > 0) {
+        printf("huge mappings %llu, %llu bytes\n", (unsigned long long)snap_hdr.huge_blocks,
+               (unsigned long long)huge_bytes);
+    }
+    printf("largest free block %llu bytes, largest contiguous free region %llu bytes\n",
+           (unsigned long long)t.largest_free, (unsigned long long)t.largest_run);
+    printf("external fragmentation %.1f%%\n",
+           t.free_bytes ? 100.0 * (1.0 - (double)t.largest_free / t.free_bytes) : 0.0);
+
+    printf("free block sizes (header included):\n");
+    for (size_t b = 0; b < HIST_BUCKETS; b++) {
+        if (t.hist_blocks[b] == 0) continue;
+        printf("  %10llu - %-10llu %10llu blocks %14llu bytes %5.1f%%\n",
+               1ULL << b, (2ULL << b) - 1, (unsigned long long)t.hist_blocks[b],
+               (unsigned long long)t.hist_bytes[b], 100.0 * t.hist_bytes[b] / t.free_bytes);
+    }
+    print_map(used, cells, snap_hdr.segment_size);
+    free(used);
+    return 0;
+}
@@ -0,0 +1,340 @@
+/* File: replay.c
+ * -------------------------
+ *
+ * This file is a trace-replay harness for the allocators. It reads
+ * allocation scripts, one request per line:
+ *
+ *     a <id> <size>     allocate size bytes as block id
+ *     r <id> <size>     reallocate block id to size bytes
+ *     f <id>            free block id
+ *
+ * ("alloc", "realloc" and "free" are accepted too, and lines starting
+ * with '#' are comments). The scripts in traces/ are written by
+ * traces/gen_traces.py. Each script is parsed up front and then
+ * replayed against a fresh heap, timing every request on its own.
+ * For each script it reports throughput, peak utilisation (the most
+ * payload live at once over the furthest byte of the segment handed
+ * out), the p50/p99 latency per request and how many reallocs had
+ * to move their block. Every block is stamped
+ * with its id, which is checked before it is reallocated or freed.
+ *
+ * Build it once per allocator:
+ *     gcc -O2 -o replay_explicit replay.c ExplicitAllocation.c
+ *     gcc -O2 -o replay_implicit replay.c ImplicitAllocation.c
+ *     gcc -O2 -DNEXT_FIT -o replay_nextfit replay.c ImplicitAllocation.c
+ *     gcc -O2 -o replay_tlsf replay.c TLSFAllocation.c
+ *     gcc -O2 -o replay_buddy replay.c BuddyAllocation.c
+ *     gcc -O2 -DLIBC_MALLOC -o replay_libc replay.c
+ *     gcc -O2 -DBEST_FIT -o replay_bestfit replay.c ExplicitAllocation.c
+ *     gcc -O2 -DSTEP_VALIDATE -o replay_step replay.c ExplicitAllocation.c
+ *     gcc -O2 -DHARDENED -o replay_hardened replay.c ExplicitAllocation.c
+ *     gcc -O2 -DDEFERRED_COALESCE -o replay_deferred replay.c ExplicitAllocation.c
+ *
+ * Usage: ./replay_explicit [-v] [-c budget] [-s heap_mb] script...
+ *     -v validates the heap after every request (slow)
+ *     -c runs heap_validate_step with budget blocks after every
+ *        request and reports its mean and slowest call (STEP_VALIDATE
+ *        builds, which need the explicit allocator)
+ *     -s sets the segment given to myinit, 1024 MB by default
+ */
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#ifdef LIBC_MALLOC
+#define myinit(start, size) true
+#define mymalloc malloc
+#define myfree free
+#define myrealloc realloc
+#define validate_heap() true
+#else
+#include "./allocator.h"
+#endif
+#ifdef STEP_VALIDATE
+#include "./heap.h"
+#endif
+
+#define DEFAULT_HEAP_MB 1024
+#define MAX_LINE 256
+#define NO_STEP ((size_t)-1) // -c not given
+
+// one parsed request of a script
+typedef struct op
+{
+    char kind; // 'a', 'r' or 'f'
+    size_t id;
+    size_t size;
+} op;
+
+// a parsed script and the number of block ids it uses
+typedef struct script
+{
+    op *ops;
+    size_t nops;
+    size_t nids;
+} script;
+
+/* Function: parse_script
+ * -------------------------
+ * Parameters:
+ *     path - the file name of the script
+ *     s - the script to fill in
+ *
+ * Returns: boolean representation of if the script could be read
+ *
+ * This function reads every request of a script into memory so
+ * that parsing is not part of the timing.
+ */
+bool parse_script(const char *path, script *s) {
+    FILE *fp = fopen(path, "r");
+    if (fp == NULL) {
+        printf("%s: cannot open\n", path);
+        return false;
+    }
+
+    size_t capacity = 1024;
+    s->ops = malloc(capacity * sizeof(op));
+    s->nops = 0;
+    s->nids = 0;
+    char line[MAX_LINE];
+    for (size_t lineno = 1; fgets(line, sizeof(line), fp) != NULL; lineno++) {
+        char word[16];
+        op cur = {0};
+        int fields = sscanf(line, "%15s %zu %zu", word, &cur.id, &cur.size);
+        if (fields <= 0 || word[0] == '#') continue;
+
+        cur.kind = word[0];
+        bool sized = (cur.kind == 'a' || cur.kind == 'r');
+        if ((!sized && cur.kind != 'f') || fields < (sized ? 3 : 2)) {
+            printf("%s:%zu: bad request: %s", path, lineno, line);
+            fclose(fp);
+            free(s->ops);
+            return false;
+        }
+        if (s->nops == capacity) {
+            capacity *= 2;
+            s->ops = realloc(s->ops, capacity * sizeof(op));
+        }
+        s->ops[s->nops++] = cur;
+        if (cur.id >= s->nids) s->nids = cur.id + 1;
+    }
+    fclose(fp);
+    return true;
+}
+
+/* Function: now_ns
+ * -------------------------
+ * Parameters: NA
+ *
+ * Returns: a long long of the monotonic clock in nanoseconds
+ *
+ * This function reads the clock used for every timing.
+ */
+long long now_ns(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1000000000LL + t.tv_nsec;
+}
+
+/* Function: cmp_latency
+ * -------------------------
+ * Parameters:
+ *     a - a pointer to one latency
+ *     b - a pointer to another
+ *
+ * Returns: an int ordering the two for qsort
+ *
+ * This function sorts latencies from fastest to slowest.
+ */
+int cmp_latency(const void *a, const void *b) {
+    long long x = *(const long long *)a;
+    long long y = *(const long long *)b;
+    return (x > y) - (x < y);
+}
+
+/* Function: stamp
+ * -------------------------
+ * Parameters:
+ *     ptr - a pointer to a block
+ *     size - the size_t payload size of the block
+ *     id - the size_t id of the block
+ *
+ * Returns: NA
+ *
+ * This function writes a byte made from the block's id into its
+ * first and last byte.
+ */
+void stamp(char *ptr, size_t size, size_t id) {
+    if (size == 0) return;
+    ptr[0] = (char)(id ^ (id >> 8));
+    ptr[size - 1] = (char)(id ^ (id >> 8));
+}
+
+/* Function: stamp_ok
+ * -------------------------
+ * Parameters:
+ *     ptr - a pointer to a block
+ *     size - the size_t payload size of the block
+ *     id - the size_t id of the block
+ *
+ * Returns: boolean representation of if the stamp is still intact
+ *
+ * This function checks what stamp wrote, so a block that was
+ * overwritten by another shows up.
+ */
+bool stamp_ok(char *ptr, size_t size, size_t id) {
+    if (size == 0) return true;
+    return ptr[0] == (char)(id ^ (id >> 8)) && ptr[size - 1] == (char)(id ^ (id >> 8));
+}
+
+/* Function: replay
+ * -------------------------
+ * Parameters:
+ *     path - the file name of the script, for the report
+ *     s - the parsed script
+ *     heap - the segment to replay it in
+ *     heap_size - the size_t bytes of the segment
+ *     validate - whether to validate the heap after every request
+ *     budget - the size_t blocks to step-validate after every
+ *              request, or NO_STEP
+ *
+ * Returns: boolean representation of if the replay ran cleanly
+ *
+ * This function runs a script against a fresh heap and prints one
+ * line of numbers for it, and one more for the step checks.
+ */
+bool replay(const char *path, script *s, char *heap, size_t heap_size, bool validate,
+            size_t budget) {
+    char **blocks = calloc(s->nids, sizeof(char *));
+    size_t *sizes = calloc(s->nids, sizeof(size_t));
+    long long *latency = malloc(s->nops * sizeof(long long));
+    if (!myinit(heap, heap_size)) {
+        printf("%s: myinit failed\n", path);
+        return false;
+    }
+
+    size_t live = 0, peak_live = 0, furthest = 0, failed = 0, reallocs = 0, moved = 0;
+    long long total = 0, check_total = 0, check_max = 0;
+    bool ok = true;
+    for (size_t i = 0; i < s->nops && ok; i++) {
+        op *cur = &s->ops[i];
+        char *old = blocks[cur->id];
+        if (old != NULL && !stamp_ok(old, sizes[cur->id], cur->id)) {
+            printf("%s: request %zu: block %zu was overwritten\n", path, i, cur->id);
+            ok = false;
+            break;
+        }
+
+        long long start = now_ns();
+        char *ptr = NULL;
+        if (cur->kind == 'a') {
+            ptr = mymalloc(cur->size);
+        } else if (cur->kind == 'r') {
+            ptr = myrealloc(old, cur->size);
+            reallocs += 1;
+            if (old != NULL && ptr != NULL && ptr != old) moved += 1;
+        } else {
+            myfree(old);
+        }
+        latency[i] = now_ns() - start;
+        total += latency[i];
+
+        if (cur->kind == 'f') {
+            live -= sizes[cur->id];
+            blocks[cur->id] = NULL;
+            sizes[cur->id] = 0;
+        } else if (ptr == NULL && cur->size > 0) {
+            failed += 1; // a failed realloc leaves the old block in place
+        } else {
+            live += cur->size - sizes[cur->id];
+            blocks[cur->id] = ptr;
+            sizes[cur->id] = cur->size;
+            stamp(ptr, cur->size, cur->id);
+            if (ptr >= heap && ptr < heap + heap_size) {
+                size_t end = ptr + cur->size - heap;
+                if (end > furthest) furthest = end;
+            }
+        }
+        if (live > peak_live) peak_live = live;
+        if (validate && !validate_heap()) {
+            printf("%s: request %zu: validate_heap failed\n", path, i);
+            ok = false;
+        }
+#ifdef STEP_VALIDATE
+        if (budget != NO_STEP && ok) {
+            long long check_start = now_ns();
+            ok = heap_validate_step(heap_default(), budget);
+            long long took = now_ns() - check_start;
+            check_total += took;
+            if (took > check_max) check_max = took;
+            if (!ok) printf("%s: request %zu: heap_validate_step failed\n", path, i);
+        }
+#endif
+    }
+
+    if (ok) {
+        qsort(latency, s->nops, sizeof(long long), cmp_latency);
+        const char *name = strrchr(path, '/') ? strrchr(path, '/') + 1 : path;
+        printf("%-24s %8zu ops %10.0f ops/sec  util ", name, s->nops,
+               s->nops / (total / 1e9));
+        if (furthest > 0) {
+            printf("%5.1f%%", 100.0 * peak_live / furthest);
+        } else {
+            printf("    - "); // libc hands out memory outside the segment
+        }
+        printf("  p50 %5lld ns  p99 %6lld ns  moved %zu/%zu  failed %zu\n",
+               latency[s->nops / 2], latency[s->nops * 99 / 100], moved, reallocs, failed);
+        if (budget != NO_STEP) {
+            printf("%-24s step check budget %zu%s: mean %6.0f ns  max %8lld ns\n", "", budget,
+                   budget ? "" : " (whole heap)", (double)check_total / s->nops, check_max);
+        }
+    }
+    free(blocks);
+    free(sizes);
+    free(latency);
+    return ok;
+}
+
+int main(int argc, char *argv[]) {
+    bool validate = false;
+    size_t budget = NO_STEP;
+    size_t heap_size = (size_t)DEFAULT_HEAP_MB << 20;
+    int first = 1;
+    for (; first < argc && argv[first][0] == '-'; first++) {
+        if (strcmp(argv[first], "-v") == 0) {
+            validate = true;
+        } else if (strcmp(argv[first], "-s") == 0 && first + 1 < argc) {
+            heap_size = strtoul(argv[++first], NULL, 10) << 20;
+#ifdef STEP_VALIDATE
+        } else if (strcmp(argv[first], "-c") == 0 && first + 1 < argc) {
+            budget = strtoul(argv[++first], NULL, 10);
+#endif
+        } else {
+            printf("usage: %s [-v] [-c budget] [-s heap_mb] script...\n", argv[0]);
+            return 1;
+        }
+    }
+    if (first == argc) {
+        printf("usage: %s [-v] [-c budget] [-s heap_mb] script...\n", argv[0]);
+        return 1;
+    }
+
+    char *heap = malloc(heap_size);
+    if (heap == NULL) {
+        printf("cannot get a %zu byte segment\n", heap_size);
+        return 1;
+    }
+    int failures = 0;
+    for (int i = first; i < argc; i++) {
+        script s;
+        if (!parse_script(argv[i], &s) || s.nops == 0) {
+            failures += 1;
+            continue;
+        }
+        if (!replay(argv[i], &s, heap, heap_size, validate, budget)) failures += 1;
+        free(s.ops);
+    }
+    free(heap);
+    return failures != 0;
+}
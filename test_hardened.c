@@ -0,0 +1,191 @@
+/* File: test_hardened.c
+ * -------------------------
+ *
+ * This file checks that a -DHARDENED build aborts on heap misuse
+ * instead of carrying on. It first runs a clean mix of mallocs,
+ * reallocs, sized frees and frees, which must not abort, and then
+ * runs each misuse in a forked child on a fresh heap, expecting the
+ * child to die of SIGABRT:
+ *
+ *     - double frees of a large block, a small block and a tiny one
+ *     - writes past the usable size of a block into its canary,
+ *       which follows any rounding of the size asked for
+ *     - frees of a pointer the heap never handed out and of a
+ *       pointer into the middle of a block
+ *     - a realloc of a freed block
+ *     - a sized free larger than the block
+ *
+ * It prints one line per case and exits nonzero if any misuse was
+ * missed or the clean run failed.
+ *
+ * Build it for the allocators with a HARDENED build, and for the
+ * thread caches of the explicit one:
+ *     gcc -O2 -DHARDENED -o test_hardened test_hardened.c ExplicitAllocation.c
+ *     gcc -O2 -DHARDENED -o test_hardened_implicit test_hardened.c ImplicitAllocation.c
+ *     gcc -O2 -DHARDENED -DTHREAD_SAFE -o test_hardened_ts test_hardened.c ExplicitAllocation.c -lpthread
+ *
+ * Usage: ./test_hardened
+ */
+#include "./allocator.h"
+#include "./heap.h"
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#define HEAP_SIZE ((size_t)4 << 20)
+#define CLEAN_BLOCKS 100
+
+static char heap_mem[HEAP_SIZE];
+
+// one kind of misuse and the name it is reported under
+typedef struct misuse
+{
+    const char *name;
+    void (*run)(void);
+} misuse;
+
+// each misuse runs in a forked child on a fresh heap and should abort
+void double_free_large(void) {
+    void *p = mymalloc(2000);
+    myfree(p);
+    myfree(p);
+}
+
+void double_free_small(void) {
+    void *p = mymalloc(100);
+    myfree(p);
+    myfree(p);
+}
+
+void double_free_tiny(void) {
+    void *p = mymalloc(4);
+    void *q = mymalloc(4);
+    myfree(p);
+    myfree(q);
+    myfree(p);
+}
+
+void overrun_into_canary(void) {
+    char *p = mymalloc(300);
+    memset(p, 0x41, my_usable_size(p) + 1);
+    myfree(p);
+}
+
+void overrun_small_block(void) {
+    char *p = mymalloc(100);
+    memset(p, 0x41, my_usable_size(p) + 1);
+    myfree(p);
+}
+
+void free_foreign_pointer(void) {
+    static char elsewhere[64];
+    myfree(elsewhere + 8);
+}
+
+void free_interior_pointer(void) {
+    char *p = mymalloc(300);
+    myfree(p + 16);
+}
+
+void realloc_freed_block(void) {
+    void *p = mymalloc(500);
+    myfree(p);
+    myrealloc(p, 600);
+}
+
+void oversized_sized_free(void) {
+    void *p = mymalloc(200);
+    myfree_sized(p, my_usable_size(p) + 1);
+}
+
+static const misuse misuses[] = {
+    {"double free, large block", double_free_large},
+    {"double free, small block", double_free_small},
+    {"double free, tiny block", double_free_tiny},
+    {"overrun into the canary", overrun_into_canary},
+    {"overrun of a small block", overrun_small_block},
+    {"free of a foreign pointer", free_foreign_pointer},
+    {"free of an interior pointer", free_interior_pointer},
+    {"realloc of a freed block", realloc_freed_block},
+    {"sized free past the block", oversized_sized_free},
+};
+#define NUM_MISUSES (sizeof(misuses) / sizeof(misuses[0]))
+
+/* Function: clean_run
+ * -------------------------
+ * Parameters: NA
+ *
+ * Returns: boolean representation of if correct use of the heap
+ *          went through and left it valid
+ *
+ * This function makes sure the checks do not fire on a program that
+ * uses the heap correctly, blocks filled to their usable size
+ * included.
+ */
+bool clean_run(void) {
+    if (!myinit(heap_mem, HEAP_SIZE)) return false;
+    void *blocks[CLEAN_BLOCKS];
+    size_t sizes[CLEAN_BLOCKS];
+    for (size_t i = 0; i < CLEAN_BLOCKS; i++) {
+        sizes[i] = 1 + (i * 37) % 400;
+        blocks[i] = mymalloc(sizes[i]);
+        if (blocks[i] == NULL) return false;
+        memset(blocks[i], 1, my_usable_size(blocks[i]));
+    }
+    // sizes that wrap once the canary is added must fail, not be cached
+    if (mymalloc(SIZE_MAX) != NULL || mymalloc(SIZE_MAX - 2) != NULL) return false;
+    for (size_t i = 0; i < CLEAN_BLOCKS; i += 3) {
+        sizes[i] = 500 + i;
+        blocks[i] = myrealloc(blocks[i], sizes[i]);
+        if (blocks[i] == NULL) return false;
+    }
+    for (size_t i = 0; i < CLEAN_BLOCKS; i++) {
+        if (i % 2 == 0) myfree_sized(blocks[i], sizes[i]);
+        else myfree(blocks[i]);
+    }
+    return validate_heap();
+}
+
+/* Function: aborts
+ * -------------------------
+ * Parameters:
+ *     m - a pointer to the misuse to try
+ *
+ * Returns: boolean representation of if the misuse killed its
+ *          process with SIGABRT
+ *
+ * This function runs a misuse in a forked child on a fresh heap,
+ * with the child's stderr closed so the report does not clutter
+ * the output.
+ */
+bool aborts(const misuse *m) {
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid < 0) return false;
+    if (pid == 0) {
+        close(STDERR_FILENO);
+        if (!myinit(heap_mem, HEAP_SIZE)) _exit(1);
+        m->run();
+        _exit(0);
+    }
+    int status;
+    if (waitpid(pid, &status, 0) != pid) return false;
+    return WIFSIGNALED(status) && WTERMSIG(status) == SIGABRT;
+}
+
+int main(void) {
+    bool clean = clean_run();
+    printf("%-30s %s\n", "clean use", clean ? "ok" : "FAILED");
+
+    size_t caught = 0;
+    for (size_t i = 0; i < NUM_MISUSES; i++) {
+        bool aborted = aborts(&misuses[i]);
+        printf("%-30s %s\n", misuses[i].name, aborted ? "caught" : "MISSED");
+        caught += aborted;
+    }
+    printf("%zu/%zu caught\n", caught, NUM_MISUSES);
+    return !clean || caught != NUM_MISUSES;
+}
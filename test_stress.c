@@ -0,0 +1,209 @@
+/* File: test_stress.c
+ * -------------------------
+ *
+ * This file is a randomized stress test for any of the allocators.
+ * It runs random mallocs, frees, sized frees and reallocs of 1 byte
+ * to 200 KB over a fixed number of slots on one myinit segment,
+ * filling every block with a pattern drawn from its slot and
+ * checking the pattern before the block is reallocated or freed.
+ * It also checks that every payload is 8-aligned, lies inside the
+ * segment and has a usable size of at least what was asked for,
+ * and calls validate_heap every so many requests. Now and then it
+ * asks for a realloc far larger than the segment, which must fail
+ * and leave the block as it was. The whole run is done twice,
+ * with myinit in between, so a reset heap is stressed too.
+ *
+ * It prints one line per round and exits nonzero, after saying
+ * what went wrong, on the first broken check. Build it with
+ * -fsanitize=address,undefined to catch reads and writes outside
+ * the blocks as well.
+ *
+ * Build it once per allocator:
+ *     gcc -O1 -g -fsanitize=address,undefined -o test_stress test_stress.c ExplicitAllocation.c
+ *     gcc -O1 -g -fsanitize=address,undefined -o test_stress_implicit test_stress.c ImplicitAllocation.c
+ *     gcc -O1 -g -fsanitize=address,undefined -o test_stress_tlsf test_stress.c TLSFAllocation.c
+ *     gcc -O1 -g -fsanitize=address,undefined -o test_stress_buddy test_stress.c BuddyAllocation.c
+ *
+ * Usage: ./test_stress [heap_bytes] [ops] [seed] [validate_every]   (default 64 MB, 300000, 1, 997)
+ */
+#include "./allocator.h"
+#include "./heap.h"
+#include "./bench.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#define SLOTS 2000
+#define ROUNDS 2
+
+// one live block of the test and what it should hold
+typedef struct slot
+{
+    unsigned char *ptr;
+    size_t size;
+    unsigned char tag; // first byte of its pattern
+} slot;
+
+/* Function: pick_size
+ * -------------------------
+ * Parameters:
+ *     state - a pointer to the generator state
+ *
+ * Returns: the size_t bytes of the next request
+ *
+ * This function draws a request size, half of them up to 64 bytes
+ * and a few up to 200 KB.
+ */
+size_t pick_size(uint64_t *state) {
+    uint64_t r = next_random(state) % 100;
+    uint64_t n = next_random(state);
+    if (r < 50) return 1 + n % 64;
+    if (r < 85) return 1 + n % 1024;
+    if (r < 98) return 1 + n % 16384;
+    return 1 + n % 200000;
+}
+
+/* Function: fill
+ * -------------------------
+ * Parameters:
+ *     s - a pointer to a live slot
+ *
+ * Returns: NA
+ *
+ * This function writes the slot's pattern over its block.
+ */
+void fill(slot *s) {
+    for (size_t k = 0; k < s->size; k++) s->ptr[k] = (unsigned char)(s->tag + k);
+}
+
+/* Function: holds
+ * -------------------------
+ * Parameters:
+ *     s - a pointer to a live slot
+ *     bytes - the size_t leading bytes to check
+ *
+ * Returns: boolean representation of if the block still holds the
+ *          first bytes of its pattern
+ *
+ * This function checks a block before it is reallocated or freed.
+ */
+bool holds(slot *s, size_t bytes) {
+    for (size_t k = 0; k < bytes; k++) {
+        if (s->ptr[k] != (unsigned char)(s->tag + k)) return false;
+    }
+    return true;
+}
+
+/* Function: placed_well
+ * -------------------------
+ * Parameters:
+ *     s - a pointer to a slot just given a block
+ *     mem - the segment given to myinit
+ *     heap_size - the size_t bytes of mem
+ *
+ * Returns: boolean representation of if the block is aligned, has
+ *          room for its size and lies in the segment
+ *
+ * This function checks a block as it is handed out. Blocks past the
+ * segment are allowed for the allocators that map huge ones.
+ */
+bool placed_well(slot *s, char *mem, size_t heap_size) {
+    if ((size_t)s->ptr % ALIGNMENT != 0 || my_usable_size(s->ptr) < s->size) return false;
+    bool inside = (char *)s->ptr >= mem && (char *)s->ptr < mem + heap_size;
+    return !inside || (char *)s->ptr + s->size <= mem + heap_size;
+}
+
+/* Function: run_round
+ * -------------------------
+ * Parameters:
+ *     mem - the segment to give myinit
+ *     heap_size - the size_t bytes of mem
+ *     ops - the size_t requests to make
+ *     state - a pointer to the generator state
+ *     validate_every - the size_t requests between validate_heap
+ *                      calls, 0 for only at the end
+ *     failed - set to the number of requests the heap could not serve
+ *
+ * Returns: a string saying which check broke, or NULL if none did
+ *
+ * This function runs one round of the stress test on a fresh heap
+ * and frees everything at the end.
+ */
+const char *run_round(char *mem, size_t heap_size, size_t ops, uint64_t *state,
+                      size_t validate_every, size_t *failed) {
+    static slot slots[SLOTS];
+    for (size_t i = 0; i < SLOTS; i++) slots[i].ptr = NULL;
+    if (!myinit(mem, heap_size)) return "myinit failed";
+
+    *failed = 0;
+    for (size_t op = 0; op < ops; op++) {
+        slot *s = &slots[next_random(state) % SLOTS];
+        uint64_t r = next_random(state) % 10;
+        if (s->ptr == NULL) {
+            s->size = pick_size(state);
+            s->tag = (unsigned char)next_random(state);
+            s->ptr = mymalloc(s->size);
+            if (s->ptr == NULL) {
+                *failed += 1;
+                continue;
+            }
+            if (!placed_well(s, mem, heap_size)) return "malloc handed out a misplaced block";
+            fill(s);
+        } else if (r < 6) {
+            if (!holds(s, s->size)) return "a block changed before it was freed";
+            if (r < 3) myfree_sized(s->ptr, s->size);
+            else myfree(s->ptr);
+            s->ptr = NULL;
+        } else {
+            if (!holds(s, s->size)) return "a block changed before it was reallocated";
+            // a realloc that can never fit fails and leaves the block as it was
+            if (next_random(state) % 64 == 0) {
+                if (myrealloc(s->ptr, SIZE_MAX / 2) != NULL) return "an impossible realloc went through";
+                if (!holds(s, s->size)) return "a failed realloc changed the block";
+            }
+            size_t new_size = r < 8 ? s->size + next_random(state) % (s->size + 64)
+                                    : 1 + next_random(state) % (s->size + 1);
+            unsigned char *moved = myrealloc(s->ptr, new_size);
+            if (moved == NULL) {
+                *failed += 1;
+                continue;
+            }
+            s->ptr = moved;
+            if (!holds(s, new_size < s->size ? new_size : s->size)) return "realloc lost data";
+            s->size = new_size;
+            if (!placed_well(s, mem, heap_size)) return "realloc handed out a misplaced block";
+            fill(s);
+        }
+        if (validate_every && op % validate_every == 0 && !validate_heap()) return "validate_heap failed";
+    }
+
+    for (size_t i = 0; i < SLOTS; i++) {
+        if (slots[i].ptr == NULL) continue;
+        if (!holds(&slots[i], slots[i].size)) return "a block changed before the final free";
+        myfree(slots[i].ptr);
+    }
+    return validate_heap() ? NULL : "validate_heap failed after freeing everything";
+}
+
+int main(int argc, char *argv[]) {
+    size_t heap_size = argc > 1 ? strtoul(argv[1], NULL, 0) : (size_t)64 << 20;
+    size_t ops = argc > 2 ? strtoul(argv[2], NULL, 10) : 300000;
+    uint64_t state = argc > 3 ? strtoull(argv[3], NULL, 10) : 1;
+    size_t validate_every = argc > 4 ? strtoul(argv[4], NULL, 10) : 997;
+    char *mem = malloc(heap_size);
+    if (mem == NULL || state == 0) {
+        printf("usage: %s [heap_bytes] [ops] [seed (nonzero)] [validate_every]\n", argv[0]);
+        return 1;
+    }
+
+    for (int round = 0; round < ROUNDS; round++) {
+        size_t failed;
+        const char *broken = run_round(mem, heap_size, ops, &state, validate_every, &failed);
+        if (broken != NULL) {
+            printf("round %d: %s\n", round, broken);
+            return 1;
+        }
+        printf("round %d ok, %zu requests the heap could not serve\n", round, failed);
+    }
+    free(mem);
+    return 0;
+}
@@ -0,0 +1,196 @@
+"""File: gen_traces.py
+-------------------------
+
+This file writes the allocation scripts in traces/ that replay.c
+replays. Each trace is built by its own function from a fixed seed,
+so running it again rebuilds the committed scripts byte for byte
+(with Python 3's random module). Scripts are written next to this
+file; name traces to rebuild only those.
+
+Usage: python3 traces/gen_traces.py [trace...]   (default all)
+"""
+import os
+import random
+import sys
+
+TRACE_DIR = os.path.dirname(os.path.abspath(__file__))
+
+
+def write(name, desc, ops):
+    """Writes ops, tuples of an op letter and its numbers, as name.script."""
+    with open(os.path.join(TRACE_DIR, name + ".script"), "w") as f:
+        f.write("# %s\n" % desc)
+        for op in ops:
+            f.write(" ".join(map(str, op)) + "\n")
+
+
+def free_all(live, ops):
+    """Frees every block still live, in random order."""
+    ids = list(live)
+    random.shuffle(ids)
+    for i in ids:
+        ops.append(("f", i))
+
+
+def small_churn():
+    random.seed(1)
+    ops, live, nid = [], {}, 0
+    for _ in range(40000):
+        if live and random.random() < 0.45:
+            i = random.choice(list(live))
+            ops.append(("f", i))
+            del live[i]
+        else:
+            size = random.choice([8, 16, 24, 32, 40, 48, 56, 64, 12, 20])
+            ops.append(("a", nid, size))
+            live[nid] = size
+            nid += 1
+    free_all(live, ops)
+    write("small-churn", "many small objects of 8 to 64 bytes, allocated and freed at random", ops)
+
+
+def mixed():
+    random.seed(2)
+    ops, live, nid = [], {}, 0
+    for _ in range(30000):
+        r = random.random()
+        if live and r < 0.35:
+            i = random.choice(list(live))
+            ops.append(("f", i))
+            del live[i]
+        elif live and r < 0.5:
+            i = random.choice(list(live))
+            size = max(1, int(live[i] * random.uniform(0.5, 2.0)))
+            ops.append(("r", i, size))
+            live[i] = size
+        else:
+            size = random.randint(1, 256) if random.random() < 0.7 else random.randint(257, 16384)
+            ops.append(("a", nid, size))
+            live[nid] = size
+            nid += 1
+    free_all(live, ops)
+    write("mixed", "mixed sizes from 1 byte to 16 KB with frees and reallocs in random order", ops)
+
+
+def realloc_grow():
+    random.seed(3)
+    ops, live = [], {}
+    for i in range(32):
+        ops.append(("a", i, 64))
+        live[i] = 64
+    for step in range(20000):
+        i = random.randrange(32)
+        live[i] += random.randint(1, 512)
+        ops.append(("r", i, live[i]))
+        if random.random() < 0.05:
+            ops.append(("a", 32 + step, random.randint(16, 200)))
+            ops.append(("f", 32 + step))
+    free_all(live, ops)
+    write("realloc-grow", "32 buffers grown a little at a time, like appending to strings and vectors", ops)
+
+
+def phases():
+    random.seed(4)
+    ops, live, nid = [], {}, 0
+    for lo, hi in [(16, 128), (1000, 3000), (100, 400), (4000, 12000), (24, 64)]:
+        for _ in range(4000):
+            size = random.randint(lo, hi)
+            ops.append(("a", nid, size))
+            live[nid] = size
+            nid += 1
+        ids = list(live)
+        random.shuffle(ids)
+        for i in ids[:len(ids) * 3 // 4]:
+            ops.append(("f", i))
+            del live[i]
+    free_all(live, ops)
+    write("phases", "phases of one size range each, with three quarters of the live blocks freed between phases", ops)
+
+
+def lifo():
+    random.seed(5)
+    ops, stack, nid = [], [], 0
+    for _ in range(40000):
+        if stack and random.random() < 0.49:
+            ops.append(("f", stack.pop()))
+        else:
+            ops.append(("a", nid, random.randint(8, 512)))
+            stack.append(nid)
+            nid += 1
+    while stack:
+        ops.append(("f", stack.pop()))
+    write("lifo", "stack-like allocation where the newest block is freed first", ops)
+
+
+def vector_growth():
+    random.seed(6)
+    ops, nid = [], 0
+    vec, size, small = {}, {}, []
+    for v in range(48):
+        vec[v] = nid
+        size[v] = 32
+        ops.append(("a", nid, 32))
+        nid += 1
+    for _ in range(30000):
+        v = random.randrange(48)
+        if size[v] > 262144:
+            ops.append(("f", vec[v]))
+            vec[v] = nid
+            size[v] = 32
+            ops.append(("a", nid, 32))
+            nid += 1
+        else:
+            size[v] = size[v] * 3 // 2 + 8
+            ops.append(("r", vec[v], size[v]))
+        # short-lived neighbours: allocate some, free older ones
+        if random.random() < 0.6:
+            ops.append(("a", nid, random.randint(16, 512)))
+            small.append(nid)
+            nid += 1
+        if len(small) > 64 or (small and random.random() < 0.5):
+            ops.append(("f", small.pop(random.randrange(len(small)))))
+    for s in small:
+        ops.append(("f", s))
+    for v in range(48):
+        ops.append(("f", vec[v]))
+    write("vector-growth", "48 vectors grown by half each time up to 256 KB and restarted, among short-lived small blocks", ops)
+
+
+def pow2_buffers():
+    random.seed(14)
+    ops, slots = [], [0] * 384
+    orders = list(range(12, 23))
+    weights = [2.0 ** (-(k - 12) / 2) for k in orders]
+    for _ in range(40000):
+        i = random.randrange(len(slots))
+        if slots[i] == 0:
+            slots[i] = 1 << random.choices(orders, weights)[0]
+            ops.append(("a", i, slots[i]))
+        elif random.random() < 0.15 and slots[i] < (1 << 22):
+            slots[i] *= 2
+            ops.append(("r", i, slots[i]))
+        else:
+            ops.append(("f", i))
+            slots[i] = 0
+    for i, s in enumerate(slots):
+        if s:
+            ops.append(("f", i))
+    write("pow2-buffers", "I/O buffers of 4 KB to 4 MB, all powers of two, taken and released in random order, with some doubled by realloc", ops)
+
+
+TRACES = {
+    "small-churn": small_churn,
+    "mixed": mixed,
+    "realloc-grow": realloc_grow,
+    "phases": phases,
+    "lifo": lifo,
+    "vector-growth": vector_growth,
+    "pow2-buffers": pow2_buffers,
+}
+
+if __name__ == "__main__":
+    names = sys.argv[1:] or list(TRACES)
+    for name in names:
+        if name not in TRACES:
+            sys.exit("unknown trace %s, pick from: %s" % (name, " ".join(TRACES)))
+        TRACES[name]()